@@ -61,6 +61,13 @@ namespace dsp
 		params.setDcy(ms);
 	}
 
+	void EnvelopeFollower::setCoefficients(double atk, double dcy) noexcept
+	{
+		params.atk = atk;
+		params.dcy = dcy;
+		envLP.setX(attackState ? atk : dcy);
+	}
+
 	void EnvelopeFollower::operator()(ProcessorBufferView& view) noexcept
 	{
 		copyMid(view);
@@ -82,6 +89,11 @@ namespace dsp
 		return meter.load();
 	}
 
+	const EnvelopeFollower::Params& EnvelopeFollower::getParams() const noexcept
+	{
+		return params;
+	}
+
 	void EnvelopeFollower::reset(double v)
 	{
 		const auto vF = static_cast<float>(v);
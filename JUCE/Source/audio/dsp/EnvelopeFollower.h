@@ -38,6 +38,10 @@ namespace dsp
 
 		void setDecay(double) noexcept;
 
+		// coefficients computed by another EnvelopeFollower's Params
+		// atk, dcy
+		void setCoefficients(double, double) noexcept;
+
 		// process:
 
 		void reset(double);
@@ -52,6 +56,8 @@ namespace dsp
 		float operator[](int i) const noexcept;
 
 		float getMeter() const noexcept;
+
+		const Params& getParams() const noexcept;
 	private:
 		Params params;
 		std::atomic<float> meter;
@@ -152,6 +152,16 @@ namespace dsp
 		return y;
 	}
 
+	const smooth::Lowpass& Resonator3::getLowpass() const noexcept
+	{
+		return lp;
+	}
+
+	void Resonator3::setLowpassX(double x) noexcept
+	{
+		lp.setX(x);
+	}
+
 	// ResonatorStereo
 
 	template<class ResoClass>
@@ -87,6 +87,11 @@ namespace dsp
 		void copyFrom(const Resonator3&) noexcept;
 
 		double operator()(double) noexcept override;
+
+		const smooth::Lowpass& getLowpass() const noexcept;
+
+		// x
+		void setLowpassX(double) noexcept;
 	protected:
 		smooth::Lowpass lp;
 	};
@@ -64,6 +64,32 @@ namespace dsp
 		reso.update();
 	}
 
+	void OnsetCore::getCoefficients(OnsetBandCoefficients& c) const noexcept
+	{
+		const auto& env0 = envFols[0].getParams();
+		const auto& env1 = envFols[1].getParams();
+		c.resoA0 = reso.a0;
+		c.resoB1 = reso.b1;
+		c.resoB2 = reso.b2;
+		c.lpX = reso.getLowpass().b1;
+		c.env0Atk = env0.atk;
+		c.env0Dcy = env0.dcy;
+		c.env1Atk = env1.atk;
+		c.env1Dcy = env1.dcy;
+		c.gain = gain;
+	}
+
+	void OnsetCore::setCoefficients(const OnsetBandCoefficients& c) noexcept
+	{
+		reso.a0 = c.resoA0;
+		reso.b1 = c.resoB1;
+		reso.b2 = c.resoB2;
+		reso.setLowpassX(c.lpX);
+		envFols[0].setCoefficients(c.env0Atk, c.env0Dcy);
+		envFols[1].setCoefficients(c.env1Atk, c.env1Dcy);
+		gain = c.gain;
+	}
+
 	// process:
 
 	void OnsetCore::prepare(double _sampleRate) noexcept
@@ -210,23 +236,224 @@ namespace dsp
 		timer = 0;
 	}
 
+	// DESIGN THREAD:
+
+	OnsetDesignThread::OnsetDesignThread() :
+		juce::Thread("Onset Design"),
+		lock(),
+		handoffs()
+	{
+		startThread();
+	}
+
+	OnsetDesignThread::~OnsetDesignThread()
+	{
+		// also wakes the thread up
+		stopThread(-1);
+	}
+
+	void OnsetDesignThread::add(OnsetBandsHandoff& handoff)
+	{
+		const juce::ScopedLock sl(lock);
+		handoffs.push_back(&handoff);
+	}
+
+	void OnsetDesignThread::remove(OnsetBandsHandoff& handoff)
+	{
+		const juce::ScopedLock sl(lock);
+		handoffs.erase(std::find(handoffs.begin(), handoffs.end(), &handoff));
+	}
+
+	void OnsetDesignThread::wake() noexcept
+	{
+		notify();
+	}
+
+	const juce::CriticalSection& OnsetDesignThread::getLock() const noexcept
+	{
+		return lock;
+	}
+
+	void OnsetDesignThread::run()
+	{
+		while (!threadShouldExit())
+		{
+			wait(-1);
+			const juce::ScopedLock sl(lock);
+			for (auto handoff : handoffs)
+				handoff->update();
+		}
+	}
+
+	// BANDS HANDOFF:
+
+	OnsetBandsHandoff::OnsetBandsHandoff() :
+		thread(),
+		designers(),
+		params(),
+		snapshots(),
+		paramsAudio(),
+		paramsChanged(false)
+	{
+		thread->add(*this);
+	}
+
+	OnsetBandsHandoff::~OnsetBandsHandoff()
+	{
+		// waits for a running update() to finish
+		thread->remove(*this);
+	}
+
+	// parameters:
+
+	void OnsetBandsHandoff::setAttack(double x) noexcept
+	{
+		paramsAudio.attack = x;
+		paramsChanged = true;
+	}
+
+	void OnsetBandsHandoff::setDecay(double x) noexcept
+	{
+		paramsAudio.decay = x;
+		paramsChanged = true;
+	}
+
+	void OnsetBandsHandoff::setTilt(float db) noexcept
+	{
+		paramsAudio.tilt = db;
+		paramsChanged = true;
+	}
+
+	void OnsetBandsHandoff::setBandwidth(double b) noexcept
+	{
+		paramsAudio.bandwidth = b;
+		paramsChanged = true;
+	}
+
+	void OnsetBandsHandoff::setNumBands(int n) noexcept
+	{
+		paramsAudio.numBands = n;
+		paramsChanged = true;
+	}
+
+	void OnsetBandsHandoff::setLowestPitch(double p) noexcept
+	{
+		paramsAudio.lowestPitch = p;
+		paramsChanged = true;
+	}
+
+	void OnsetBandsHandoff::setHighestPitch(double p) noexcept
+	{
+		paramsAudio.highestPitch = p;
+		paramsChanged = true;
+	}
+
+	// process:
+
+	void OnsetBandsHandoff::prepare(double sampleRate) noexcept
+	{
+		// waits for a running update() to finish
+		const juce::ScopedLock sl(thread->getLock());
+		for (auto& d : designers)
+			d.prepare(sampleRate);
+		paramsChanged = false;
+		params.getBack() = paramsAudio;
+		params.publish();
+		update();
+	}
+
+	const OnsetSnapshot* OnsetBandsHandoff::pull() noexcept
+	{
+		if (paramsChanged)
+		{
+			params.getBack() = paramsAudio;
+			params.publish();
+			paramsChanged = false;
+			thread->wake();
+		}
+		if (!snapshots.update())
+			return nullptr;
+		return &snapshots.getFront();
+	}
+
+	void OnsetBandsHandoff::update() noexcept
+	{
+		if (params.update())
+			design(params.getFront());
+	}
+
+	void OnsetBandsHandoff::design(const OnsetBandsParams& p) noexcept
+	{
+		const auto n = p.numBands;
+		for (auto& d : designers)
+			d.setBandwidthPercent(p.bandwidth);
+		updatePitchRange(n, p.lowestPitch, p.highestPitch);
+		// the envelopes' lengths depend on the bands' frequencies
+		const auto dcy0 = OnsetDecay0Percent * p.decay;
+		for (auto& d : designers)
+		{
+			d.setAttack(p.attack);
+			d.setDecay(p.decay, 1);
+			d.setDecay(dcy0, 0);
+		}
+		updateTilt(n, p.tilt);
+
+		auto& snapshot = snapshots.getBack();
+		for (auto i = 0; i < OnsetNumBandsMax; ++i)
+			designers[i].getCoefficients(snapshot.bands[i]);
+		snapshot.numBands = n;
+		snapshots.publish();
+	}
+
+	void OnsetBandsHandoff::updatePitchRange(int n, double lowest, double highest) noexcept
+	{
+		const auto rangePitch = highest - lowest;
+		for (auto i = 0; i < n; ++i)
+		{
+			const auto iF = static_cast<float>(i);
+			// a single band sits in the middle of the range
+			const auto iR = n > 1 ? iF / static_cast<float>(n - 1) : .5f;
+			const auto pitch = lowest + iR * rangePitch;
+			const auto freqHz = static_cast<double>(math::noteToFreqHz2(pitch));
+			const auto pitchLow = pitch - .5f;
+			const auto pitchHigh = pitch + .5f;
+			const auto freqLow = static_cast<double>(math::noteToFreqHz2(pitchLow));
+			const auto freqHigh = static_cast<double>(math::noteToFreqHz2(pitchHigh));
+			const auto bwHz = freqHigh - freqLow;
+			auto& designer = designers[i];
+			designer.setFreqHz(freqHz);
+			designer.setBandwidth(bwHz);
+			designer.updateFilter();
+		}
+	}
+
+	void OnsetBandsHandoff::updateTilt(int n, float db) noexcept
+	{
+		const auto lowestGain = math::dbToAmp(-db);
+		const auto highestGain = math::dbToAmp(db);
+		const auto rangeGain = highestGain - lowestGain;
+		const auto numBandsInv = 1.f / static_cast<float>(n);
+		const auto bandCompensate = numBandsInv * numBandsInv;
+		for (auto i = 0; i < n; ++i)
+		{
+			const auto iF = static_cast<float>(i);
+			const auto iR = iF / static_cast<float>(n);
+			const auto gain = lowestGain + iR * rangeGain;
+			designers[i].setGain(gain * bandCompensate);
+		}
+	}
+
 	// ONSET DETECTOR:
 
 	OnsetDetector::OnsetDetector() :
 		buffer(),
 		detectors(),
+		handoff(),
 		strongHold(),
-		sampleRate(1.),
-		lowestPitch(math::freqHzToNote2(OnsetLowestFreqHz)),
-		highestPitch(math::freqHzToNote2(OnsetHighestFreqHz)),
-		threshold(OnsetThresholdDefault), tilt(OnsetTiltDefault),
+		threshold(OnsetThresholdDefault),
 		numBands(static_cast<int>(OnsetNumBandsDefault)), onset(-1), onsetOut(-1),
 		sysex()
 	{
-		const auto bwPercentDefault = std::pow(2., static_cast<double>(OnsetBandwidthDefault));
-		setBandwidth(bwPercentDefault);
-		setDecay(OnsetDcyDefault);
-		setTilt(OnsetTiltDefault);
 		sysex.makeBytesOnset();
 	}
 
@@ -234,23 +461,17 @@ namespace dsp
 
 	void OnsetDetector::setAttack(double x) noexcept
 	{
-		for (auto& d : detectors)
-			d.setAttack(x);
+		handoff.setAttack(x);
 	}
 
 	void OnsetDetector::setDecay(double x) noexcept
 	{
-		for (auto& d : detectors)
-			d.setDecay(x, 1);
-		auto d = OnsetDecay0Percent * x;
-		for (auto& dtr : detectors)
-			dtr.setDecay(d, 0);
+		handoff.setDecay(x);
 	}
 
 	void OnsetDetector::setTilt(float db) noexcept
 	{
-		tilt = db;
-		updateTilt();
+		handoff.setTilt(db);
 	}
 
 	void OnsetDetector::setThreshold(float db) noexcept
@@ -265,37 +486,32 @@ namespace dsp
 
 	void OnsetDetector::setBandwidth(double b) noexcept
 	{
-		for (auto& d : detectors)
-			d.setBandwidthPercent(b);
+		handoff.setBandwidth(b);
 	}
 
 	void OnsetDetector::setNumBands(int n) noexcept
 	{
-		numBands = n;
-		updatePitchRange();
-		updateTilt();
+		handoff.setNumBands(n);
 	}
 
 	void OnsetDetector::setLowestPitch(double p) noexcept
 	{
-		lowestPitch = p;
-		updatePitchRange();
+		handoff.setLowestPitch(p);
 	}
 
 	void OnsetDetector::setHighestPitch(double p) noexcept
 	{
-		highestPitch = p;
-		updatePitchRange();
+		handoff.setHighestPitch(p);
 	}
 
 	// process:
 
-	void OnsetDetector::prepare(double _sampleRate) noexcept
+	void OnsetDetector::prepare(double sampleRate) noexcept
 	{
-		sampleRate = _sampleRate;
-		updatePitchRange();
+		handoff.prepare(sampleRate);
 		for (auto& d : detectors)
 			d.prepare(sampleRate);
+		pullSnapshot();
 		strongHold.prepare(sampleRate);
 	}
 
@@ -345,6 +561,7 @@ namespace dsp
 		int numChannels, int numSamples) noexcept
 	{
 		onsetOut = -1;
+		pullSnapshot();
 		for (auto s = 0; s < numSamples; s += BlockSize)
 		{
 			const auto remainingSamples = numSamples - s;
@@ -353,7 +570,7 @@ namespace dsp
 			ProcessorBufferView view;
 			view.assignMain(block, numChannels, numSamplesBlock);
 			operator()(view);
-			if (onsetOut == -1 && onset != -1)
+			if (onset != -1)
 			{
 				onsetOut = onset + s;
 				midi.addEvent(sysex.midify(), onsetOut);
@@ -361,40 +578,13 @@ namespace dsp
 		}
 	}
 
-	void OnsetDetector::updatePitchRange() noexcept
+	void OnsetDetector::pullSnapshot() noexcept
 	{
-		const auto rangePitch = highestPitch - lowestPitch;
-		for (auto i = 0; i < numBands; ++i)
-		{
-			const auto iF = static_cast<float>(i);
-			const auto iR = iF / static_cast<float>(numBands - 1);
-			const auto pitch = lowestPitch + iR * rangePitch;
-			const auto freqHz = static_cast<double>(math::noteToFreqHz2(pitch));
-			const auto pitchLow = pitch - .5f;
-			const auto pitchHigh = pitch + .5f;
-			const auto freqLow = static_cast<double>(math::noteToFreqHz2(pitchLow));
-			const auto freqHigh = static_cast<double>(math::noteToFreqHz2(pitchHigh));
-			const auto bwHz = freqHigh - freqLow;
-			auto& detector = detectors[i];
-			detector.setFreqHz(freqHz);
-			detector.setBandwidth(bwHz);
-			detector.updateFilter();
-		}
-	}
-
-	void OnsetDetector::updateTilt() noexcept
-	{
-		const auto lowestGain = math::dbToAmp(-tilt);
-		const auto highestGain = math::dbToAmp(tilt);
-		const auto rangeGain = highestGain - lowestGain;
-		const auto numBandsInv = 1.f / static_cast<float>(numBands);
-		const auto bandCompensate = numBandsInv * numBandsInv;
-		for (auto i = 0; i < numBands; ++i)
-		{
-			const auto iF = static_cast<float>(i);
-			const auto iR = iF / static_cast<float>(numBands);
-			const auto gain = lowestGain + iR * rangeGain;
-			detectors[i].setGain(gain * bandCompensate);
-		}
+		const auto snapshot = handoff.pull();
+		if (snapshot == nullptr)
+			return;
+		numBands = snapshot->numBands;
+		for (auto i = 0; i < OnsetNumBandsMax; ++i)
+			detectors[i].setCoefficients(snapshot->bands[i]);
 	}
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #if PPDHasOnsetDetector
 #include "OnsetAxiom.h"
 #include "OnsetBuffer.h"
+#include "OnsetSnapshot.h"
+#include "OnsetTripleBuffer.h"
 #include "../Resonator.h"
 #include "../EnvelopeFollower.h"
 #include "../midi/Sysex.h"
@@ -35,6 +37,12 @@ namespace dsp
 
 		void updateFilter() noexcept;
 
+		// coefficients
+		void getCoefficients(OnsetBandCoefficients&) const noexcept;
+
+		// coefficients
+		void setCoefficients(const OnsetBandCoefficients&) noexcept;
+
 		// process:
 
 		// sampleRate
@@ -101,6 +109,98 @@ namespace dsp
 		int timer, length;
 	};
 
+	struct OnsetBandsHandoff;
+
+	// One thread shared by all detectors of the process designs the bands
+	// of every handoff that has new parameters. It sleeps until an audio
+	// thread wakes it up.
+	struct OnsetDesignThread :
+		private juce::Thread
+	{
+		OnsetDesignThread();
+
+		~OnsetDesignThread() override;
+
+		// handoff
+		void add(OnsetBandsHandoff&);
+
+		// handoff
+		void remove(OnsetBandsHandoff&);
+
+		// wakes the thread up (audio thread)
+		void wake() noexcept;
+
+		// held while the thread designs
+		const juce::CriticalSection& getLock() const noexcept;
+	private:
+		juce::CriticalSection lock;
+		std::vector<OnsetBandsHandoff*> handoffs;
+
+		void run() override;
+	};
+
+	// Param callbacks run on the audio thread, but computing the band
+	// coefficients costs pow, log2, exp, cos and sqrt per band. So the
+	// setters only change the audio thread's copy of the parameters, which
+	// pull() publishes as a whole once per block. The design thread
+	// computes the coefficients of all bands from it and the audio thread
+	// picks them up as a snapshot at a later block without locks.
+	struct OnsetBandsHandoff
+	{
+		OnsetBandsHandoff();
+
+		~OnsetBandsHandoff();
+
+		// parameters (audio thread):
+
+		void setAttack(double) noexcept;
+
+		void setDecay(double) noexcept;
+
+		void setTilt(float) noexcept;
+
+		void setBandwidth(double) noexcept;
+
+		void setNumBands(int) noexcept;
+
+		void setLowestPitch(double) noexcept;
+
+		void setHighestPitch(double) noexcept;
+
+		// computes the coefficients right away. processing must be suspended.
+		// sampleRate
+		void prepare(double) noexcept;
+
+		// process (audio thread):
+
+		// publishes changed parameters and returns
+		// the latest snapshot or nullptr, if there is no new one
+		const OnsetSnapshot* pull() noexcept;
+
+		// design thread:
+
+		// designs the bands, if there are new parameters
+		void update() noexcept;
+	private:
+		juce::SharedResourcePointer<OnsetDesignThread> thread;
+		std::array<OnsetCore, OnsetNumBandsMax> designers;
+		OnsetTripleBuffer<OnsetBandsParams> params;
+		OnsetTripleBuffer<OnsetSnapshot> snapshots;
+		// the audio thread's copy and whether pull() has yet to publish it
+		OnsetBandsParams paramsAudio;
+		bool paramsChanged;
+
+		// computes and publishes the coefficients of all bands
+		// params
+		void design(const OnsetBandsParams&) noexcept;
+
+		// numBands, lowestPitch, highestPitch
+		void updatePitchRange(int, double, double) noexcept;
+
+		// numBands, tilt
+		void updateTilt(int, float) noexcept;
+	};
+
 	struct OnsetDetector
 	{
 		OnsetDetector();
@@ -137,15 +237,13 @@ namespace dsp
 	private:
 		OnsetBuffer buffer;
 		std::array<OnsetCore, OnsetNumBandsMax> detectors;
+		OnsetBandsHandoff handoff;
 		OnsetStrongHold strongHold;
-		double sampleRate, lowestPitch, highestPitch;
-		float threshold, tilt;
+		float threshold;
 		int numBands, onset, onsetOut;
 		Sysex sysex;
 
-		void updatePitchRange() noexcept;
-
-		void updateTilt() noexcept;
+		void pullSnapshot() noexcept;
 	};
 }
 #endif
@@ -0,0 +1,32 @@
+/*
+  ==============================================================================
+
+    OnsetSnapshot.cpp
+    Created: 16 Oct 2026 11:02:47am
+    Author:  Xi
+
+  ==============================================================================
+*/
+
+#include "OnsetSnapshot.h"
+#include "../../../arch/Math.h"
+
+namespace dsp
+{
+	OnsetBandsParams::OnsetBandsParams() :
+		attack(OnsetAtkDefault),
+		decay(OnsetDcyDefault),
+		bandwidth(std::pow(2., static_cast<double>(OnsetBandwidthDefault))),
+		lowestPitch(math::freqHzToNote2(OnsetLowestFreqHz)),
+		highestPitch(math::freqHzToNote2(OnsetHighestFreqHz)),
+		tilt(OnsetTiltDefault),
+		numBands(static_cast<int>(OnsetNumBandsDefault))
+	{
+	}
+
+	OnsetSnapshot::OnsetSnapshot() :
+		bands(),
+		numBands(0)
+	{
+	}
+}
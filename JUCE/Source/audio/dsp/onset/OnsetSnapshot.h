@@ -0,0 +1,39 @@
+#pragma once
+#if PPDHasOnsetDetector
+#include "OnsetAxiom.h"
+#include <array>
+
+namespace dsp
+{
+	// the parameters the bands are designed from, set together on the
+	// audio thread and handed to the designer as a whole
+	struct OnsetBandsParams
+	{
+		OnsetBandsParams();
+
+		double attack, decay, bandwidth, lowestPitch, highestPitch;
+		float tilt;
+		int numBands;
+	};
+
+	// the coefficients of one band
+	struct OnsetBandCoefficients
+	{
+		// resonator and its highpass
+		double resoA0, resoB1, resoB2, lpX;
+		// fast (0) and slow (1) envelope followers
+		double env0Atk, env0Dcy, env1Atk, env1Dcy;
+		float gain;
+	};
+
+	// The coefficients of all bands at one point in time. Computing them
+	// costs pow, log2, exp, cos and sqrt per band, copying them doesn't.
+	struct OnsetSnapshot
+	{
+		OnsetSnapshot();
+
+		std::array<OnsetBandCoefficients, OnsetNumBandsMax> bands;
+		int numBands;
+	};
+}
+#endif
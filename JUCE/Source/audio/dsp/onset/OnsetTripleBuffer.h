@@ -0,0 +1,60 @@
+#pragma once
+#if PPDHasOnsetDetector
+#include <array>
+#include <atomic>
+
+namespace dsp
+{
+	// Hands the latest T from one writer thread to one reader thread
+	// without locks. The writer fills the back slot and publishes it, the
+	// reader picks up the most recently published slot whenever it wants.
+	// Neither side ever waits for the other, values in between can be
+	// skipped.
+	template<class T>
+	struct OnsetTripleBuffer
+	{
+		OnsetTripleBuffer() :
+			slots(),
+			back(0),
+			front(2),
+			middle(1)
+		{ }
+
+		// writer:
+
+		T& getBack() noexcept
+		{
+			return slots[back];
+		}
+
+		void publish() noexcept
+		{
+			back = middle.exchange(back | Fresh, std::memory_order_acq_rel) & Index;
+		}
+
+		// reader:
+
+		// switches to the latest published slot and returns if there was one
+		bool update() noexcept
+		{
+			if ((middle.load(std::memory_order_relaxed) & Fresh) == 0)
+				return false;
+			front = middle.exchange(front, std::memory_order_acq_rel) & Index;
+			return true;
+		}
+
+		const T& getFront() const noexcept
+		{
+			return slots[front];
+		}
+	private:
+		// middle holds the index of a slot and whether it is unread
+		static constexpr int Index = 3;
+		static constexpr int Fresh = 4;
+
+		std::array<T, 3> slots;
+		int back, front;
+		std::atomic<int> middle;
+	};
+}
+#endif
\ No newline at end of file
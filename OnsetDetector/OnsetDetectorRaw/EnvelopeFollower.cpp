@@ -1,11 +1,12 @@
 #include "EnvelopeFollower.h"
+#include <algorithm>
 #include <cmath>
 
 namespace dsp
 {
 	// Params
 
-	EnvelopeFollower::Params::Params(float _atkMs,
+	EnvelopeFollowerParams::EnvelopeFollowerParams(float _atkMs,
 		float _dcyMs) :
 		sampleRate(1.),
 		atkMs(_atkMs),
@@ -15,20 +16,20 @@ namespace dsp
 	{
 	}
 
-	void EnvelopeFollower::Params::prepare(double _sampleRate) noexcept
+	void EnvelopeFollowerParams::prepare(double _sampleRate) noexcept
 	{
 		sampleRate = _sampleRate;
 		setAtk(atkMs);
 		setDcy(dcyMs);
 	}
 
-	void EnvelopeFollower::Params::setAtk(double ms) noexcept
+	void EnvelopeFollowerParams::setAtk(double ms) noexcept
 	{
 		atkMs = ms;
 		atk = Lowpass::getXFromMs(atkMs, sampleRate);
 	}
 
-	void EnvelopeFollower::Params::setDcy(double ms) noexcept
+	void EnvelopeFollowerParams::setDcy(double ms) noexcept
 	{
 		dcyMs = ms;
 		dcy = Lowpass::getXFromMs(dcyMs, sampleRate);
@@ -41,61 +42,126 @@ namespace dsp
 		return std::pow(10., db / 20.);
 	}
 
-	EnvelopeFollower::EnvelopeFollower() :
+	template<typename Float>
+	EnvelopeFollowerT<Float>::EnvelopeFollowerT() :
 		params(),
 		buffer(),
-		MinDb(dbToAmp(-60.)),
+		kernels(&selectOnsetKernels()),
+		MinDb(static_cast<Float>(dbToAmp(-60.))),
 		envLP(0.),
 		attackState(false)
 	{
 	}
 
-	void EnvelopeFollower::prepare(double sampleRate) noexcept
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::prepare(double sampleRate) noexcept
 	{
 		params.prepare(sampleRate);
-		reset(-120.);
+		reset(dbToAmp(-120.));
 	}
 
-	void EnvelopeFollower::setAttack(double ms) noexcept
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::setKernels(const OnsetKernels& k) noexcept
+	{
+		kernels = &k;
+	}
+
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::setAttack(double ms) noexcept
 	{
 		params.setAtk(ms);
+		if (attackState)
+			envLP.setX(params.atk);
 	}
 
-	void EnvelopeFollower::setDecay(double ms) noexcept
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::setDecay(double ms) noexcept
 	{
 		params.setDcy(ms);
+		if (!attackState)
+			envLP.setX(params.dcy);
 	}
 
-	void EnvelopeFollower::operator()(float** samples, int numChannels, int numSamples) noexcept
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::setCoefficients(double atk, double dcy) noexcept
+	{
+		params.atk = atk;
+		params.dcy = dcy;
+		envLP.setX(attackState ? atk : dcy);
+	}
+
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::operator()(float** samples, int numChannels, int numSamples) noexcept
 	{
 		copyMid(samples, numChannels, numSamples);
 		operator()(buffer.data(), numSamples);
 	}
 
-	bool EnvelopeFollower::isSleepy() const noexcept
+	template<typename Float>
+	bool EnvelopeFollowerT<Float>::isSleepy() const noexcept
 	{
 		return !attackState && envLP.y1 < MinDb;
 	}
 
-	float EnvelopeFollower::operator[](int i) const noexcept
+	template<typename Float>
+	Float EnvelopeFollowerT<Float>::getEnvelope() const noexcept
+	{
+		return envLP.y1;
+	}
+
+	template<typename Float>
+	bool EnvelopeFollowerT<Float>::isAttacking() const noexcept
+	{
+		return attackState;
+	}
+
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::setState(double envelope, bool attack) noexcept
+	{
+		envLP.y1 = static_cast<Float>(envelope);
+		attackState = attack;
+		envLP.setX(attack ? params.atk : params.dcy);
+	}
+
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::skipSilence(int64_t numSamples) noexcept
+	{
+		// every sample of silence multiplies the envelope by dcy
+		attackState = false;
+		envLP.setX(params.dcy);
+		envLP.y1 *= static_cast<Float>(std::pow(params.dcy, static_cast<double>(numSamples)));
+	}
+
+	template<typename Float>
+	float EnvelopeFollowerT<Float>::operator[](int i) const noexcept
 	{
 		return buffer[i];
 	}
 
-	void EnvelopeFollower::reset(double v)
+	template<typename Float>
+	const EnvelopeFollowerParams& EnvelopeFollowerT<Float>::getParams() const noexcept
+	{
+		return params;
+	}
+
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::reset(double v)
 	{
 		const auto vF = static_cast<float>(v);
 		envLP.reset(v);
+		envLP.setX(params.dcy);
 		attackState = false;
 	}
 
-	void EnvelopeFollower::operator()(float* smpls, int numSamples) noexcept
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::operator()(float* smpls, int numSamples) noexcept
 	{
 		rectify(smpls, numSamples);
 		synthesizeEnvelope(numSamples);
 	}
 
-	void EnvelopeFollower::copyMid(float** samples, int numChannels, int numSamples) noexcept
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::copyMid(float** samples, int numChannels, int numSamples) noexcept
 	{
 		auto envFolBuffer = buffer.data();
 		for(auto s = 0; s < numSamples; ++s)
@@ -110,40 +176,38 @@ namespace dsp
 		}
 	}
 
-	void EnvelopeFollower::rectify(float* smpls, int numSamples) noexcept
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::rectify(float* smpls, int numSamples) noexcept
 	{
 		for (auto s = 0; s < numSamples; ++s)
 			buffer[s] = std::abs(smpls[s]);
 	}
 
-	void EnvelopeFollower::synthesizeEnvelope(int numSamples) noexcept
+	template<typename Float>
+	void EnvelopeFollowerT<Float>::synthesizeEnvelope(int numSamples) noexcept
 	{
-		for (auto s = 0; s < numSamples; ++s)
+		// while the envelope stays in attack or decay it is a plain
+		// one-pole, so whole registers go through the lowpass scan. the
+		// register where it switches and the rest go sample by sample.
+		const auto width = envLP.getScanWidth(*kernels);
+		auto s = 0;
+		while (s < numSamples)
 		{
-			const auto s0 = envLP.y1;
-			const auto s1 = static_cast<double>(buffer[s]);
-			if (attackState)
-				buffer[s] = static_cast<float>(processAttack(s0, s1));
-			else
-				buffer[s] = static_cast<float>(processDecay(s0, s1));
+			const auto bound = attackState ? OnsetScanBound::Rising : OnsetScanBound::Falling;
+			s += envLP.scan(*kernels, buffer.data() + s, bound, numSamples - s);
+			const auto end = std::min(s + width, numSamples);
+			for (; s < end; ++s)
+			{
+				const auto s0 = envLP.y1;
+				const auto s1 = static_cast<Float>(buffer[s]);
+				if (attackState)
+					buffer[s] = static_cast<float>(processAttack(s0, s1));
+				else
+					buffer[s] = static_cast<float>(processDecay(s0, s1));
+			}
 		}
 	}
 
-	double EnvelopeFollower::processAttack(double s0, double s1) noexcept
-	{
-		if (s0 <= s1)
-			return envLP(s1);
-		attackState = false;
-		envLP.setX(params.dcy);
-		return processDecay(s0, s1);
-	}
-
-	double EnvelopeFollower::processDecay(double s0, double s1) noexcept
-	{
-		if (s0 >= s1)
-			return envLP(s1);
-		attackState = true;
-		envLP.setX(params.atk);
-		return processAttack(s0, s1);
-	}
+	template struct EnvelopeFollowerT<double>;
+	template struct EnvelopeFollowerT<float>;
 }
\ No newline at end of file
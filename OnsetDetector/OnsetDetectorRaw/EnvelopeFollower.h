@@ -2,44 +2,59 @@
 #include "OnsetAxiom.h"
 #include "Smooth.h"
 #include <array>
+#include <cmath>
+#include <cstdint>
 #include <functional>
 
 namespace dsp
 {
-	struct EnvelopeFollower
+	// the coefficients of every EnvelopeFollowerT, always in double
+	struct EnvelopeFollowerParams
 	{
-		using FilterFunc = std::function<void(float*, int)>;
+		// atkMs, dcyMs
+		EnvelopeFollowerParams(float = 1.f, float = 100.f);
 
-		struct Params
-		{
-			// atkMs, dcyMs
-			Params(float = 1.f, float = 100.f);
+		// sampleRate
+		void prepare(double) noexcept;
 
-			// sampleRate
-			void prepare(double) noexcept;
+		// ms
+		void setAtk(double) noexcept;
 
-			// ms
-			void setAtk(double) noexcept;
+		// ms
+		void setDcy(double) noexcept;
+	private:
+		double sampleRate, atkMs, dcyMs;
+		Lowpass gainPRM;
+	public:
+		double atk, dcy;
+	};
 
-			// ms
-			void setDcy(double) noexcept;
-		private:
-			double sampleRate, atkMs, dcyMs;
-			Lowpass gainPRM;
-		public:
-			double atk, dcy;
-		};
+	// Float is the type of the envelope while processing. In float the
+	// one-pole's gain is off by up to 2^-24 / (1 - dcy), 0.03% for a 100ms
+	// decay at 48khz, and the envelope is quantized to 24 bits.
+	template<typename Float>
+	struct EnvelopeFollowerT
+	{
+		using FilterFunc = std::function<void(float*, int)>;
+		using Params = EnvelopeFollowerParams;
 
-		EnvelopeFollower();
+		EnvelopeFollowerT();
 
 		void prepare(double) noexcept;
 
+		// the buffer path (operator()) runs on their lowpass scan
+		void setKernels(const OnsetKernels&) noexcept;
+
 		// parameters:
 
 		void setAttack(double) noexcept;
 
 		void setDecay(double) noexcept;
 
+		// coefficients computed by another EnvelopeFollower's Params
+		// atk, dcy
+		void setCoefficients(double, double) noexcept;
+
 		// process:
 
 		void reset(double);
@@ -49,14 +64,33 @@ namespace dsp
 		// smpls, numSamples
 		void operator()(float*, int) noexcept;
 
+		// rectifies and follows a single sample without touching the buffer
+		Float processSample(float) noexcept;
+
 		bool isSleepy() const noexcept;
 
+		// the envelope's current value
+		Float getEnvelope() const noexcept;
+
+		bool isAttacking() const noexcept;
+
+		// continues from another envelope
+		// envelope, attack
+		void setState(double, bool) noexcept;
+
+		// advances the envelope by numSamples of silent input at once
+		// numSamples
+		void skipSilence(int64_t) noexcept;
+
 		float operator[](int i) const noexcept;
+
+		const Params& getParams() const noexcept;
 	private:
 		Params params;
 		std::array<float, BlockSize> buffer;
-		const double MinDb;
-		Lowpass envLP;
+		const OnsetKernels* kernels;
+		const Float MinDb;
+		LowpassT<Float> envLP;
 		bool attackState;
 
 		void copyMid(float**, int, int) noexcept;
@@ -68,9 +102,44 @@ namespace dsp
 		void synthesizeEnvelope(int) noexcept;
 
 		// s0, s1
-		double processAttack(double, double) noexcept;
+		Float processAttack(Float, Float) noexcept;
 
 		// s0, s1
-		double processDecay(double, double) noexcept;
+		Float processDecay(Float, Float) noexcept;
 	};
+
+	using EnvelopeFollower = EnvelopeFollowerT<double>;
+	using EnvelopeFollowerF = EnvelopeFollowerT<float>;
+
+	// per sample. defined here, so that the loops around them can inline them.
+
+	template<typename Float>
+	inline Float EnvelopeFollowerT<Float>::processSample(float smpl) noexcept
+	{
+		const auto s0 = envLP.y1;
+		const auto s1 = static_cast<Float>(std::abs(smpl));
+		if (attackState)
+			return processAttack(s0, s1);
+		return processDecay(s0, s1);
+	}
+
+	template<typename Float>
+	inline Float EnvelopeFollowerT<Float>::processAttack(Float s0, Float s1) noexcept
+	{
+		if (s0 <= s1)
+			return envLP(s1);
+		attackState = false;
+		envLP.setX(params.dcy);
+		return processDecay(s0, s1);
+	}
+
+	template<typename Float>
+	inline Float EnvelopeFollowerT<Float>::processDecay(Float s0, Float s1) noexcept
+	{
+		if (s0 >= s1)
+			return envLP(s1);
+		attackState = true;
+		envLP.setX(params.atk);
+		return processAttack(s0, s1);
+	}
 }
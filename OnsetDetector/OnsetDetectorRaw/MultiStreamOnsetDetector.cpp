@@ -0,0 +1,284 @@
+#include "MultiStreamOnsetDetector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dsp
+{
+	namespace
+	{
+		// lanes
+		template<class Lanes>
+		void resetLanes(Lanes& l) noexcept
+		{
+			using Float = typename Lanes::Streams::value_type;
+			const auto zero = static_cast<Float>(0.);
+			for (auto b = 0; b < OnsetNumBandsMax; ++b)
+			{
+				l.resoZ1[b].fill(zero);
+				l.resoZ2[b].fill(zero);
+				l.lpY1[b].fill(zero);
+				// same start value as EnvelopeFollower::prepare (-120db)
+				l.env0Y1[b].fill(static_cast<Float>(1e-6));
+				l.env1Y1[b].fill(static_cast<Float>(1e-6));
+				l.env0State[b].fill(zero);
+				l.env1State[b].fill(zero);
+			}
+		}
+
+		// band b's state from the lanes of one precision to the other's
+		// from, to, b
+		template<class From, class To>
+		void moveBand(const From& from, To& to, int b) noexcept
+		{
+			using Float = typename To::Streams::value_type;
+			const auto zero = static_cast<Float>(0.);
+			const auto attack = getOnsetTrueMask<Float>();
+			const auto numStreams = static_cast<int>(to.resoZ1[b].size());
+			for (auto i = 0; i < numStreams; ++i)
+			{
+				to.resoZ1[b][i] = static_cast<Float>(from.resoZ1[b][i]);
+				to.resoZ2[b][i] = static_cast<Float>(from.resoZ2[b][i]);
+				to.lpY1[b][i] = static_cast<Float>(from.lpY1[b][i]);
+				to.env0Y1[b][i] = static_cast<Float>(from.env0Y1[b][i]);
+				to.env1Y1[b][i] = static_cast<Float>(from.env1Y1[b][i]);
+				// the states are masks, all bits or none
+				to.env0State[b][i] = from.env0State[b][i] != 0 ? attack : zero;
+				to.env1State[b][i] = from.env1State[b][i] != 0 ? attack : zero;
+			}
+		}
+	}
+
+	template<int NumStreams>
+	MultiStreamOnsetDetector<NumStreams>::MultiStreamOnsetDetector() :
+		bands(),
+		triggers(),
+		lanes(),
+		lanesF(),
+		input(), odf(),
+		kernels(nullptr),
+		kernelsF(nullptr),
+		maxISA(OnsetISA::AVX512),
+		precision(OnsetPrecision::Mixed),
+		floatBands(0),
+		position(0)
+	{
+		selectKernels();
+		reset();
+		updateFloatBands();
+	}
+
+	// parameters (all streams):
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setAttack(double x) noexcept
+	{
+		bands.setAttack(x);
+		updateFloatBands();
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setDecay(double x) noexcept
+	{
+		bands.setDecay(x);
+		updateFloatBands();
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setTilt(float db) noexcept
+	{
+		bands.setTilt(db);
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setBandwidth(double b) noexcept
+	{
+		bands.setBandwidth(b);
+		updateFloatBands();
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setNumBands(int n) noexcept
+	{
+		bands.setNumBands(n);
+		updateFloatBands();
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setLowestPitch(double p) noexcept
+	{
+		bands.setLowestPitch(p);
+		updateFloatBands();
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setHighestPitch(double p) noexcept
+	{
+		bands.setHighestPitch(p);
+		updateFloatBands();
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setPrecision(OnsetPrecision p) noexcept
+	{
+		precision = p;
+		updateFloatBands();
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setMaxISA(OnsetISA isa) noexcept
+	{
+		maxISA = isa;
+	}
+
+	// parameters (per stream):
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setThreshold(float db, int stream) noexcept
+	{
+		triggers[stream].setThreshold(db);
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::setHoldLength(double ms, int stream) noexcept
+	{
+		triggers[stream].setHoldLength(ms);
+	}
+
+	// process:
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::prepare(double sampleRate) noexcept
+	{
+		selectKernels();
+		bands.prepare(sampleRate);
+		for (auto& t : triggers)
+			t.prepare(sampleRate);
+		position = 0;
+		reset();
+		updateFloatBands();
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::operator()(const float* const* inputs, int numSamples,
+		OnsetEvents* const* events) noexcept
+	{
+		for (auto s = 0; s < numSamples; s += BlockSize)
+		{
+			const auto remainingSamples = numSamples - s;
+			const auto numSamplesBlock = remainingSamples < BlockSize ? remainingSamples : BlockSize;
+			processBlock(inputs, s, numSamplesBlock, events);
+		}
+	}
+
+	template<int NumStreams>
+	int64_t MultiStreamOnsetDetector<NumStreams>::getPosition() const noexcept
+	{
+		return position;
+	}
+
+	template<int NumStreams>
+	OnsetISA MultiStreamOnsetDetector<NumStreams>::getISA() const noexcept
+	{
+		return kernels->isa;
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::reset() noexcept
+	{
+		resetLanes(lanes);
+		resetLanes(lanesF);
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::selectKernels() noexcept
+	{
+		kernels = kernelsF = &selectOnsetKernels(maxISA);
+		while (kernels->width > NumStreams && kernels->isa != OnsetISA::Scalar)
+			kernels = &selectOnsetKernels(static_cast<OnsetISA>(static_cast<int>(kernels->isa) - 1));
+		while (kernelsF->widthF > NumStreams && kernelsF->isa != OnsetISA::Scalar)
+			kernelsF = &selectOnsetKernels(static_cast<OnsetISA>(static_cast<int>(kernelsF->isa) - 1));
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::updateFloatBands() noexcept
+	{
+		const auto numBands = bands.getNumBands();
+		auto newFloatBands = uint32_t(0);
+		for (auto b = 0; b < numBands; ++b)
+			if (precision == OnsetPrecision::Mixed && bands[b].fitsFloat())
+				newFloatBands |= 1u << b;
+		// the bands that change lanes take their state with them
+		for (auto b = 0; b < OnsetNumBandsMax; ++b)
+		{
+			const auto bit = 1u << b;
+			if ((floatBands & bit) == (newFloatBands & bit))
+				continue;
+			if (newFloatBands & bit)
+				moveBand(lanes, lanesF, b);
+			else
+				moveBand(lanesF, lanes, b);
+		}
+		floatBands = newFloatBands;
+	}
+
+	template<int NumStreams>
+	template<typename Float>
+	OnsetStreamBandT<Float> MultiStreamOnsetDetector<NumStreams>::getBand(int b, Lanes<Float>& l) const noexcept
+	{
+		const auto& core = bands[b];
+		const auto& reso = core.getResonator();
+		const auto& lp = reso.getLowpass();
+		const auto& env0 = core.getEnvelopeFollower(0).getParams();
+		const auto& env1 = core.getEnvelopeFollower(1).getParams();
+		return
+		{
+			static_cast<Float>(reso.a0), static_cast<Float>(reso.b1), static_cast<Float>(reso.b2),
+			static_cast<Float>(lp.a0), static_cast<Float>(lp.b1),
+			static_cast<Float>(env0.atk), static_cast<Float>(env0.dcy),
+			static_cast<Float>(env1.atk), static_cast<Float>(env1.dcy),
+			static_cast<Float>(core.getGain()),
+			l.resoZ1[b].data(), l.resoZ2[b].data(), l.lpY1[b].data(),
+			l.env0Y1[b].data(), l.env0State[b].data(), l.env1Y1[b].data(), l.env1State[b].data()
+		};
+	}
+
+	template<int NumStreams>
+	void MultiStreamOnsetDetector<NumStreams>::processBlock(const float* const* inputs, int offset,
+		int numSamples, OnsetEvents* const* events) noexcept
+	{
+		// interleave the rectified streams
+		for (auto i = 0; i < NumStreams; ++i)
+		{
+			const auto smpls = inputs[i] + offset;
+			for (auto s = 0; s < numSamples; ++s)
+				input[s * NumStreams + i] = std::abs(smpls[s]);
+		}
+		std::fill(odf.begin(), odf.begin() + numSamples * NumStreams, 0.f);
+
+		const auto numBands = bands.getNumBands();
+		for (auto b = 0; b < numBands; ++b)
+		{
+			if (floatBands & (1u << b))
+				kernelsF->processStreamsF(getBand(b, lanesF), NumStreams, input.data(), odf.data(), numSamples);
+			else
+				kernels->processStreams(getBand(b, lanes), NumStreams, input.data(), odf.data(), numSamples);
+		}
+
+		const auto numBandsF = static_cast<float>(numBands);
+		for (auto i = 0; i < NumStreams; ++i)
+		{
+			auto& trigger = triggers[i];
+			const auto e = events == nullptr ? nullptr : events[i];
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				const auto val = std::sqrt(odf[s * NumStreams + i] / numBandsF);
+				trigger(val, position + s, e);
+			}
+		}
+		position += numSamples;
+	}
+
+	template struct MultiStreamOnsetDetector<4>;
+	template struct MultiStreamOnsetDetector<8>;
+	template struct MultiStreamOnsetDetector<16>;
+}
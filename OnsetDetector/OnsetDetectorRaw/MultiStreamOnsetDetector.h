@@ -0,0 +1,108 @@
+#pragma once
+#include "OnsetDetector.h"
+
+namespace dsp
+{
+	// Runs the onset detection of NumStreams independent mono streams at once.
+	// All streams share the band parameters, but every stream has its own
+	// filter and envelope state, threshold and hold. The state is interleaved
+	// by stream, so each band advances a whole register of streams per
+	// instruction, which also pays off with few bands. The kernels are the
+	// detector's (see OnsetKernels): a register holds 4 streams in double
+	// or 8 in float with AVX2, 8 or 16 with AVX-512. The bands that fit
+	// float (see ResonatorBaseT::fitsFloat) run in the float lanes.
+	// prepare() picks the widest kernels whose registers NumStreams fills,
+	// for each precision on its own, so that no stream runs a lane at a time.
+	template<int NumStreams>
+	struct MultiStreamOnsetDetector
+	{
+		MultiStreamOnsetDetector();
+
+		// parameters (all streams):
+
+		void setAttack(double) noexcept;
+
+		void setDecay(double) noexcept;
+
+		void setTilt(float) noexcept;
+
+		void setBandwidth(double) noexcept;
+
+		void setNumBands(int) noexcept;
+
+		void setLowestPitch(double) noexcept;
+
+		void setHighestPitch(double) noexcept;
+
+		// Double: every band in double lanes
+		// Mixed: the bands that fit float in float lanes (default)
+		void setPrecision(OnsetPrecision) noexcept;
+
+		// the widest instruction set prepare() may pick (default: the best one)
+		void setMaxISA(OnsetISA) noexcept;
+
+		// parameters (per stream):
+
+		// db, stream
+		void setThreshold(float, int) noexcept;
+
+		// ms, stream
+		void setHoldLength(double, int) noexcept;
+
+		// process:
+
+		// sampleRate
+		void prepare(double) noexcept;
+
+		// one input and one event list (can be nullptr) per stream.
+		// inputs, numSamples, events
+		void operator()(const float* const*, int, OnsetEvents* const*) noexcept;
+
+		// samples processed since prepare()
+		int64_t getPosition() const noexcept;
+
+		// the instruction set of the active double kernels
+		OnsetISA getISA() const noexcept;
+	private:
+		// every band's state, a lane per stream
+		template<typename Float>
+		struct Lanes
+		{
+			using Streams = std::array<Float, NumStreams>;
+			using Bands = std::array<Streams, OnsetNumBandsMax>;
+
+			alignas(64) Bands resoZ1, resoZ2, lpY1;
+			alignas(64) Bands env0Y1, env0State, env1Y1, env1State;
+		};
+
+		OnsetBands bands;
+		std::array<OnsetTrigger, NumStreams> triggers;
+		Lanes<double> lanes;
+		Lanes<float> lanesF;
+		// NumStreams values per sample
+		alignas(64) std::array<float, BlockSize * NumStreams> input, odf;
+		// the kernels of the double and of the float lanes
+		const OnsetKernels* kernels, * kernelsF;
+		OnsetISA maxISA;
+		OnsetPrecision precision;
+		// bit b: band b runs in lanesF
+		uint32_t floatBands;
+		int64_t position;
+
+		void reset() noexcept;
+
+		// the kernels of up to maxISA whose registers NumStreams fills
+		void selectKernels() noexcept;
+
+		// moves the bands that change precision to their lanes
+		void updateFloatBands() noexcept;
+
+		// the coefficients of band b and its lanes
+		// b, lanes
+		template<typename Float>
+		OnsetStreamBandT<Float> getBand(int, Lanes<Float>&) const noexcept;
+
+		// inputs, offset, numSamples (<= BlockSize), events
+		void processBlock(const float* const*, int, int, OnsetEvents* const*) noexcept;
+	};
+}
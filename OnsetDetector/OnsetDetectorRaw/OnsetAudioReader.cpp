@@ -0,0 +1,284 @@
+#include "OnsetAudioReader.h"
+#include <cstring>
+#include <iostream>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace dsp
+{
+	namespace
+	{
+		static constexpr uint16_t WavFormatPCM = 1;
+		static constexpr uint16_t WavFormatFloat = 3;
+		static constexpr uint16_t WavFormatExtensible = 0xfffe;
+		// streaming writers can't know the data size in advance
+		static constexpr uint32_t WavUnknownSize = 0xffffffff;
+
+		uint16_t readU16(const char* b) noexcept
+		{
+			const auto u = reinterpret_cast<const uint8_t*>(b);
+			return static_cast<uint16_t>(u[0] | (u[1] << 8));
+		}
+
+		uint32_t readU32(const char* b) noexcept
+		{
+			const auto u = reinterpret_cast<const uint8_t*>(b);
+			return static_cast<uint32_t>(u[0])
+				| (static_cast<uint32_t>(u[1]) << 8)
+				| (static_cast<uint32_t>(u[2]) << 16)
+				| (static_cast<uint32_t>(u[3]) << 24);
+		}
+
+		int getBytesPerSample(OnsetSampleFormat format) noexcept
+		{
+			switch (format)
+			{
+			case OnsetSampleFormat::S16: return 2;
+			case OnsetSampleFormat::S24: return 3;
+			case OnsetSampleFormat::S32: return 4;
+			case OnsetSampleFormat::F32: return 4;
+			default: return 8;
+			}
+		}
+
+		float decode(const char* b, OnsetSampleFormat format) noexcept
+		{
+			const auto u = reinterpret_cast<const uint8_t*>(b);
+			switch (format)
+			{
+			case OnsetSampleFormat::S16:
+				return static_cast<float>(static_cast<int16_t>(readU16(b))) * (1.f / 32768.f);
+			case OnsetSampleFormat::S24:
+			{
+				// sign extend from the top byte
+				const auto v = static_cast<int32_t>((static_cast<uint32_t>(u[0]) << 8)
+					| (static_cast<uint32_t>(u[1]) << 16) | (static_cast<uint32_t>(u[2]) << 24)) >> 8;
+				return static_cast<float>(v) * (1.f / 8388608.f);
+			}
+			case OnsetSampleFormat::S32:
+				return static_cast<float>(static_cast<double>(static_cast<int32_t>(readU32(b))) * (1. / 2147483648.));
+			case OnsetSampleFormat::F32:
+			{
+				const auto bits = readU32(b);
+				float f;
+				std::memcpy(&f, &bits, sizeof(f));
+				return f;
+			}
+			default:
+			{
+				const auto bits = static_cast<uint64_t>(readU32(b))
+					| (static_cast<uint64_t>(readU32(b + 4)) << 32);
+				double d;
+				std::memcpy(&d, &bits, sizeof(d));
+				return static_cast<float>(d);
+			}
+			}
+		}
+	}
+
+	OnsetAudioReader::OnsetAudioReader() :
+		file(),
+		stream(nullptr),
+		bytes(),
+		format(OnsetSampleFormat::S16),
+		sampleRate(0.),
+		numFrames(-1), framesLeft(-1),
+		numChannels(0), bytesPerSample(2),
+		error("")
+	{
+	}
+
+	bool OnsetAudioReader::openWav(const char* path)
+	{
+		if (!openStream(path))
+			return false;
+
+		char riff[12];
+		if (!readBytes(riff, 12) || std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0)
+			return fail("not a RIFF/WAVE file");
+
+		auto hasFormat = false;
+		while (true)
+		{
+			char chunk[8];
+			if (!readBytes(chunk, 8))
+				return fail("no data chunk");
+			const auto size = readU32(chunk + 4);
+			// chunks are padded to an even size
+			const auto paddedSize = static_cast<int64_t>(size) + (size & 1);
+			if (std::memcmp(chunk, "fmt ", 4) == 0)
+			{
+				if (size < 16 || size > 64)
+					return fail("invalid fmt chunk");
+				char fmt[64];
+				if (!readBytes(fmt, static_cast<int>(paddedSize)))
+					return fail("truncated fmt chunk");
+				auto tag = readU16(fmt);
+				numChannels = readU16(fmt + 2);
+				sampleRate = static_cast<double>(readU32(fmt + 4));
+				const auto bitsPerSample = readU16(fmt + 14);
+				if (tag == WavFormatExtensible)
+				{
+					if (size < 26)
+						return fail("invalid extensible fmt chunk");
+					// the sub format guid starts with the format tag
+					tag = readU16(fmt + 24);
+				}
+				if (tag == WavFormatPCM && bitsPerSample == 16)
+					format = OnsetSampleFormat::S16;
+				else if (tag == WavFormatPCM && bitsPerSample == 24)
+					format = OnsetSampleFormat::S24;
+				else if (tag == WavFormatPCM && bitsPerSample == 32)
+					format = OnsetSampleFormat::S32;
+				else if (tag == WavFormatFloat && bitsPerSample == 32)
+					format = OnsetSampleFormat::F32;
+				else if (tag == WavFormatFloat && bitsPerSample == 64)
+					format = OnsetSampleFormat::F64;
+				else
+					return fail("unsupported sample format (16/24/32 bit int or 32/64 bit float)");
+				if (numChannels < 1 || sampleRate <= 0.)
+					return fail("invalid fmt chunk");
+				bytesPerSample = getBytesPerSample(format);
+				hasFormat = true;
+			}
+			else if (std::memcmp(chunk, "data", 4) == 0)
+			{
+				if (!hasFormat)
+					return fail("data chunk before fmt chunk");
+				const auto frameSize = bytesPerSample * numChannels;
+				if (size == WavUnknownSize || size == 0)
+					numFrames = framesLeft = -1;
+				else
+					numFrames = framesLeft = static_cast<int64_t>(size) / frameSize;
+				return true;
+			}
+			else if (!skipBytes(paddedSize))
+				return fail("truncated chunk");
+		}
+	}
+
+	bool OnsetAudioReader::openRaw(const char* path, double _sampleRate, int _numChannels, OnsetSampleFormat _format)
+	{
+		if (_sampleRate <= 0. || _numChannels < 1)
+			return fail("raw pcm needs a sample rate and channel count");
+		if (!openStream(path))
+			return false;
+		sampleRate = _sampleRate;
+		numChannels = _numChannels;
+		format = _format;
+		bytesPerSample = getBytesPerSample(format);
+		numFrames = framesLeft = -1;
+		return true;
+	}
+
+	int OnsetAudioReader::read(float* const* channels, int maxFrames)
+	{
+		if (stream == nullptr)
+			return 0;
+		auto numToRead = static_cast<int64_t>(maxFrames);
+		if (framesLeft >= 0 && framesLeft < numToRead)
+			numToRead = framesLeft;
+		const auto frameSize = bytesPerSample * numChannels;
+		bytes.resize(static_cast<size_t>(numToRead * frameSize));
+		stream->read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+		// a partial frame at the end is dropped
+		const auto numRead = static_cast<int>(stream->gcount() / frameSize);
+		auto b = bytes.data();
+		for (auto s = 0; s < numRead; ++s)
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				channels[ch][s] = decode(b, format);
+				b += bytesPerSample;
+			}
+		if (framesLeft >= 0)
+			framesLeft -= numRead;
+		return numRead;
+	}
+
+	double OnsetAudioReader::getSampleRate() const noexcept
+	{
+		return sampleRate;
+	}
+
+	int OnsetAudioReader::getNumChannels() const noexcept
+	{
+		return numChannels;
+	}
+
+	int64_t OnsetAudioReader::getNumFrames() const noexcept
+	{
+		return numFrames;
+	}
+
+	const char* OnsetAudioReader::getError() const noexcept
+	{
+		return error;
+	}
+
+	bool OnsetAudioReader::openStream(const char* path)
+	{
+		if (std::strcmp(path, "-") == 0)
+		{
+#ifdef _WIN32
+			// no newline translation
+			_setmode(_fileno(stdin), _O_BINARY);
+#endif
+			stream = &std::cin;
+			return true;
+		}
+		file.open(path, std::ios::binary);
+		if (!file.is_open())
+			return fail("can't open file");
+		stream = &file;
+		return true;
+	}
+
+	bool OnsetAudioReader::fail(const char* msg) noexcept
+	{
+		error = msg;
+		stream = nullptr;
+		return false;
+	}
+
+	bool OnsetAudioReader::readBytes(char* b, int numBytes)
+	{
+		stream->read(b, numBytes);
+		return stream->gcount() == numBytes;
+	}
+
+	bool OnsetAudioReader::skipBytes(int64_t numBytes)
+	{
+		// stdin can't seek
+		char skip[256];
+		while (numBytes > 0)
+		{
+			const auto n = numBytes < 256 ? static_cast<int>(numBytes) : 256;
+			if (!readBytes(skip, n))
+				return false;
+			numBytes -= n;
+		}
+		return true;
+	}
+
+	bool parseSampleFormat(const char* name, OnsetSampleFormat& format) noexcept
+	{
+		struct Entry { const char* name; OnsetSampleFormat format; };
+		static constexpr Entry Entries[] =
+		{
+			{ "s16", OnsetSampleFormat::S16 },
+			{ "s24", OnsetSampleFormat::S24 },
+			{ "s32", OnsetSampleFormat::S32 },
+			{ "f32", OnsetSampleFormat::F32 },
+			{ "f64", OnsetSampleFormat::F64 }
+		};
+		for (const auto& e : Entries)
+			if (std::strcmp(name, e.name) == 0)
+			{
+				format = e.format;
+				return true;
+			}
+		return false;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <vector>
+
+namespace dsp
+{
+	// sample formats of raw pcm
+	enum class OnsetSampleFormat { S16, S24, S32, F32, F64 };
+
+	// Streams a WAV file or raw interleaved pcm (from a file or stdin) in
+	// chunks and converts it to deinterleaved floats. Never loads the
+	// whole file, so it works on recordings of any length.
+	struct OnsetAudioReader
+	{
+		OnsetAudioReader();
+
+		// reads the header of a WAV file. "-" reads from stdin.
+		// returns false if it can't (see getError).
+		// path
+		bool openWav(const char*);
+
+		// headerless interleaved pcm. "-" reads from stdin.
+		// path, sampleRate, numChannels, format
+		bool openRaw(const char*, double, int, OnsetSampleFormat);
+
+		// reads up to maxFrames into one buffer per channel and returns how
+		// many it read, 0 at the end of the data.
+		// channels, maxFrames
+		int read(float* const*, int);
+
+		double getSampleRate() const noexcept;
+
+		int getNumChannels() const noexcept;
+
+		// -1 if unknown (raw pcm, streamed WAV)
+		int64_t getNumFrames() const noexcept;
+
+		const char* getError() const noexcept;
+	private:
+		std::ifstream file;
+		std::istream* stream;
+		std::vector<char> bytes;
+		OnsetSampleFormat format;
+		double sampleRate;
+		int64_t numFrames, framesLeft;
+		int numChannels, bytesPerSample;
+		const char* error;
+
+		// path
+		bool openStream(const char*);
+
+		// returns false and remembers msg
+		// msg
+		bool fail(const char*) noexcept;
+
+		// bytes, numBytes
+		bool readBytes(char*, int);
+
+		// numBytes
+		bool skipBytes(int64_t);
+	};
+
+	// "s16", "s24", "s32", "f32" or "f64". returns false if unknown.
+	// name, format
+	bool parseSampleFormat(const char*, OnsetSampleFormat&) noexcept;
+}
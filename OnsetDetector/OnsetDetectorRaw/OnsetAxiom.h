@@ -6,6 +6,7 @@ namespace dsp
 
 	static constexpr auto OnsetNumBandsDefault = 12.f;
 	static constexpr auto OnsetNumBandsMax = 16;
+	static constexpr auto OnsetNumGroupsMax = 8;
 	static constexpr auto OnsetLowestFreqHz = 190.12f;
 	static constexpr auto OnsetHighestFreqHz = 14660.f;
 	// Percent params (lin)
@@ -28,4 +29,7 @@ namespace dsp
 	static constexpr auto OnsetHoldDefault = 30.f;
 	// No Param
 	static constexpr auto OnsetDecay0Percent = .354066985646;
+	// input peaks and band states below this are silence (-160db). a band
+	// whose envelopes are this low adds less than 1% of its gain to the odf.
+	static constexpr auto OnsetSleepFloor = 1e-8;
 }
\ No newline at end of file
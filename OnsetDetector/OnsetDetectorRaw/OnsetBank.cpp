@@ -0,0 +1,277 @@
+#include "OnsetBank.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dsp
+{
+	namespace
+	{
+		// the register width and kernel of the lanes' type
+
+		int getWidth(const OnsetKernels& k, double) noexcept
+		{
+			return k.width;
+		}
+
+		int getWidth(const OnsetKernels& k, float) noexcept
+		{
+			return k.widthF;
+		}
+
+		// kernels, math, lanes, numBands, input, output, ratios, numSamples
+		void processBank(const OnsetKernels& k, OnsetMath math, const OnsetBankLanes& l, int numBands,
+			const float* input, float* output, float* const* ratios, int numSamples) noexcept
+		{
+			const auto process = math == OnsetMath::Fast ? k.processBankFast : k.processBank;
+			process(l, numBands, input, output, ratios, numSamples);
+		}
+
+		// kernels, math, lanes, numBands, input, output, ratios, numSamples
+		void processBank(const OnsetKernels& k, OnsetMath math, const OnsetBankLanesF& l, int numBands,
+			const float* input, float* output, float* const* ratios, int numSamples) noexcept
+		{
+			const auto process = math == OnsetMath::Fast ? k.processBankFastF : k.processBankF;
+			process(l, numBands, input, output, ratios, numSamples);
+		}
+	}
+
+	// OnsetBandState
+
+	void OnsetBandState::saveState(OnsetStateWriter& w) const noexcept
+	{
+		w(resoZ1);
+		w(resoZ2);
+		w(lpY1);
+		w(env0Y1);
+		w(env1Y1);
+		w(env0Attack);
+		w(env1Attack);
+	}
+
+	void OnsetBandState::restoreState(OnsetStateReader& r) noexcept
+	{
+		r(resoZ1);
+		r(resoZ2);
+		r(lpY1);
+		r(env0Y1);
+		r(env1Y1);
+		r(env0Attack);
+		r(env1Attack);
+	}
+
+	// OnsetBank
+
+	template<typename Float>
+	OnsetBankT<Float>::OnsetBankT() :
+		resoA0(), resoB1(), resoB2(), resoZ1(), resoZ2(),
+		lpA0(), lpB1(), lpY1(),
+		env0Y1(), env0Atk(), env0Dcy(), env0State(),
+		env1Y1(), env1Atk(), env1Dcy(), env1State(),
+		gain(),
+		sleptAt(),
+		kernels(&selectOnsetKernels()),
+		clock(0),
+		numBands(0), numAwake(0),
+		math(OnsetMath::Exact)
+	{
+		reset();
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::setBand(int i, const Resonator3& reso,
+		const EnvelopeFollower::Params& fastEnv,
+		const EnvelopeFollower::Params& slowEnv, float g) noexcept
+	{
+		resoA0[i] = static_cast<Float>(reso.a0);
+		resoB1[i] = static_cast<Float>(reso.b1);
+		resoB2[i] = static_cast<Float>(reso.b2);
+		const auto& lp = reso.getLowpass();
+		lpA0[i] = static_cast<Float>(lp.a0);
+		lpB1[i] = static_cast<Float>(lp.b1);
+		env0Atk[i] = static_cast<Float>(fastEnv.atk);
+		env0Dcy[i] = static_cast<Float>(fastEnv.dcy);
+		env1Atk[i] = static_cast<Float>(slowEnv.atk);
+		env1Dcy[i] = static_cast<Float>(slowEnv.dcy);
+		gain[i] = static_cast<Float>(g);
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::clearBand(int i) noexcept
+	{
+		const auto zero = static_cast<Float>(0.);
+		resoA0[i] = resoB1[i] = resoB2[i] = zero;
+		lpA0[i] = lpB1[i] = zero;
+		env0Atk[i] = env0Dcy[i] = zero;
+		env1Atk[i] = env1Dcy[i] = zero;
+		gain[i] = zero;
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::getState(int i, OnsetBandState& state) const noexcept
+	{
+		state.resoZ1 = static_cast<double>(resoZ1[i]);
+		state.resoZ2 = static_cast<double>(resoZ2[i]);
+		state.lpY1 = static_cast<double>(lpY1[i]);
+		state.env0Y1 = static_cast<double>(env0Y1[i]);
+		state.env1Y1 = static_cast<double>(env1Y1[i]);
+		// the states are masks, all bits or none
+		state.env0Attack = env0State[i] != static_cast<Float>(0.);
+		state.env1Attack = env1State[i] != static_cast<Float>(0.);
+		if (i < getNumLanes(numAwake))
+			return;
+		state.env0Attack = state.env1Attack = false;
+		// a sleeping lane's envelopes didn't catch up yet, see wake()
+		const auto n = static_cast<double>(clock - sleptAt[i]);
+		state.env0Y1 *= std::pow(static_cast<double>(env0Dcy[i]), n);
+		state.env1Y1 *= std::pow(static_cast<double>(env1Dcy[i]), n);
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::setState(int i, const OnsetBandState& state) noexcept
+	{
+		resoZ1[i] = static_cast<Float>(state.resoZ1);
+		resoZ2[i] = static_cast<Float>(state.resoZ2);
+		lpY1[i] = static_cast<Float>(state.lpY1);
+		env0Y1[i] = static_cast<Float>(state.env0Y1);
+		env1Y1[i] = static_cast<Float>(state.env1Y1);
+		const auto zero = static_cast<Float>(0.);
+		env0State[i] = state.env0Attack ? getOnsetTrueMask<Float>() : zero;
+		env1State[i] = state.env1Attack ? getOnsetTrueMask<Float>() : zero;
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::setNumBands(int n) noexcept
+	{
+		wake();
+		numBands = numAwake = n;
+		// the kernels round up to whole registers
+		for (auto i = n; i < OnsetNumBandsMax; ++i)
+			clearBand(i);
+	}
+
+	template<typename Float>
+	int OnsetBankT<Float>::getNumBands() const noexcept
+	{
+		return numBands;
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::setKernels(const OnsetKernels& k) noexcept
+	{
+		// the lanes that run depend on the register width
+		wake();
+		kernels = &k;
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::setMath(OnsetMath m) noexcept
+	{
+		math = m;
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::reset() noexcept
+	{
+		const auto zero = static_cast<Float>(0.);
+		for (auto i = 0; i < OnsetNumBandsMax; ++i)
+		{
+			resoZ1[i] = resoZ2[i] = zero;
+			lpY1[i] = zero;
+			// same start value as EnvelopeFollower::prepare (-120db)
+			env0Y1[i] = env1Y1[i] = static_cast<Float>(1e-6);
+			env0State[i] = env1State[i] = zero;
+		}
+		clock = 0;
+		numAwake = numBands;
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::operator()(const float* input, float* output, int numSamples, bool silent,
+		float* const* ratios) noexcept
+	{
+		if (!silent)
+			wake();
+		const OnsetBankLanesT<Float> lanes
+		{
+			resoA0.data(), resoB1.data(), resoB2.data(), resoZ1.data(), resoZ2.data(),
+			lpA0.data(), lpB1.data(), lpY1.data(),
+			env0Y1.data(), env0Atk.data(), env0Dcy.data(), env0State.data(),
+			env1Y1.data(), env1Atk.data(), env1Dcy.data(), env1State.data(),
+			gain.data()
+		};
+		// whole registers run, so the bands up to the last awake one's register do
+		const auto numRunning = std::min(getNumLanes(numAwake), numBands);
+		processBank(*kernels, math, lanes, numRunning, input, output, ratios, numSamples);
+		// the sleeping bands add nothing
+		if (ratios != nullptr)
+			for (auto i = numRunning; i < numBands; ++i)
+				std::fill(ratios[i], ratios[i] + numSamples, 0.f);
+		clock += numSamples;
+		if (silent)
+			updateSleep();
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::sleep(int64_t numSamples) noexcept
+	{
+		clock += numSamples;
+	}
+
+	template<typename Float>
+	bool OnsetBankT<Float>::isAsleep() const noexcept
+	{
+		return numAwake == 0;
+	}
+
+	template<typename Float>
+	bool OnsetBankT<Float>::isAsleep(int i) const noexcept
+	{
+		return std::abs(resoZ1[i]) < OnsetSleepFloor
+			&& std::abs(resoZ2[i]) < OnsetSleepFloor
+			&& std::abs(lpY1[i]) < OnsetSleepFloor
+			&& env0Y1[i] < OnsetSleepFloor
+			&& env1Y1[i] < OnsetSleepFloor;
+	}
+
+	template<typename Float>
+	int OnsetBankT<Float>::getNumLanes(int n) const noexcept
+	{
+		const auto width = getWidth(*kernels, Float());
+		const auto numLanes = (n + width - 1) / width * width;
+		return numLanes < numBands ? numLanes : numBands;
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::wake() noexcept
+	{
+		for (auto i = getNumLanes(numAwake); i < numBands; ++i)
+		{
+			// every sample of silence multiplies the envelopes by dcy
+			const auto n = static_cast<double>(clock - sleptAt[i]);
+			env0Y1[i] *= static_cast<Float>(std::pow(static_cast<double>(env0Dcy[i]), n));
+			env1Y1[i] *= static_cast<Float>(std::pow(static_cast<double>(env1Dcy[i]), n));
+			env0State[i] = env1State[i] = static_cast<Float>(0.);
+		}
+		numAwake = numBands;
+	}
+
+	template<typename Float>
+	void OnsetBankT<Float>::updateSleep() noexcept
+	{
+		auto n = numAwake;
+		while (n > 0 && isAsleep(n - 1))
+			--n;
+		const auto numLanes = getNumLanes(n);
+		for (auto i = numLanes; i < getNumLanes(numAwake); ++i)
+		{
+			sleptAt[i] = clock;
+			// what's left in the filter would only ring below the floor
+			resoZ1[i] = resoZ2[i] = static_cast<Float>(0.);
+			lpY1[i] = static_cast<Float>(0.);
+		}
+		numAwake = n;
+	}
+
+	template struct OnsetBankT<double>;
+	template struct OnsetBankT<float>;
+}
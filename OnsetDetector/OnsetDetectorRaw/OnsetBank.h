@@ -0,0 +1,111 @@
+#pragma once
+#include "OnsetAxiom.h"
+#include "Resonator.h"
+#include "EnvelopeFollower.h"
+#include "OnsetKernels.h"
+#include "OnsetState.h"
+#include <array>
+#include <cstdint>
+
+namespace dsp
+{
+	// the running state of one band, so that it can move to another bank
+	// or another stream can run on the same OnsetCore
+	struct OnsetBandState
+	{
+		// writer
+		void saveState(OnsetStateWriter&) const noexcept;
+
+		// reader
+		void restoreState(OnsetStateReader&) noexcept;
+
+		double resoZ1, resoZ2, lpY1, env0Y1, env1Y1;
+		// if the envelopes are in attack
+		bool env0Attack, env1Attack;
+	};
+
+	// Structure-of-arrays version of OnsetCore[OnsetNumBandsMax].
+	// Every band is one lane, so a single vector instruction advances
+	// the resonators and envelope followers of 2 (SSE2), 4 (AVX2) or 8 (AVX-512) bands,
+	// twice as many in float lanes (see ResonatorBaseT::fitsFloat for which bands can).
+	// Coefficients are copied from the OnsetCores, so they stay the one
+	// place where parameters are computed.
+	// On silent input the high bands fall below OnsetSleepFloor first, so
+	// the bank only runs the registers up to the highest awake band. The
+	// sleeping lanes catch up analytically once the input isn't silent.
+	template<typename Float>
+	struct OnsetBankT
+	{
+		using Lanes = std::array<Float, OnsetNumBandsMax>;
+
+		OnsetBankT();
+
+		// band, reso, fastEnv, slowEnv, gain
+		void setBand(int, const Resonator3&, const EnvelopeFollower::Params&,
+			const EnvelopeFollower::Params&, float) noexcept;
+
+		// band
+		void clearBand(int) noexcept;
+
+		// band, state
+		void getState(int, OnsetBandState&) const noexcept;
+
+		// the envelopes continue in decay
+		// band, state
+		void setState(int, const OnsetBandState&) noexcept;
+
+		// numBands
+		void setNumBands(int) noexcept;
+
+		int getNumBands() const noexcept;
+
+		void setKernels(const OnsetKernels&) noexcept;
+
+		// how the ratios are divided (default: Exact)
+		void setMath(OnsetMath) noexcept;
+
+		void reset() noexcept;
+
+		// input (rectified), output (adds the sum of band ratios), numSamples,
+		// silent (input peak below OnsetSleepFloor), ratios (nullptr or a
+		// row per band that gets its ratios)
+		void operator()(const float*, float*, int, bool, float* const* = nullptr) noexcept;
+
+		// skips numSamples of silent input while all bands are asleep
+		// numSamples
+		void sleep(int64_t) noexcept;
+
+		// if no band is awake
+		bool isAsleep() const noexcept;
+	private:
+		// resonator
+		alignas(64) Lanes resoA0, resoB1, resoB2, resoZ1, resoZ2;
+		// resonator's highpass
+		alignas(64) Lanes lpA0, lpB1, lpY1;
+		// fast (0) and slow (1) envelope followers
+		alignas(64) Lanes env0Y1, env0Atk, env0Dcy, env0State;
+		alignas(64) Lanes env1Y1, env1Atk, env1Dcy, env1State;
+		alignas(64) Lanes gain;
+		// samples processed when a sleeping lane stopped running
+		std::array<int64_t, OnsetNumBandsMax> sleptAt;
+		const OnsetKernels* kernels;
+		int64_t clock;
+		int numBands, numAwake;
+		OnsetMath math;
+
+		// band
+		bool isAsleep(int) const noexcept;
+
+		// the lanes the kernels run for numAwake bands
+		// numAwake
+		int getNumLanes(int) const noexcept;
+
+		void wake() noexcept;
+
+		// lets the highest bands fall asleep after a silent block
+		void updateSleep() noexcept;
+	};
+
+	using OnsetBank = OnsetBankT<double>;
+	using OnsetBankF = OnsetBankT<float>;
+}
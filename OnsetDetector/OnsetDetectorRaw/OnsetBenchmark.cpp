@@ -0,0 +1,348 @@
+#include "OnsetBenchmark.h"
+#include "OnsetCorpus.h"
+#include <algorithm>
+#include <chrono>
+
+namespace dsp
+{
+	namespace
+	{
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr double Pi = 3.14159265358979323846;
+
+		// samples, numSamples, sampleRate
+		void synthesizeDrums(float* samples, int64_t numSamples, double sampleRate) noexcept
+		{
+			OnsetNoise noise;
+			// 8th notes at 120bpm, 8 per bar
+			const auto stepLength = static_cast<int64_t>(sampleRate * .25);
+			const auto voiceLength = static_cast<int64_t>(sampleRate * .25);
+			for (auto start = int64_t(0), step = int64_t(0); start < numSamples; start += stepLength, ++step)
+			{
+				const auto beat = step % 8;
+				const auto kick = beat == 0 || beat == 4 || beat == 5;
+				const auto snare = beat == 2 || beat == 6;
+				const auto end = std::min(start + voiceLength, numSamples);
+				auto phase = 0.;
+				auto lastNoise = 0.f;
+				for (auto s = start; s < end; ++s)
+				{
+					const auto t = static_cast<double>(s - start) / sampleRate;
+					const auto n = noise();
+					// closed hihat: differentiated noise
+					auto y = .3 * static_cast<double>(n - lastNoise) * std::exp(-t / .02);
+					lastNoise = n;
+					if (kick)
+					{
+						// pitch falls from 150 to 50hz
+						phase += 2. * Pi * (50. + 100. * std::exp(-t / .03)) / sampleRate;
+						y += .8 * std::sin(phase) * std::exp(-t / .15);
+					}
+					if (snare)
+						y += (.4 * static_cast<double>(n) + .3 * std::sin(2. * Pi * 185. * t)) * std::exp(-t / .08);
+					samples[s] = static_cast<float>(y);
+				}
+			}
+		}
+
+		// resets before and times every run, returns the fastest in seconds
+		template<typename Reset, typename Run>
+		double getFastest(int numRepeats, Reset reset, Run run)
+		{
+			auto fastest = 0.;
+			for (auto r = 0; r < numRepeats; ++r)
+			{
+				reset();
+				const auto start = Clock::now();
+				run();
+				const auto secs = std::chrono::duration<double>(Clock::now() - start).count();
+				if (r == 0 || fastest > secs)
+					fastest = secs;
+			}
+			return fastest;
+		}
+	}
+
+	const char* toString(OnsetBenchStage stage) noexcept
+	{
+		switch (stage)
+		{
+		case OnsetBenchStage::CopyFromMid: return "copyFromMid";
+		case OnsetBenchStage::Resonate: return "resonate";
+		case OnsetBenchStage::Envelopes: return "envelopes";
+		case OnsetBenchStage::Combine: return "combine";
+		default: return "detector";
+		}
+	}
+
+	const char* toString(OnsetBenchInput input) noexcept
+	{
+		switch (input)
+		{
+		case OnsetBenchInput::Silence: return "silence";
+		case OnsetBenchInput::Noise: return "noise";
+		default: return "drums";
+		}
+	}
+
+	OnsetBenchmark::OnsetBenchmark() :
+		left(), right(), rectified(),
+		kernels(&selectOnsetKernels()),
+		seconds(1.), sampleRate(1.),
+		numRepeats(3),
+		engine(OnsetEngine::Cores),
+		precision(OnsetPrecision::Mixed),
+		math(OnsetMath::Exact),
+		maxISA(OnsetISA::AVX512)
+	{
+	}
+
+	void OnsetBenchmark::setSeconds(double x) noexcept
+	{
+		seconds = x;
+	}
+
+	void OnsetBenchmark::setRepeats(int n) noexcept
+	{
+		numRepeats = n < 1 ? 1 : n;
+	}
+
+	void OnsetBenchmark::setEngine(OnsetEngine e) noexcept
+	{
+		engine = e;
+	}
+
+	void OnsetBenchmark::setPrecision(OnsetPrecision p) noexcept
+	{
+		precision = p;
+	}
+
+	void OnsetBenchmark::setMath(OnsetMath m) noexcept
+	{
+		math = m;
+	}
+
+	void OnsetBenchmark::setMaxISA(OnsetISA isa) noexcept
+	{
+		maxISA = isa;
+		kernels = &selectOnsetKernels(maxISA);
+	}
+
+	void OnsetBenchmark::prepare(OnsetBenchInput input, double _sampleRate)
+	{
+		sampleRate = _sampleRate;
+		const auto numSamples = getNumSamples();
+		left.assign(static_cast<size_t>(numSamples), 0.f);
+		switch (input)
+		{
+		case OnsetBenchInput::Silence:
+			break;
+		case OnsetBenchInput::Noise:
+		{
+			OnsetNoise noise;
+			for (auto& x : left)
+				x = .5f * noise();
+			break;
+		}
+		case OnsetBenchInput::Drums:
+			synthesizeDrums(left.data(), numSamples, sampleRate);
+			break;
+		}
+		right = left;
+
+		// what the bands get from the detector
+		rectified.resize(left.size());
+		const float* samples[] = { left.data(), right.data() };
+		for (auto s = int64_t(0); s < numSamples; s += BlockSize)
+		{
+			const auto n = static_cast<int>(std::min(static_cast<int64_t>(BlockSize), numSamples - s));
+			const float* block[] = { samples[0] + s, samples[1] + s };
+			kernels->copyFromMid(rectified.data() + s, block, 2, n);
+			kernels->rectify(rectified.data() + s, n);
+		}
+	}
+
+	bool OnsetBenchmark::supports(OnsetBenchStage stage, int blockSize) noexcept
+	{
+		if (stage == OnsetBenchStage::Resonate || stage == OnsetBenchStage::Envelopes)
+			return blockSize <= BlockSize;
+		return true;
+	}
+
+	double OnsetBenchmark::operator()(OnsetBenchStage stage, int numBands, int blockSize)
+	{
+		auto secs = 0.;
+		switch (stage)
+		{
+		case OnsetBenchStage::CopyFromMid: secs = benchCopyFromMid(blockSize); break;
+		case OnsetBenchStage::Resonate: secs = benchResonate(numBands); break;
+		case OnsetBenchStage::Envelopes: secs = benchEnvelopes(numBands); break;
+		case OnsetBenchStage::Combine: secs = benchCombine(numBands, blockSize); break;
+		case OnsetBenchStage::Detector:
+			switch (blockSize)
+			{
+			case 32: secs = benchDetector<32>(numBands); break;
+			case 64: secs = benchDetector<64>(numBands); break;
+			case 128: secs = benchDetector<128>(numBands); break;
+			default: secs = benchDetector<256>(numBands); break;
+			}
+			break;
+		}
+		return secs * 1e9 / static_cast<double>(getNumSamples());
+	}
+
+	OnsetISA OnsetBenchmark::getISA() const noexcept
+	{
+		return kernels->isa;
+	}
+
+	int64_t OnsetBenchmark::getNumSamples() const noexcept
+	{
+		const auto numSamples = static_cast<int64_t>(seconds * sampleRate);
+		return numSamples < 1 ? 1 : numSamples;
+	}
+
+	double OnsetBenchmark::benchCopyFromMid(int blockSize)
+	{
+		const auto numSamples = getNumSamples();
+		std::vector<float> dst(blockSize);
+		return getFastest(numRepeats, []() {}, [&]()
+		{
+			for (auto s = int64_t(0); s < numSamples; s += blockSize)
+			{
+				const auto n = static_cast<int>(std::min(static_cast<int64_t>(blockSize), numSamples - s));
+				const float* block[] = { left.data() + s, right.data() + s };
+				kernels->copyFromMid(dst.data(), block, 2, n);
+			}
+		});
+	}
+
+	double OnsetBenchmark::benchResonate(int numBands)
+	{
+		const auto numSamples = getNumSamples();
+		OnsetBands bands;
+		bands.setNumBands(numBands);
+		bands.prepare(sampleRate);
+		std::vector<OnsetCore::Response> responses(numBands);
+		for (auto i = 0; i < numBands; ++i)
+		{
+			bands[i].setKernels(*kernels);
+			bands[i].getResonator().getResponse(responses[i]);
+		}
+		return getFastest(numRepeats, [&]() { bands.reset(); }, [&]()
+		{
+			for (auto s = int64_t(0); s < numSamples; s += BlockSize)
+			{
+				const auto n = static_cast<int>(std::min(static_cast<int64_t>(BlockSize), numSamples - s));
+				for (auto i = 0; i < numBands; ++i)
+				{
+					auto& band = bands[i];
+					std::copy(rectified.data() + s, rectified.data() + s + n, band.getBuffer().getSamples());
+					band.resonate(responses[i], n);
+				}
+			}
+		});
+	}
+
+	double OnsetBenchmark::benchEnvelopes(int numBands)
+	{
+		const auto numSamples = getNumSamples();
+		OnsetBands bands;
+		bands.setNumBands(numBands);
+		bands.prepare(sampleRate);
+		bands.reset();
+		std::vector<OnsetCore::Response> responses(numBands);
+		for (auto i = 0; i < numBands; ++i)
+		{
+			bands[i].setKernels(*kernels);
+			bands[i].getResonator().getResponse(responses[i]);
+		}
+
+		// the resonators' output, band after band
+		std::vector<float> resonated(static_cast<size_t>(numSamples * numBands));
+		for (auto s = int64_t(0); s < numSamples; s += BlockSize)
+		{
+			const auto n = static_cast<int>(std::min(static_cast<int64_t>(BlockSize), numSamples - s));
+			for (auto i = 0; i < numBands; ++i)
+			{
+				auto& band = bands[i];
+				const auto samples = band.getBuffer().getSamples();
+				std::copy(rectified.data() + s, rectified.data() + s + n, samples);
+				band.resonate(responses[i], n);
+				std::copy(samples, samples + n, resonated.data() + i * numSamples + s);
+			}
+		}
+
+		return getFastest(numRepeats, [&]() { bands.reset(); }, [&]()
+		{
+			for (auto s = int64_t(0); s < numSamples; s += BlockSize)
+			{
+				const auto n = static_cast<int>(std::min(static_cast<int64_t>(BlockSize), numSamples - s));
+				for (auto i = 0; i < numBands; ++i)
+				{
+					auto& band = bands[i];
+					const auto src = resonated.data() + i * numSamples + s;
+					std::copy(src, src + n, band.getBuffer().getSamples());
+					band.synthesizeEnvelopeFollowers(n);
+				}
+			}
+		});
+	}
+
+	double OnsetBenchmark::benchCombine(int numBands, int blockSize)
+	{
+		const auto numSamples = getNumSamples();
+		OnsetBands bands;
+		bands.setNumBands(numBands);
+		bands.prepare(sampleRate);
+		bands.reset();
+
+		// the sum of the band ratios
+		std::vector<float> sum(static_cast<size_t>(numSamples), 0.f);
+		for (auto s = int64_t(0); s < numSamples; s += BlockSize)
+		{
+			const auto n = static_cast<int>(std::min(static_cast<int64_t>(BlockSize), numSamples - s));
+			for (auto i = 0; i < numBands; ++i)
+				bands[i](rectified.data() + s, sum.data() + s, n);
+		}
+
+		std::vector<float> odf(blockSize);
+		return getFastest(numRepeats, []() {}, [&]()
+		{
+			for (auto s = int64_t(0); s < numSamples; s += blockSize)
+			{
+				const auto n = static_cast<int>(std::min(static_cast<int64_t>(blockSize), numSamples - s));
+				std::copy(sum.data() + s, sum.data() + s + n, odf.data());
+				if (math == OnsetMath::Fast)
+					kernels->combineSquared(odf.data(), static_cast<float>(numBands), n);
+				else
+					kernels->combine(odf.data(), static_cast<float>(numBands), n);
+			}
+		});
+	}
+
+	template<int BlockSize>
+	double OnsetBenchmark::benchDetector(int numBands)
+	{
+		const auto numSamples = getNumSamples();
+		OnsetDetectorT<BlockSize> detector;
+		detector.setNumBands(numBands);
+		detector.setEngine(engine);
+		detector.setPrecision(precision);
+		detector.setMath(math);
+		detector.setMaxISA(maxISA);
+		std::vector<OnsetEvent> eventData(BlockSize);
+		OnsetEvents events(eventData.data(), BlockSize);
+		return getFastest(numRepeats, [&]() { detector.prepare(sampleRate); }, [&]()
+		{
+			for (auto s = int64_t(0); s < numSamples; s += BlockSize)
+			{
+				const auto n = static_cast<int>(std::min(static_cast<int64_t>(BlockSize), numSamples - s));
+				float* block[] = { left.data() + s, right.data() + s };
+				events.clear();
+				detector(block, 2, n, events);
+			}
+		});
+	}
+}
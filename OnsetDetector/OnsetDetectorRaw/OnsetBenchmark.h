@@ -0,0 +1,91 @@
+#pragma once
+#include "OnsetDetector.h"
+#include <vector>
+
+namespace dsp
+{
+	// the parts of the pipeline that can be timed on their own
+	enum class OnsetBenchStage { CopyFromMid, Resonate, Envelopes, Combine, Detector };
+
+	// silence, white noise at -6db or a 120bpm kick, snare and hihat loop
+	enum class OnsetBenchInput { Silence, Noise, Drums };
+
+	const char* toString(OnsetBenchStage) noexcept;
+
+	const char* toString(OnsetBenchInput) noexcept;
+
+	// Times the stages of the pipeline on a synthesized stereo input.
+	// Every measurement runs over the whole input several times and keeps
+	// the fastest run, so that other processes disturb it less.
+	// The per band stages (Resonate, Envelopes) process the bands one after
+	// another like the unfused reference path, and each call first loads
+	// the band's buffer from a prepared signal. Combine loads its buffer
+	// the same way.
+	struct OnsetBenchmark
+	{
+		OnsetBenchmark();
+
+		// length of the input
+		// seconds
+		void setSeconds(double) noexcept;
+
+		// runs per measurement
+		// numRepeats
+		void setRepeats(int) noexcept;
+
+		// engine of the Detector stage
+		void setEngine(OnsetEngine) noexcept;
+
+		// precision of the Detector stage's Bank engine
+		void setPrecision(OnsetPrecision) noexcept;
+
+		// math of the Combine and Detector stages
+		void setMath(OnsetMath) noexcept;
+
+		void setMaxISA(OnsetISA) noexcept;
+
+		// synthesizes the input all following measurements use
+		// input, sampleRate
+		void prepare(OnsetBenchInput, double);
+
+		// if stage can process blocks of blockSize. the per band stages
+		// are limited to the size of a band's buffer.
+		// stage, blockSize
+		static bool supports(OnsetBenchStage, int) noexcept;
+
+		// returns nanoseconds per input sample (the fastest run)
+		// stage, numBands, blockSize (32, 64, 128 or 256)
+		double operator()(OnsetBenchStage, int, int);
+
+		// the instruction set of the kernels the stages use
+		OnsetISA getISA() const noexcept;
+	private:
+		std::vector<float> left, right, rectified;
+		const OnsetKernels* kernels;
+		double seconds, sampleRate;
+		int numRepeats;
+		OnsetEngine engine;
+		OnsetPrecision precision;
+		OnsetMath math;
+		OnsetISA maxISA;
+
+		// of the input
+		int64_t getNumSamples() const noexcept;
+
+		// blockSize
+		double benchCopyFromMid(int);
+
+		// numBands
+		double benchResonate(int);
+
+		// numBands
+		double benchEnvelopes(int);
+
+		// numBands, blockSize
+		double benchCombine(int, int);
+
+		// numBands
+		template<int BlockSize>
+		double benchDetector(int);
+	};
+}
@@ -1,16 +1,18 @@
 #pragma once
 #include <array>
+#include <cmath>
 #include "OnsetAxiom.h"
 
 namespace dsp
 {
-	struct OnsetBuffer
+	template<int Size>
+	struct OnsetBufferT
 	{
-		OnsetBuffer() :
+		OnsetBufferT() :
 			buffer()
 		{ }
 
-		void copyFrom(const OnsetBuffer& other, int numSamples) noexcept
+		void copyFrom(const OnsetBufferT& other, int numSamples) noexcept
 		{
 			for (auto s = 0; s < numSamples; ++s)
 				buffer[s] = other[s];
@@ -72,6 +74,8 @@ namespace dsp
 					samples[ch][i] = buffer[i];
 		}
 	protected:
-		std::array<float, BlockSize> buffer;
+		std::array<float, Size> buffer;
 	};
+
+	using OnsetBuffer = OnsetBufferT<BlockSize>;
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "OnsetCorpus.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dsp
+{
+	namespace
+	{
+		static constexpr double Pi = 3.14159265358979323846;
+	}
+
+	OnsetNoise::OnsetNoise(uint32_t seed) noexcept :
+		state(seed)
+	{
+	}
+
+	float OnsetNoise::operator()() noexcept
+	{
+		state = state * 1664525u + 1013904223u;
+		return static_cast<float>(state >> 8) * (1.f / 8388608.f) - 1.f;
+	}
+
+	const char* toString(OnsetCorpusKind kind) noexcept
+	{
+		switch (kind)
+		{
+		case OnsetCorpusKind::Clicks: return "clicks";
+		case OnsetCorpusKind::Tones: return "tones";
+		case OnsetCorpusKind::NoiseBursts: return "noise bursts";
+		default: return "drums";
+		}
+	}
+
+	OnsetCorpus::OnsetCorpus() :
+		bandFreqsHz(),
+		seconds(20.), sampleRate(1.)
+	{
+	}
+
+	void OnsetCorpus::setSeconds(double x) noexcept
+	{
+		seconds = x;
+	}
+
+	void OnsetCorpus::prepare(double _sampleRate, const OnsetBands& bands)
+	{
+		sampleRate = _sampleRate;
+		bandFreqsHz.resize(bands.getNumBands());
+		for (auto i = 0; i < bands.getNumBands(); ++i)
+			bandFreqsHz[i] = bands[i].getFreqHz();
+	}
+
+	void OnsetCorpus::operator()(OnsetCorpusKind kind, float snrDb, OnsetCorpusCase& c) const
+	{
+		const auto numSamples = static_cast<int64_t>(seconds * sampleRate);
+		c.kind = kind;
+		c.snrDb = snrDb;
+		c.samples.assign(static_cast<size_t>(numSamples), 0.f);
+		c.onsets.clear();
+
+		// every kind and snr gets its own onsets
+		OnsetNoise noise(1 + static_cast<uint32_t>(kind) * 7919u
+			+ static_cast<uint32_t>(std::isinf(snrDb) ? 0.f : snrDb + 100.f));
+		const auto minGap = .2 * sampleRate;
+		const auto gapRange = .3 * sampleRate;
+		auto start = static_cast<int64_t>(.25 * sampleRate);
+		// the last one may not be cut off
+		const auto end = numSamples - static_cast<int64_t>(.5 * sampleRate);
+		while (start < end)
+		{
+			// -12 to -6db
+			const auto peak = .25f + .125f * (noise() + 1.f);
+			addEvent(kind, start, peak, noise, c.samples.data(), numSamples);
+			c.onsets.push_back(start);
+			start += static_cast<int64_t>(minGap + gapRange * .5 * static_cast<double>(noise() + 1.f));
+		}
+
+		if (std::isinf(snrDb))
+			return;
+		// uniform noise in [-1, 1) has an rms of 1 / sqrt(3). the nominal
+		// peak of the events is -9db.
+		const auto nominalPeak = .375f;
+		const auto rms = nominalPeak * std::pow(10.f, -snrDb / 20.f);
+		const auto gain = rms * std::sqrt(3.f);
+		for (auto& x : c.samples)
+			x += gain * noise();
+	}
+
+	void OnsetCorpus::addEvent(OnsetCorpusKind kind, int64_t start, float peak,
+		OnsetNoise& noise, float* samples, int64_t numSamples) const noexcept
+	{
+		const auto length = std::min(static_cast<int64_t>(.3 * sampleRate), numSamples - start);
+		auto y = samples + start;
+		switch (kind)
+		{
+		case OnsetCorpusKind::Clicks:
+			y[0] += peak;
+			break;
+		case OnsetCorpusKind::Tones:
+		{
+			const auto band = static_cast<size_t>(.5f * (noise() + 1.f) * static_cast<float>(bandFreqsHz.size()));
+			const auto freqHz = bandFreqsHz[std::min(band, bandFreqsHz.size() - 1)];
+			// starts at phase 0, so there is no click
+			const auto inc = 2. * Pi * freqHz / sampleRate;
+			for (auto s = int64_t(0); s < length; ++s)
+			{
+				const auto t = static_cast<double>(s) / sampleRate;
+				y[s] += peak * static_cast<float>(std::sin(inc * static_cast<double>(s)) * std::exp(-t / .1));
+			}
+			break;
+		}
+		case OnsetCorpusKind::NoiseBursts:
+			for (auto s = int64_t(0); s < length; ++s)
+			{
+				const auto t = static_cast<double>(s) / sampleRate;
+				y[s] += peak * noise() * static_cast<float>(std::exp(-t / .05));
+			}
+			break;
+		case OnsetCorpusKind::Drums:
+		{
+			// kicks and snares in random order
+			const auto kick = noise() < 0.f;
+			auto phase = 0.;
+			for (auto s = int64_t(0); s < length; ++s)
+			{
+				const auto t = static_cast<double>(s) / sampleRate;
+				auto v = 0.;
+				if (kick)
+				{
+					// pitch falls from 150 to 50hz
+					phase += 2. * Pi * (50. + 100. * std::exp(-t / .03)) / sampleRate;
+					v = std::sin(phase) * std::exp(-t / .15);
+				}
+				else
+					v = (.6 * static_cast<double>(noise()) + .4 * std::sin(2. * Pi * 185. * t)) * std::exp(-t / .08);
+				y[s] += peak * static_cast<float>(v);
+			}
+			break;
+		}
+		}
+	}
+}
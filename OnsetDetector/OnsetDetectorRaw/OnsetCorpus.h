@@ -0,0 +1,63 @@
+#pragma once
+#include "OnsetDetector.h"
+#include <vector>
+
+namespace dsp
+{
+	// white noise that is the same on every platform, unlike the
+	// distributions of <random>
+	struct OnsetNoise
+	{
+		// seed
+		OnsetNoise(uint32_t = 1) noexcept;
+
+		// [-1, 1)
+		float operator()() noexcept;
+	private:
+		uint32_t state;
+	};
+
+	// Clicks: single sample impulses
+	// Tones: decaying sines at the centre of a random band
+	// NoiseBursts: decaying white noise
+	// Drums: kicks (falling pitch) and snares (noise and a tone)
+	enum class OnsetCorpusKind { Clicks, Tones, NoiseBursts, Drums };
+
+	const char* toString(OnsetCorpusKind) noexcept;
+
+	// a mono signal and where its onsets are
+	struct OnsetCorpusCase
+	{
+		std::vector<float> samples;
+		std::vector<int64_t> onsets;
+		OnsetCorpusKind kind;
+		// peak of the events over the rms of the background noise,
+		// infinity if there is none
+		float snrDb;
+	};
+
+	// Synthesizes signals with known onset times. The onsets are 200 to 500ms
+	// apart, longer than any hold, and their peaks vary between -12 and -6db.
+	// Every case is the same for the same settings.
+	struct OnsetCorpus
+	{
+		OnsetCorpus();
+
+		// length of every case
+		// seconds
+		void setSeconds(double) noexcept;
+
+		// the tones sit at the centres of the active bands
+		// sampleRate, bands
+		void prepare(double, const OnsetBands&);
+
+		// kind, snrDb, corpusCase
+		void operator()(OnsetCorpusKind, float, OnsetCorpusCase&) const;
+	private:
+		std::vector<double> bandFreqsHz;
+		double seconds, sampleRate;
+
+		// kind, start, peak, noise, samples, numSamples
+		void addEvent(OnsetCorpusKind, int64_t, float, OnsetNoise&, float*, int64_t) const noexcept;
+	};
+}
@@ -1,19 +1,25 @@
 #include "OnsetDetector.h"
+#include <algorithm>
 #include <cmath>
 
 namespace dsp
 {
 	// ONSET CORE:
 
-	OnsetCore::OnsetCore() :
+	template<class ResoClass>
+	OnsetCoreT<ResoClass>::OnsetCoreT() :
 		reso(),
 		envFols(),
 		buffer(),
+		kernels(&selectOnsetKernels()),
 		sampleRate(1.),
 		freqHz(5000.), bwHz(5000.), bwPercent(1.),
 		attack(OnsetAtkDefault),
 		decay(OnsetDcyDefault),
-		gain(1.f)
+		sleepSamples(0),
+		decimation(1),
+		gain(1.f),
+		floatable(false)
 	{
 	}
 
@@ -41,12 +47,12 @@ namespace dsp
 
 	float freqHzToNote(float freqHz) noexcept
 	{
-		return 440.f * std::pow(2.f, (freqHz - 69.f) / 12.f);
+		return 69.f + 12.f * std::log2(freqHz / 440.f);
 	}
 
 	float noteToFreqHz(float note) noexcept
 	{
-		return 69.f + 12.f * std::log2(note / 440.f);
+		return 440.f * std::pow(2.f, (note - 69.f) / 12.f);
 	}
 
 	float dbToAmp(float db) noexcept
@@ -54,7 +60,8 @@ namespace dsp
 		return std::pow(10.f, db / 20.f);
 	}
 
-	void OnsetCore::setAttack(double a) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::setAttack(double a) noexcept
 	{
 		attack = a;
 		const auto sampleRateInv = 1. / sampleRate;
@@ -63,7 +70,8 @@ namespace dsp
 		envFols[1].setAttack(ms * attack);
 	}
 
-	void OnsetCore::setDecay(double d, int i) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::setDecay(double d, int i) noexcept
 	{
 		decay = d;
 		const auto sampleRateInv = 1. / sampleRate;
@@ -72,70 +80,134 @@ namespace dsp
 		envFols[i].setDecay(ms * decay);
 	}
 
-	void OnsetCore::setBandwidth(double q) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::setBandwidth(double q) noexcept
 	{
 		bwHz = q;
 		updateBandwidth();
 	}
 
-	void OnsetCore::setBandwidthPercent(double p) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::setBandwidthPercent(double p) noexcept
 	{
 		bwPercent = p;
 		updateBandwidth();
 	}
 
-	void OnsetCore::setGain(float g) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::setGain(float g) noexcept
 	{
 		gain = g;
 	}
 
-	void OnsetCore::setFreqHz(double f) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::setFreqHz(double f) noexcept
 	{
 		freqHz = f;
 		reso.setCutoffFc(freqHzToFc(freqHz, sampleRate));
 	}
 
-	void OnsetCore::updateFilter() noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::updateFilter() noexcept
 	{
 		reso.update();
+		if (decimation > 1)
+			reso.matchHighpass(decimation);
+		floatable = reso.fitsFloat();
+	}
+
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::setCoefficients(const OnsetBandCoefficients& c) noexcept
+	{
+		using Float = typename ResoClass::SampleType;
+		reso.a0 = static_cast<Float>(c.resoA0);
+		reso.b1 = static_cast<Float>(c.resoB1);
+		reso.b2 = static_cast<Float>(c.resoB2);
+		reso.setLowpassX(c.lpX);
+		envFols[0].setCoefficients(c.env0Atk, c.env0Dcy);
+		envFols[1].setCoefficients(c.env1Atk, c.env1Dcy);
+		gain = c.gain;
+		floatable = c.fitsFloat;
 	}
 
 	// process:
 
-	void OnsetCore::prepare(double _sampleRate) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::setKernels(const OnsetKernels& k) noexcept
+	{
+		kernels = &k;
+		for (auto& e : envFols)
+			e.setKernels(k);
+	}
+
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::prepare(double _sampleRate, int _decimation) noexcept
 	{
 		sampleRate = _sampleRate;
+		decimation = _decimation;
 		for (auto& e : envFols)
 			e.prepare(sampleRate);
 		setFreqHz(freqHz);
 		setBandwidth(bwHz);
 		updateFilter();
 		reso.reset();
+		sleepSamples = 0;
 		setAttack(attack);
 		setDecay(decay, 0);
 		setDecay(decay, 1);
 	}
 
-	void OnsetCore::copyFrom(OnsetBuffer& other, int numSamples) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::reset() noexcept
+	{
+		reso.reset();
+		// -120db, like EnvelopeFollower::prepare
+		for (auto& e : envFols)
+			e.reset(1e-6);
+		sleepSamples = 0;
+	}
+
+	template<class ResoClass>
+	bool OnsetCoreT<ResoClass>::isAsleep() const noexcept
+	{
+		return std::abs(reso.z1) < OnsetSleepFloor
+			&& std::abs(reso.z2) < OnsetSleepFloor
+			&& std::abs(reso.getLowpass().y1) < OnsetSleepFloor
+			&& envFols[0].getEnvelope() < OnsetSleepFloor
+			&& envFols[1].getEnvelope() < OnsetSleepFloor;
+	}
+
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::sleep(int64_t numSamples) noexcept
+	{
+		// what's left in the filter would only ring below the floor
+		if (sleepSamples == 0)
+			reso.reset();
+		sleepSamples += numSamples;
+	}
+
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::copyFrom(OnsetBuffer& other, int numSamples) noexcept
 	{
 		buffer.copyFrom(other, numSamples);
 	}
 
-	void OnsetCore::resonate(int numSamples) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::resonate(const Response& response, int numSamples) noexcept
 	{
-		auto samples = buffer.getSamples();
-		for (auto s = 0; s < numSamples; ++s)
-			samples[s] = static_cast<float>(reso(samples[s]));
+		reso(*kernels, response, buffer.getSamples(), numSamples);
 	}
 
-	void OnsetCore::synthesizeEnvelopeFollowers(int numSamples) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::synthesizeEnvelopeFollowers(int numSamples) noexcept
 	{
 		const auto samples = buffer.getSamples();
 		for (auto& e : envFols)
 			e(samples, numSamples);
 	}
 
-	void OnsetCore::operator()(int numSamples) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::operator()(int numSamples) noexcept
 	{
 		const auto& e1 = envFols[0];
 		const auto& e2 = envFols[1];
@@ -149,7 +221,41 @@ namespace dsp
 		}
 	}
 
-	void OnsetCore::addTo(OnsetBuffer& _buffer, int s) noexcept
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::operator()(const float* input, float* odf, int numSamples) noexcept
+	{
+		process<false>(input, odf, nullptr, numSamples);
+	}
+
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::operator()(const float* input, float* odf, float* ratios, int numSamples) noexcept
+	{
+		process<true>(input, odf, ratios, numSamples);
+	}
+
+	template<class ResoClass>
+	template<bool Ratios>
+	void OnsetCoreT<ResoClass>::process(const float* input, float* odf, float* ratios, int numSamples) noexcept
+	{
+		if (sleepSamples != 0)
+			wake();
+		auto& e1 = envFols[0];
+		auto& e2 = envFols[1];
+		for (auto s = 0; s < numSamples; ++s)
+		{
+			const auto y = static_cast<float>(reso(input[s]));
+			const auto v0 = static_cast<float>(e1.processSample(y));
+			const auto v1 = static_cast<float>(e2.processSample(y));
+			const auto v2 = v1 + 1e-6f;
+			const auto ratio = gain * v0 / v2;
+			odf[s] += ratio;
+			if (Ratios)
+				ratios[s] = ratio;
+		}
+	}
+
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::addTo(OnsetBuffer& _buffer, int s) noexcept
 	{
 		const auto& e1 = envFols[0];
 		const auto& e2 = envFols[1];
@@ -160,7 +266,8 @@ namespace dsp
 		_buffer[s] += y;
 	}
 
-	float OnsetCore::processSample(OnsetBuffer& _buffer, int s) noexcept
+	template<class ResoClass>
+	float OnsetCoreT<ResoClass>::processSample(OnsetBuffer& _buffer, int s) noexcept
 	{
 		const auto& e1 = envFols[0];
 		const auto& e2 = envFols[1];
@@ -172,34 +279,108 @@ namespace dsp
 		return y;
 	}
 
-	float OnsetCore::processSample(int s) noexcept
+	template<class ResoClass>
+	float OnsetCoreT<ResoClass>::processSample(int s) noexcept
 	{
 		return processSample(buffer, s);
 	}
 
 	// getters:
 
-	OnsetBuffer& OnsetCore::getBuffer() noexcept
+	template<class ResoClass>
+	OnsetBuffer& OnsetCoreT<ResoClass>::getBuffer() noexcept
 	{
 		return buffer;
 	}
 
-	float OnsetCore::getMaxMag(int numSamples) const noexcept
+	template<class ResoClass>
+	float OnsetCoreT<ResoClass>::getMaxMag(int numSamples) const noexcept
 	{
 		return buffer.getMaxMag(numSamples);
 	}
 
-	const float& OnsetCore::operator[](int i) const noexcept
+	template<class ResoClass>
+	const float& OnsetCoreT<ResoClass>::operator[](int i) const noexcept
 	{
 		return buffer[i];
 	}
 
-	void OnsetCore::updateBandwidth() noexcept
+	template<class ResoClass>
+	const ResoClass& OnsetCoreT<ResoClass>::getResonator() const noexcept
+	{
+		return reso;
+	}
+
+	template<class ResoClass>
+	const EnvelopeFollower& OnsetCoreT<ResoClass>::getEnvelopeFollower(int i) const noexcept
+	{
+		return envFols[i];
+	}
+
+	template<class ResoClass>
+	float OnsetCoreT<ResoClass>::getGain() const noexcept
+	{
+		return gain;
+	}
+
+	template<class ResoClass>
+	double OnsetCoreT<ResoClass>::getFreqHz() const noexcept
+	{
+		return freqHz;
+	}
+
+	template<class ResoClass>
+	bool OnsetCoreT<ResoClass>::fitsFloat() const noexcept
+	{
+		return floatable;
+	}
+
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::getState(OnsetBandState& state) const noexcept
+	{
+		state.resoZ1 = static_cast<double>(reso.z1);
+		state.resoZ2 = static_cast<double>(reso.z2);
+		state.lpY1 = static_cast<double>(reso.getLowpass().y1);
+		state.env0Y1 = envFols[0].getEnvelope();
+		state.env1Y1 = envFols[1].getEnvelope();
+		state.env0Attack = envFols[0].isAttacking();
+		state.env1Attack = envFols[1].isAttacking();
+		if (sleepSamples == 0)
+			return;
+		// like wake(). sleep() already cleared the filter.
+		const auto n = static_cast<double>(sleepSamples);
+		state.env0Y1 *= std::pow(envFols[0].getParams().dcy, n);
+		state.env1Y1 *= std::pow(envFols[1].getParams().dcy, n);
+		state.env0Attack = state.env1Attack = false;
+	}
+
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::setState(const OnsetBandState& state) noexcept
+	{
+		reso.setState(state.resoZ1, state.resoZ2, state.lpY1);
+		envFols[0].setState(state.env0Y1, state.env0Attack);
+		envFols[1].setState(state.env1Y1, state.env1Attack);
+		sleepSamples = 0;
+	}
+
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::wake() noexcept
+	{
+		for (auto& e : envFols)
+			e.skipSilence(sleepSamples);
+		sleepSamples = 0;
+	}
+
+	template<class ResoClass>
+	void OnsetCoreT<ResoClass>::updateBandwidth() noexcept
 	{
 		const auto b = bwHz * bwPercent;
 		reso.setBandwidth(freqHzToFc(b, sampleRate));
 	}
 
+	template struct OnsetCoreT<Resonator3>;
+	template struct OnsetCoreT<Resonator3F>;
+
 	// STRONG HOLD:
 
 	OnsetStrongHold::OnsetStrongHold() :
@@ -243,151 +424,312 @@ namespace dsp
 		timer = 0;
 	}
 
-	// ONSET DETECTOR:
+	void OnsetStrongHold::saveState(OnsetStateWriter& w) const noexcept
+	{
+		w(lengthD);
+		w(timer);
+	}
 
-	OnsetDetector::OnsetDetector() :
-		onOnset(nullptr),
-		buffer(),
-		detectors(),
+	void OnsetStrongHold::restoreState(OnsetStateReader& r) noexcept
+	{
+		auto l = lengthD;
+		r(l);
+		setLength(l);
+		r(timer);
+	}
+
+	// ONSET TRIGGER:
+
+	OnsetTrigger::OnsetTrigger() :
 		strongHold(),
-		sampleRate(1.),
-		lowestPitch(freqHzToNote(OnsetLowestFreqHz)),
-		highestPitch(freqHzToNote(OnsetHighestFreqHz)),
-		threshold(OnsetThresholdDefault), tilt(OnsetTiltDefault),
-		numBands(static_cast<int>(OnsetNumBandsDefault)), onset(-1), onsetOut(-1)
+		threshold(dbToAmp(OnsetThresholdDefault)),
+		lastVal(0.f),
+		squared(false)
 	{
-		const auto bwPercentDefault = std::pow(2., static_cast<double>(OnsetBandwidthDefault));
-		setBandwidth(bwPercentDefault);
-		setDecay(OnsetDcyDefault);
-		setTilt(OnsetTiltDefault);
 	}
 
-	// parameters:
+	void OnsetTrigger::prepare(double sampleRate) noexcept
+	{
+		strongHold.prepare(sampleRate);
+		strongHold.reset();
+		lastVal = 0.f;
+	}
 
-	void OnsetDetector::setAttack(double x) noexcept
+	void OnsetTrigger::setThreshold(float db) noexcept
 	{
-		for (auto& d : detectors)
-			d.setAttack(x);
+		threshold = dbToAmp(db);
 	}
 
-	void OnsetDetector::setDecay(double x) noexcept
+	void OnsetTrigger::setHoldLength(double ms) noexcept
 	{
-		for (auto& d : detectors)
-			d.setDecay(x, 1);
-		auto d = OnsetDecay0Percent * x;
-		for (auto& dtr : detectors)
-			dtr.setDecay(d, 0);
+		strongHold.setLength(ms);
 	}
 
-	void OnsetDetector::setTilt(float db) noexcept
+	void OnsetTrigger::setMath(OnsetMath m) noexcept
 	{
-		tilt = db;
-		updateTilt();
+		const auto s = m == OnsetMath::Fast;
+		if (squared != s)
+			lastVal = s ? lastVal * lastVal : std::sqrt(lastVal);
+		squared = s;
 	}
 
-	void OnsetDetector::setThreshold(float db) noexcept
+	bool OnsetTrigger::operator()(float val, int64_t position, OnsetEvents* events) noexcept
 	{
-		threshold = dbToAmp(db);
+		// counted per sample, so the hold doesn't depend on the block size
+		strongHold(1);
+		auto triggered = false;
+		if (val > (squared ? threshold * threshold : threshold))
+		{
+			triggered = strongHold.youShallPass();
+			if (triggered && events != nullptr)
+			{
+				// the roots are only taken for an onset
+				const auto v = squared ? std::sqrt(val) : val;
+				const auto last = squared ? std::sqrt(lastVal) : lastVal;
+				// linear interpolation of the threshold crossing
+				const auto rise = v - last;
+				const auto offset = last < threshold && rise > 0.f ?
+					(threshold - last) / rise - 1.f : 0.f;
+				events->add({ position, v, offset, 0, 0 });
+			}
+			strongHold.reset();
+		}
+		lastVal = val;
+		return triggered;
 	}
 
-	void OnsetDetector::setHoldLength(double ms) noexcept
+	void OnsetTrigger::skip(int numSamples) noexcept
 	{
-		strongHold.setLength(ms);
+		strongHold(numSamples);
+		lastVal = 0.f;
+	}
+
+	void OnsetTrigger::saveState(OnsetStateWriter& w) const noexcept
+	{
+		strongHold.saveState(w);
+		w(threshold);
+		w(lastVal);
+	}
+
+	void OnsetTrigger::restoreState(OnsetStateReader& r) noexcept
+	{
+		strongHold.restoreState(r);
+		r(threshold);
+		r(lastVal);
+	}
+
+	// ONSET BANDS:
+
+	OnsetBands::OnsetBands() :
+		cores(),
+		design(),
+		levels()
+	{
+		// the design's defaults. attack and decay are exponents, like in
+		// the plugin's parameters
+		setBandwidth(design.bandwidth);
+		setAttack(design.attack);
+		setDecay(design.decay);
+		setTilt(design.tilt);
+	}
+
+	void OnsetBands::setAttack(double x) noexcept
+	{
+		design.attack = x;
+		for (auto& c : cores)
+			c.setAttack(x);
 	}
 
-	void OnsetDetector::setBandwidth(double b) noexcept
+	void OnsetBands::setDecay(double x) noexcept
 	{
-		for (auto& d : detectors)
-			d.setBandwidthPercent(b);
+		design.decay = x;
+		for (auto& c : cores)
+			c.setDecay(x, 1);
+		auto d = OnsetDecay0Percent * x;
+		for (auto& c : cores)
+			c.setDecay(d, 0);
+	}
+
+	void OnsetBands::setTilt(float db) noexcept
+	{
+		design.tilt = db;
+		updateTilt();
 	}
 
-	void OnsetDetector::setNumBands(int n) noexcept
+	void OnsetBands::setBandwidth(double b) noexcept
 	{
-		numBands = n;
+		design.bandwidth = b;
+		for (auto& c : cores)
+			c.setBandwidthPercent(b);
+	}
+
+	void OnsetBands::setNumBands(int n) noexcept
+	{
+		design.numBands = n;
 		updatePitchRange();
 		updateTilt();
 	}
 
-	void OnsetDetector::setLowestPitch(double p) noexcept
+	void OnsetBands::setLowestPitch(double p) noexcept
 	{
-		lowestPitch = p;
+		design.lowestPitch = p;
 		updatePitchRange();
 	}
 
-	void OnsetDetector::setHighestPitch(double p) noexcept
+	void OnsetBands::setHighestPitch(double p) noexcept
 	{
-		highestPitch = p;
+		design.highestPitch = p;
 		updatePitchRange();
 	}
 
-	// process:
+	void OnsetBands::setMultirate(bool m) noexcept
+	{
+		if (design.multirate == m)
+			return;
+		design.multirate = m;
+		prepare(design.sampleRate);
+	}
 
-	void OnsetDetector::prepare(double _sampleRate) noexcept
+	void OnsetBands::prepare(double _sampleRate) noexcept
 	{
-		sampleRate = _sampleRate;
+		design.sampleRate = _sampleRate;
 		updatePitchRange();
-		for (auto& d : detectors)
-			d.prepare(sampleRate);
-		strongHold.prepare(sampleRate);
+		for (auto i = 0; i < OnsetNumBandsMax; ++i)
+			cores[i].prepare(getLevelSampleRate(levels[i]), 1 << levels[i]);
 	}
 
-	void OnsetDetector::operator()(float** samples, int numChannels, int numSamples) noexcept
+	void OnsetBands::setDesign(const OnsetBandsDesign& d) noexcept
 	{
-		onset = -1;
-		strongHold(numSamples);
-		buffer.copyFromMid(samples, numChannels, numSamples);
-		buffer.rectify(numSamples);
-		for (auto i = 0; i < numBands; ++i)
+		design = d;
+		setBandwidth(design.bandwidth);
+		setAttack(design.attack);
+		setDecay(design.decay);
+		// updates the pitch range and the envelopes that depend on it
+		prepare(design.sampleRate);
+		updateTilt();
+	}
+
+	void OnsetBands::reset() noexcept
+	{
+		for (auto& c : cores)
+			c.reset();
+	}
+
+	void OnsetBands::getSnapshot(OnsetSnapshot& snapshot) const noexcept
+	{
+		for (auto i = 0; i < OnsetNumBandsMax; ++i)
 		{
-			auto& detector = detectors[i];
-			detector.copyFrom(buffer, numSamples);
-			detector.resonate(numSamples);
-			detector.synthesizeEnvelopeFollowers(numSamples);
+			const auto& core = cores[i];
+			const auto& reso = core.getResonator();
+			const auto& env0 = core.getEnvelopeFollower(0).getParams();
+			const auto& env1 = core.getEnvelopeFollower(1).getParams();
+			auto& band = snapshot.bands[i];
+			band.resoA0 = reso.a0;
+			band.resoB1 = reso.b1;
+			band.resoB2 = reso.b2;
+			band.lpX = reso.getLowpass().b1;
+			band.env0Atk = env0.atk;
+			band.env0Dcy = env0.dcy;
+			band.env1Atk = env1.atk;
+			band.env1Dcy = env1.dcy;
+			band.gain = core.getGain();
+			band.level = levels[i];
+			band.fitsFloat = core.fitsFloat();
 		}
-		for (auto s = 0; s < numSamples; ++s)
+		snapshot.design = design;
+	}
+
+	void OnsetBands::setSnapshot(const OnsetSnapshot& snapshot) noexcept
+	{
+		for (auto i = 0; i < OnsetNumBandsMax; ++i)
 		{
-			auto val = 0.f;
-			for (auto i = 0; i < numBands; ++i)
-			{
-				auto& detector = detectors[i];
-				detector.processSample(s);
-				val += detector[s];
-			}
-			val = std::sqrt(val / static_cast<float>(numBands));
-			if (val > threshold)
+			const auto& band = snapshot.bands[i];
+			auto& core = cores[i];
+			if (levels[i] != band.level)
 			{
-				if (strongHold.youShallPass())
-					onset = s;
-				strongHold.reset();
+				levels[i] = band.level;
+				core.reset();
 			}
+			core.setCoefficients(band);
 		}
+		design = snapshot.design;
+	}
+
+	const OnsetBandsDesign& OnsetBands::getDesign() const noexcept
+	{
+		return design;
+	}
+
+	int OnsetBands::getNumBands() const noexcept
+	{
+		return design.numBands;
+	}
+
+	int OnsetBands::getLevel(int i) const noexcept
+	{
+		return levels[i];
 	}
 
-	void OnsetDetector::updatePitchRange() noexcept
+	int OnsetBands::getNumLevels() const noexcept
 	{
-		const auto rangePitch = highestPitch - lowestPitch;
+		auto maxLevel = 0;
+		for (auto i = 0; i < design.numBands; ++i)
+			if (maxLevel < levels[i])
+				maxLevel = levels[i];
+		return maxLevel + 1;
+	}
+
+	OnsetCore& OnsetBands::operator[](int i) noexcept
+	{
+		return cores[i];
+	}
+
+	const OnsetCore& OnsetBands::operator[](int i) const noexcept
+	{
+		return cores[i];
+	}
+
+	void OnsetBands::updatePitchRange() noexcept
+	{
+		const auto numBands = design.numBands;
+		const auto rangePitch = design.highestPitch - design.lowestPitch;
 		for (auto i = 0; i < numBands; ++i)
 		{
 			const auto iF = static_cast<float>(i);
-			const auto iR = iF / static_cast<float>(numBands - 1);
-			const auto pitch = lowestPitch + iR * rangePitch;
+			// a single band sits in the middle of the range
+			const auto iR = numBands > 1 ? iF / static_cast<float>(numBands - 1) : .5f;
+			const auto pitch = design.lowestPitch + iR * rangePitch;
 			const auto freqHz = static_cast<double>(noteToFreqHz(pitch));
 			const auto pitchLow = pitch - .5f;
 			const auto pitchHigh = pitch + .5f;
 			const auto freqLow = static_cast<double>(noteToFreqHz(pitchLow));
 			const auto freqHigh = static_cast<double>(noteToFreqHz(pitchHigh));
 			const auto bwHz = freqHigh - freqLow;
-			auto& detector = detectors[i];
-			detector.setFreqHz(freqHz);
-			detector.setBandwidth(bwHz);
-			detector.updateFilter();
+			auto& core = cores[i];
+			core.setFreqHz(freqHz);
+			core.setBandwidth(bwHz);
+			const auto level = design.multirate ? getMultirateLevel(freqHz, design.sampleRate) : 0;
+			if (levels[i] == level)
+			{
+				core.updateFilter();
+				continue;
+			}
+			// the band moves to another octave level
+			levels[i] = level;
+			core.prepare(getLevelSampleRate(level), 1 << level);
 		}
 	}
 
-	void OnsetDetector::updateTilt() noexcept
+	double OnsetBands::getLevelSampleRate(int level) const noexcept
+	{
+		return design.sampleRate / static_cast<double>(1 << level);
+	}
+
+	void OnsetBands::updateTilt() noexcept
 	{
-		const auto lowestGain = dbToAmp(-tilt);
-		const auto highestGain = dbToAmp(tilt);
+		const auto numBands = design.numBands;
+		const auto lowestGain = dbToAmp(-design.tilt);
+		const auto highestGain = dbToAmp(design.tilt);
 		const auto rangeGain = highestGain - lowestGain;
 		const auto numBandsInv = 1.f / static_cast<float>(numBands);
 		const auto bandCompensate = numBandsInv * numBandsInv;
@@ -396,7 +738,952 @@ namespace dsp
 			const auto iF = static_cast<float>(i);
 			const auto iR = iF / static_cast<float>(numBands);
 			const auto gain = lowestGain + iR * rangeGain;
-			detectors[i].setGain(gain * bandCompensate);
+			cores[i].setGain(gain * bandCompensate);
 		}
 	}
+
+	// BANDS CACHE:
+
+	OnsetBandsCache::OnsetBandsCache() :
+		mutex(),
+		entries(),
+		designer()
+	{
+	}
+
+	OnsetBandsCache& OnsetBandsCache::getInstance()
+	{
+		static OnsetBandsCache cache;
+		return cache;
+	}
+
+	std::shared_ptr<const OnsetSnapshot> OnsetBandsCache::operator()(const OnsetBandsDesign& design)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& e : entries)
+			if (e.design == design)
+				if (auto snapshot = e.snapshot.lock())
+					return snapshot;
+		entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry& e)
+		{
+			return e.snapshot.expired();
+		}), entries.end());
+		designer.setDesign(design);
+		auto snapshot = std::make_shared<OnsetSnapshot>();
+		designer.getSnapshot(*snapshot);
+		entries.push_back({ design, snapshot });
+		return snapshot;
+	}
+
+	int OnsetBandsCache::getNumDesigns()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto n = 0;
+		for (const auto& e : entries)
+			if (!e.snapshot.expired())
+				++n;
+		return n;
+	}
+
+	// BANDS HANDOFF:
+
+	OnsetBandsHandoff::OnsetBandsHandoff() :
+		design(),
+		snapshots(),
+		prepared(false)
+	{
+	}
+
+	void OnsetBandsHandoff::setAttack(double x)
+	{
+		design.attack = x;
+		publish();
+	}
+
+	void OnsetBandsHandoff::setDecay(double x)
+	{
+		design.decay = x;
+		publish();
+	}
+
+	void OnsetBandsHandoff::setTilt(float db)
+	{
+		design.tilt = db;
+		publish();
+	}
+
+	void OnsetBandsHandoff::setBandwidth(double b)
+	{
+		design.bandwidth = b;
+		publish();
+	}
+
+	void OnsetBandsHandoff::setNumBands(int n)
+	{
+		design.numBands = n;
+		publish();
+	}
+
+	void OnsetBandsHandoff::setLowestPitch(double p)
+	{
+		design.lowestPitch = p;
+		publish();
+	}
+
+	void OnsetBandsHandoff::setHighestPitch(double p)
+	{
+		design.highestPitch = p;
+		publish();
+	}
+
+	void OnsetBandsHandoff::setMultirate(bool m)
+	{
+		design.multirate = m;
+		publish();
+	}
+
+	void OnsetBandsHandoff::setDesign(const OnsetBandsDesign& d)
+	{
+		design = d;
+		publish();
+	}
+
+	const OnsetBandsDesign& OnsetBandsHandoff::getDesign() const noexcept
+	{
+		return design;
+	}
+
+	void OnsetBandsHandoff::prepare(double sampleRate)
+	{
+		design.sampleRate = sampleRate;
+		prepared = true;
+		publish();
+	}
+
+	bool OnsetBandsHandoff::pull(OnsetBands& bands) noexcept
+	{
+		if (!snapshots.update())
+			return false;
+		bands.setSnapshot(*snapshots.getFront());
+		return true;
+	}
+
+	void OnsetBandsHandoff::publish()
+	{
+		if (!prepared)
+			return;
+		snapshots.getBack() = OnsetBandsCache::getInstance()(design);
+		snapshots.publish();
+	}
+
+	// ONSET DETECTOR:
+
+	template<int BlockSize>
+	OnsetDetectorT<BlockSize>::OnsetDetectorT() :
+		buffer(),
+		odf(),
+		bands(),
+		handoff(),
+		bank(),
+		bankF(),
+		trigger(),
+		picker(),
+		groupTriggers(),
+		groupOdfs(),
+		groupMasks(),
+		bandRows(),
+		multirate(),
+		levelRatios(),
+		heldRatios(),
+		position(0), sleepSamples(0),
+		events(nullptr),
+		bandThreshold(dbToAmp(OnsetThresholdDefault) * dbToAmp(OnsetThresholdDefault)),
+		lastBandMask(0),
+		numGroups(0),
+		kernels(&selectOnsetKernels()),
+		maxISA(OnsetISA::AVX512),
+		engine(Engine::Cores),
+		precision(OnsetPrecision::Mixed),
+		math(OnsetMath::Exact),
+		thresholdMode(OnsetThresholdMode::Fixed),
+		floatBands(0),
+		bankNeedsUpdate(true),
+		bankLive(false),
+		asleep(false),
+		bandMasks(false)
+	{
+		for (auto& t : groupTriggers)
+			t.setMath(OnsetMath::Fast);
+	}
+
+	// parameters:
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setAttack(double x)
+	{
+		handoff.setAttack(x);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setDecay(double x)
+	{
+		handoff.setDecay(x);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setTilt(float db)
+	{
+		handoff.setTilt(db);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setThreshold(float db) noexcept
+	{
+		trigger.setThreshold(db);
+		picker.setThreshold(db);
+		for (auto& t : groupTriggers)
+			t.setThreshold(db);
+		bandThreshold = dbToAmp(db) * dbToAmp(db);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setHoldLength(double ms) noexcept
+	{
+		trigger.setHoldLength(ms);
+		picker.setHoldLength(ms);
+		for (auto& t : groupTriggers)
+			t.setHoldLength(ms);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setThresholdMode(OnsetThresholdMode mode)
+	{
+		if (thresholdMode == mode)
+			return;
+		if (mode == OnsetThresholdMode::Adaptive)
+			picker.allocate();
+		thresholdMode = mode;
+		picker.reset();
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setPeakWindow(double ms) noexcept
+	{
+		picker.setWindow(ms);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setPeakSpread(float k) noexcept
+	{
+		picker.setSpread(k);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setPeakLookBack(double ms) noexcept
+	{
+		picker.setLookBack(ms);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setBandMasks(bool b) noexcept
+	{
+		bandMasks = b;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setBandGroups(const uint32_t* masks, int n) noexcept
+	{
+		numGroups = std::min(std::max(n, 0), OnsetNumGroupsMax);
+		for (auto g = 0; g < numGroups; ++g)
+			groupMasks[g] = masks[g];
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setBandwidth(double b)
+	{
+		handoff.setBandwidth(b);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setNumBands(int n)
+	{
+		handoff.setNumBands(n);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setLowestPitch(double p)
+	{
+		handoff.setLowestPitch(p);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setHighestPitch(double p)
+	{
+		handoff.setHighestPitch(p);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setEngine(Engine e)
+	{
+		if (engine == e)
+			return;
+		if (e == Engine::Multirate)
+			multirate.allocate();
+		wake();
+		engine = e;
+		bankNeedsUpdate = true;
+		resetBank();
+		handoff.setMultirate(engine == Engine::Multirate);
+		multirate.reset();
+		heldRatios.fill(0.f);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setPrecision(OnsetPrecision p) noexcept
+	{
+		precision = p;
+		bankNeedsUpdate = true;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setMath(OnsetMath m) noexcept
+	{
+		math = m;
+		bank.setMath(math);
+		bankF.setMath(math);
+		trigger.setMath(math);
+		picker.setMath(math);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setMaxISA(OnsetISA isa) noexcept
+	{
+		maxISA = isa;
+	}
+
+	// process:
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::prepare(double sampleRate)
+	{
+		kernels = &selectOnsetKernels(maxISA);
+		bank.setKernels(*kernels);
+		bankF.setKernels(*kernels);
+		handoff.prepare(sampleRate);
+		handoff.pull(bands);
+		bands.reset();
+		trigger.prepare(sampleRate);
+		picker.prepare(sampleRate);
+		for (auto& t : groupTriggers)
+			t.prepare(sampleRate);
+		lastBandMask = 0;
+		position = 0;
+		sleepSamples = 0;
+		asleep = false;
+		resetBank();
+		bankNeedsUpdate = true;
+		multirate.reset();
+		heldRatios.fill(0.f);
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::operator()(float** samples, int numChannels, int numSamples) noexcept
+	{
+		operator()(samples, numChannels, numSamples, OnsetOdfView());
+	}
+
+	template<int BlockSize>
+	int OnsetDetectorT<BlockSize>::operator()(float** samples, int numChannels, int numSamples,
+		OnsetEvents& _events) noexcept
+	{
+		return operator()(samples, numChannels, numSamples, _events, OnsetOdfView());
+	}
+
+	template<int BlockSize>
+	int OnsetDetectorT<BlockSize>::operator()(float** samples, int numChannels, int numSamples,
+		OnsetEvents& _events, const OnsetOdfView& view) noexcept
+	{
+		const auto numEventsBefore = _events.size();
+		events = &_events;
+		operator()(samples, numChannels, numSamples, view);
+		events = nullptr;
+		return _events.size() - numEventsBefore;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::operator()(float** samples, int numChannels, int numSamples,
+		const OnsetOdfView& view) noexcept
+	{
+		for (auto s = 0; s < numSamples; s += BlockSize)
+		{
+			const auto remainingSamples = numSamples - s;
+			const auto numSamplesBlock = remainingSamples < BlockSize ? remainingSamples : BlockSize;
+			float* block[] = { &samples[0][s], &samples[numChannels > 1 ? 1 : 0][s] };
+			processBlock(block, numChannels, numSamplesBlock, view.from(s));
+		}
+	}
+
+	template<int BlockSize>
+	int64_t OnsetDetectorT<BlockSize>::getPosition() const noexcept
+	{
+		return position;
+	}
+
+	template<int BlockSize>
+	int OnsetDetectorT<BlockSize>::getLatency() const noexcept
+	{
+		return engine == Engine::Multirate ? multirate.getLatency() : 0;
+	}
+
+	template<int BlockSize>
+	OnsetISA OnsetDetectorT<BlockSize>::getISA() const noexcept
+	{
+		return kernels->isa;
+	}
+
+	// checkpoints:
+
+	template<int BlockSize>
+	size_t OnsetDetectorT<BlockSize>::getStateSize() const noexcept
+	{
+		OnsetStateWriter w(nullptr, 0);
+		save(w);
+		return w.getSize();
+	}
+
+	template<int BlockSize>
+	size_t OnsetDetectorT<BlockSize>::saveState(uint8_t* data, size_t capacity) const noexcept
+	{
+		OnsetStateWriter w(data, capacity);
+		save(w);
+		return w.isValid() ? w.getSize() : 0;
+	}
+
+	template<int BlockSize>
+	bool OnsetDetectorT<BlockSize>::restoreState(const uint8_t* data, size_t size)
+	{
+		OnsetBandsDesign design;
+		auto e = engine;
+		auto p = precision;
+		auto m = math;
+		auto isa = maxISA;
+		// reads the whole state once without keeping it, so that a broken
+		// one changes nothing
+		{
+			OnsetStateReader r(data, size);
+			if (!readParameters(r, design, e, p, m, isa))
+				return false;
+			OnsetTrigger t;
+			t.restoreState(r);
+			auto mode = OnsetThresholdMode::Fixed;
+			r(mode);
+			if (mode != OnsetThresholdMode::Fixed && mode != OnsetThresholdMode::Adaptive)
+				return false;
+			if (mode == OnsetThresholdMode::Adaptive)
+			{
+				OnsetPeakPicker pk;
+				pk.prepare(design.sampleRate);
+				if (!pk.restoreState(r))
+					return false;
+			}
+			auto masks = false;
+			auto threshold = 0.f;
+			auto groups = 0;
+			r(masks);
+			r(threshold);
+			r(groups);
+			if (groups < 0 || groups > OnsetNumGroupsMax)
+				return false;
+			for (auto g = 0; g < groups; ++g)
+			{
+				auto mask = uint32_t(0);
+				r(mask);
+				t.restoreState(r);
+			}
+			auto mask = uint32_t(0);
+			r(mask);
+			int64_t pos = 0, sleep = 0;
+			auto slept = false;
+			r(pos);
+			r(sleep);
+			r(slept);
+			// the states belong to the bands of the design
+			auto numStates = 0;
+			r(numStates);
+			if (numStates != design.numBands)
+				return false;
+			OnsetBandState state = {};
+			for (auto i = 0; i < numStates; ++i)
+				state.restoreState(r);
+			if (e == Engine::Multirate)
+			{
+				OnsetMultirateT<BlockSize> m;
+				if (!m.restoreState(r))
+					return false;
+			}
+			if (!r.isValid() || r.getPosition() != size)
+				return false;
+		}
+
+		OnsetStateReader r(data, size);
+		readParameters(r, design, e, p, m, isa);
+		setMaxISA(isa);
+		setPrecision(p);
+		setMath(m);
+		setEngine(e);
+		handoff.setDesign(design);
+		prepare(design.sampleRate);
+		trigger.restoreState(r);
+		auto mode = OnsetThresholdMode::Fixed;
+		r(mode);
+		setThresholdMode(mode);
+		if (thresholdMode == OnsetThresholdMode::Adaptive)
+			picker.restoreState(r);
+		r(bandMasks);
+		r(bandThreshold);
+		r(numGroups);
+		for (auto g = 0; g < numGroups; ++g)
+		{
+			r(groupMasks[g]);
+			groupTriggers[g].restoreState(r);
+		}
+		r(lastBandMask);
+		r(position);
+		r(sleepSamples);
+		r(asleep);
+		auto numStates = 0;
+		r(numStates);
+		std::array<OnsetBandState, OnsetNumBandsMax> states = {};
+		for (auto i = 0; i < numStates; ++i)
+			states[i].restoreState(r);
+		if (engine == Engine::Bank)
+		{
+			updateBank();
+			setBankStates(states, numStates);
+		}
+		else
+			for (auto i = 0; i < numStates; ++i)
+				bands[i].setState(states[i]);
+		if (engine == Engine::Multirate)
+			multirate.restoreState(r);
+		// the design of a save right after setEngine is the one the old
+		// engine ran. the bands move to their levels at the next block,
+		// like they would have.
+		if (design.multirate != (engine == Engine::Multirate))
+			handoff.setMultirate(engine == Engine::Multirate);
+		return true;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::save(OnsetStateWriter& w) const noexcept
+	{
+		w(OnsetStateMagic);
+		w(OnsetStateVersion);
+		// the design of the running bands, the setters' one may be newer
+		bands.getDesign().saveState(w);
+		w(engine);
+		w(precision);
+		w(math);
+		w(maxISA);
+		trigger.saveState(w);
+		w(thresholdMode);
+		if (thresholdMode == OnsetThresholdMode::Adaptive)
+			picker.saveState(w);
+		w(bandMasks);
+		w(bandThreshold);
+		w(numGroups);
+		for (auto g = 0; g < numGroups; ++g)
+		{
+			w(groupMasks[g]);
+			groupTriggers[g].saveState(w);
+		}
+		w(lastBandMask);
+		w(position);
+		w(sleepSamples);
+		w(asleep);
+		std::array<OnsetBandState, OnsetNumBandsMax> states = {};
+		const auto numStates = getBandStates(states);
+		w(numStates);
+		for (auto i = 0; i < numStates; ++i)
+			states[i].saveState(w);
+		if (engine == Engine::Multirate)
+			multirate.saveState(w);
+	}
+
+	template<int BlockSize>
+	bool OnsetDetectorT<BlockSize>::readParameters(OnsetStateReader& r, OnsetBandsDesign& design,
+		Engine& e, OnsetPrecision& p, OnsetMath& m, OnsetISA& isa) noexcept
+	{
+		auto magic = uint32_t(0), version = uint32_t(0);
+		r(magic);
+		r(version);
+		if (magic != OnsetStateMagic || version != OnsetStateVersion)
+			return false;
+		design.restoreState(r);
+		r(e);
+		r(p);
+		r(m);
+		r(isa);
+		return r.isValid()
+			&& design.sampleRate > 0.
+			&& design.numBands >= 1 && design.numBands <= OnsetNumBandsMax
+			&& (e == Engine::Cores || e == Engine::Bank || e == Engine::Multirate)
+			&& (p == OnsetPrecision::Double || p == OnsetPrecision::Mixed)
+			&& (m == OnsetMath::Exact || m == OnsetMath::Fast)
+			&& isa <= OnsetISA::AVX512;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::processBlock(float** samples, int numChannels, int numSamples,
+		const OnsetOdfView& view) noexcept
+	{
+		if (handoff.pull(bands))
+			bankNeedsUpdate = true;
+		kernels->copyFromMid(buffer.getSamples(), samples, numChannels, numSamples);
+		kernels->rectify(buffer.getSamples(), numSamples);
+		const auto silent = kernels->getMaxMag(buffer.getSamples(), numSamples) < OnsetSleepFloor;
+		const auto numBands = bands.getNumBands();
+		if (asleep)
+		{
+			if (silent)
+			{
+				sleepSamples += numSamples;
+				if (thresholdMode == OnsetThresholdMode::Adaptive)
+					picker.skip(numSamples);
+				else
+					trigger.skip(numSamples);
+				for (auto g = 0; g < numGroups; ++g)
+					groupTriggers[g].skip(numSamples);
+				lastBandMask = 0;
+				position += numSamples;
+				// the odf of a sleeping detector is 0
+				if (view.combined != nullptr)
+					std::fill(view.combined, view.combined + numSamples, 0.f);
+				for (auto i = 0; i < numBands && view.bands != nullptr; ++i)
+					std::fill(view.getBand(i), view.getBand(i) + numSamples, 0.f);
+				return;
+			}
+			wake();
+		}
+		// the groups and the band masks need every band's ratio
+		const auto needsRows = bandMasks || numGroups != 0;
+		const auto rows = needsRows && view.bands == nullptr ?
+			OnsetOdfView(view.combined, bandRows.data(), BlockSize) : view;
+		if (engine == Engine::Bank)
+			processBank(numSamples, silent, rows);
+		else if (engine == Engine::Multirate)
+			processMultirate(numSamples, silent, rows);
+		else
+			processCores(numSamples, silent, rows);
+		if (math == OnsetMath::Fast)
+			kernels->combineSquared(odf.getSamples(), static_cast<float>(numBands), numSamples);
+		else
+			kernels->combine(odf.getSamples(), static_cast<float>(numBands), numSamples);
+		if (view.combined != nullptr)
+		{
+			std::copy(odf.getSamples(), odf.getSamples() + numSamples, view.combined);
+			// the fast odf is still squared
+			if (math == OnsetMath::Fast)
+				kernels->combine(view.combined, 1.f, numSamples);
+		}
+		// the input sample of the block's first odf sample
+		const auto start = position - getLatency();
+		if (needsRows)
+			triggerBands(rows, numSamples);
+		else if (thresholdMode == OnsetThresholdMode::Adaptive)
+			for (auto s = 0; s < numSamples; ++s)
+				picker(odf[s], start + s, events);
+		else
+			for (auto s = 0; s < numSamples; ++s)
+				trigger(odf[s], start + s, events);
+		position += numSamples;
+		asleep = silent && isAsleep();
+	}
+
+	template<int BlockSize>
+	uint32_t OnsetDetectorT<BlockSize>::getBandMask(const OnsetOdfView& rows, int s) const noexcept
+	{
+		const auto numBands = bands.getNumBands();
+		auto mask = uint32_t(0);
+		for (auto i = 0; i < numBands; ++i)
+			if (rows.getBand(i)[s] > bandThreshold)
+				mask |= 1u << i;
+		return mask;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::triggerBands(const OnsetOdfView& rows, int numSamples) noexcept
+	{
+		// every group's mean ratio
+		const auto numBands = bands.getNumBands();
+		for (auto g = 0; g < numGroups; ++g)
+		{
+			auto& groupOdf = groupOdfs[g];
+			groupOdf.clear(numSamples);
+			auto numGroupBands = 0;
+			for (auto i = 0; i < numBands; ++i)
+			{
+				if ((groupMasks[g] & (1u << i)) == 0)
+					continue;
+				const auto row = rows.getBand(i);
+				for (auto s = 0; s < numSamples; ++s)
+					groupOdf[s] += row[s];
+				++numGroupBands;
+			}
+			if (numGroupBands > 1)
+				kernels->combineSquared(groupOdf.getSamples(), static_cast<float>(numGroupBands), numSamples);
+		}
+
+		const auto start = position - getLatency();
+		const auto adaptive = thresholdMode == OnsetThresholdMode::Adaptive;
+		for (auto s = 0; s < numSamples; ++s)
+		{
+			auto numEvents = events != nullptr ? events->size() : 0;
+			if (adaptive)
+				picker(odf[s], start + s, events);
+			else
+				trigger(odf[s], start + s, events);
+			if (bandMasks && events != nullptr && events->size() > numEvents)
+				// a peak is the sample before
+				(*events)[numEvents].bands = !adaptive ? getBandMask(rows, s) :
+					s != 0 ? getBandMask(rows, s - 1) : lastBandMask;
+			for (auto g = 0; g < numGroups; ++g)
+			{
+				numEvents = events != nullptr ? events->size() : 0;
+				groupTriggers[g](groupOdfs[g][s], start + s, events);
+				if (events == nullptr || events->size() == numEvents)
+					continue;
+				auto& e = (*events)[numEvents];
+				e.group = g + 1;
+				if (bandMasks)
+					e.bands = getBandMask(rows, s);
+			}
+		}
+		lastBandMask = bandMasks ? getBandMask(rows, numSamples - 1) : 0;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::processCores(int numSamples, bool silent, const OnsetOdfView& view) noexcept
+	{
+		const auto numBands = bands.getNumBands();
+		odf.clear(numSamples);
+		for (auto i = 0; i < numBands; ++i)
+		{
+			auto& band = bands[i];
+			const auto row = view.getBand(i);
+			if (silent && band.isAsleep())
+			{
+				band.sleep(numSamples);
+				if (row != nullptr)
+					std::fill(row, row + numSamples, 0.f);
+			}
+			else if (row != nullptr)
+				band(buffer.getSamples(), odf.getSamples(), row, numSamples);
+			else
+				band(buffer.getSamples(), odf.getSamples(), numSamples);
+		}
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::processBank(int numSamples, bool silent, const OnsetOdfView& view) noexcept
+	{
+		if (bankNeedsUpdate)
+			updateBank();
+		odf.clear(numSamples);
+		if (view.bands == nullptr)
+		{
+			bank(buffer.getSamples(), odf.getSamples(), numSamples, silent);
+			bankF(buffer.getSamples(), odf.getSamples(), numSamples, silent);
+			return;
+		}
+		// every bank's bands are in the order of the detector's
+		const auto numBands = bands.getNumBands();
+		std::array<float*, OnsetNumBandsMax> rows, rowsF;
+		auto numDouble = 0, numFloat = 0;
+		for (auto i = 0; i < numBands; ++i)
+		{
+			if (floatBands & (1u << i))
+				rowsF[numFloat++] = view.getBand(i);
+			else
+				rows[numDouble++] = view.getBand(i);
+		}
+		bank(buffer.getSamples(), odf.getSamples(), numSamples, silent, rows.data());
+		bankF(buffer.getSamples(), odf.getSamples(), numSamples, silent, rowsF.data());
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::processMultirate(int numSamples, bool silent, const OnsetOdfView& view) noexcept
+	{
+		const auto numBands = bands.getNumBands();
+		const auto numLevels = bands.getNumLevels();
+		multirate.decimate(buffer.getSamples(), numSamples, numLevels, silent);
+		// the half-bands still ring after the input fell silent, and the
+		// delay lines still give what came before it
+		std::array<bool, OnsetMultirateLevelsMax> silentLevels;
+		for (auto k = 0; k < numLevels; ++k)
+			silentLevels[k] = silent && kernels->getMaxMag(multirate.getInput(k),
+				multirate.getNumSamples(k)) < OnsetSleepFloor;
+		odf.clear(numSamples);
+		for (auto i = 0; i < numBands; ++i)
+		{
+			auto& band = bands[i];
+			const auto level = bands.getLevel(i);
+			const auto input = multirate.getInput(level);
+			const auto output = level == 0 ? odf.getSamples() : multirate.getODF(level);
+			const auto n = level == 0 ? numSamples : multirate.getNumSamples(level);
+			const auto row = view.getBand(i);
+			// a decimated band's ratios are held to the full rate like the odf
+			const auto ratios = level == 0 ? row : levelRatios.getSamples();
+			const auto sleeping = silentLevels[level] && band.isAsleep();
+			if (sleeping)
+				band.sleep(n);
+			else if (row != nullptr)
+				band(input, output, ratios, n);
+			else
+				band(input, output, n);
+			if (row == nullptr)
+				continue;
+			if (sleeping)
+				std::fill(ratios, ratios + n, 0.f);
+			if (level != 0)
+				multirate.hold(level, ratios, row, numSamples, heldRatios[i]);
+		}
+		multirate.expand(odf.getSamples(), numSamples);
+	}
+
+	template<int BlockSize>
+	bool OnsetDetectorT<BlockSize>::isAsleep() const noexcept
+	{
+		if (engine == Engine::Bank)
+			return bank.isAsleep() && bankF.isAsleep();
+		if (engine == Engine::Multirate && !multirate.isSettled())
+			return false;
+		const auto numBands = bands.getNumBands();
+		for (auto i = 0; i < numBands; ++i)
+			if (!bands[i].isAsleep())
+				return false;
+		return true;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::wake() noexcept
+	{
+		asleep = false;
+		if (sleepSamples == 0)
+			return;
+		if (engine == Engine::Bank)
+		{
+			bank.sleep(sleepSamples);
+			bankF.sleep(sleepSamples);
+		}
+		else
+		{
+			const auto numBands = bands.getNumBands();
+			for (auto i = 0; i < numBands; ++i)
+				bands[i].sleep(sleepSamples >> bands.getLevel(i));
+			// the half-bands are silent, only the held odfs are left
+			multirate.reset();
+			heldRatios.fill(0.f);
+		}
+		sleepSamples = 0;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::updateBank() noexcept
+	{
+		const auto numBands = bands.getNumBands();
+		auto newFloatBands = uint32_t(0);
+		for (auto i = 0; i < numBands; ++i)
+			if (precision == OnsetPrecision::Mixed && bands[i].fitsFloat())
+				newFloatBands |= 1u << i;
+		// the bands that change banks take their state with them. new
+		// bands start at zero.
+		const auto moved = floatBands != newFloatBands;
+		std::array<OnsetBandState, OnsetNumBandsMax> states = {};
+		if (moved)
+		{
+			getBankStates(states);
+			floatBands = newFloatBands;
+		}
+
+		auto numDouble = 0, numFloat = 0;
+		for (auto i = 0; i < numBands; ++i)
+		{
+			const auto& c = bands[i];
+			const auto& fastEnv = c.getEnvelopeFollower(0).getParams();
+			const auto& slowEnv = c.getEnvelopeFollower(1).getParams();
+			if (floatBands & (1u << i))
+				bankF.setBand(numFloat++, c.getResonator(), fastEnv, slowEnv, c.getGain());
+			else
+				bank.setBand(numDouble++, c.getResonator(), fastEnv, slowEnv, c.getGain());
+		}
+		bank.setNumBands(numDouble);
+		bankF.setNumBands(numFloat);
+		if (moved)
+			setBankStates(states, numBands);
+		bankNeedsUpdate = false;
+		bankLive = true;
+	}
+
+	template<int BlockSize>
+	int OnsetDetectorT<BlockSize>::getBankStates(std::array<OnsetBandState, OnsetNumBandsMax>& states) const noexcept
+	{
+		const auto numBands = bank.getNumBands() + bankF.getNumBands();
+		auto numDouble = 0, numFloat = 0;
+		for (auto i = 0; i < numBands; ++i)
+		{
+			if (floatBands & (1u << i))
+				bankF.getState(numFloat++, states[i]);
+			else
+				bank.getState(numDouble++, states[i]);
+		}
+		return numBands;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::setBankStates(const std::array<OnsetBandState, OnsetNumBandsMax>& states,
+		int numBands) noexcept
+	{
+		auto numDouble = 0, numFloat = 0;
+		for (auto i = 0; i < numBands; ++i)
+		{
+			if (floatBands & (1u << i))
+				bankF.setState(numFloat++, states[i]);
+			else
+				bank.setState(numDouble++, states[i]);
+		}
+	}
+
+	template<int BlockSize>
+	int OnsetDetectorT<BlockSize>::getBandStates(std::array<OnsetBandState, OnsetNumBandsMax>& states) const noexcept
+	{
+		const auto numBands = bands.getNumBands();
+		// stale coefficients don't make the states stale. a sleeping
+		// detector takes new bands before the bank, the bands the bank
+		// doesn't hold yet start from silence.
+		if (engine == Engine::Bank && bankLive)
+		{
+			getBankStates(states);
+			for (auto i = bank.getNumBands() + bankF.getNumBands(); i < numBands; ++i)
+				states[i] = {};
+			return numBands;
+		}
+		// the cores, or the bank hasn't run yet
+		for (auto i = 0; i < numBands; ++i)
+			bands[i].getState(states[i]);
+		return numBands;
+	}
+
+	template<int BlockSize>
+	void OnsetDetectorT<BlockSize>::resetBank() noexcept
+	{
+		bank.reset();
+		bankF.reset();
+		bankLive = false;
+	}
+
+	template struct OnsetDetectorT<32>;
+	template struct OnsetDetectorT<64>;
+	template struct OnsetDetectorT<128>;
+	template struct OnsetDetectorT<256>;
 }
\ No newline at end of file
@@ -2,10 +2,24 @@
 #include "OnsetBuffer.h"
 #include "Resonator.h"
 #include "EnvelopeFollower.h"
-#include <functional>
+#include "OnsetBank.h"
+#include "OnsetEvent.h"
+#include "OnsetMultirate.h"
+#include "OnsetOdf.h"
+#include "OnsetPeakPicker.h"
+#include "OnsetSnapshot.h"
+#include "OnsetState.h"
+#include "OnsetTripleBuffer.h"
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace dsp
 {
+	// midi note of freqHz
+	// freqHz
+	float freqHzToNote(float) noexcept;
+
 	// ✨ The onset detectow cwass detectsy the sampwe index of an onset, if 1 existsy >w< ✨
 	// 
 	//  ／l、     
@@ -13,9 +27,14 @@ namespace dsp
 	//  l、 ~ヽ   
 	//  じしf_, )ノ
 	// (⁄˘⁄ ⁄ ω⁄ ⁄ ˘⁄⁄) detectsy da boom-boom pointy
-	struct OnsetCore
+	// ResoClass is the band's resonator, a Resonator3T. it is a template
+	// parameter, so the per-sample loops see the whole filter.
+	template<class ResoClass>
+	struct OnsetCoreT
 	{
-		OnsetCore();
+		using Response = OnsetResonatorResponseT<typename ResoClass::SampleType>;
+
+		OnsetCoreT();
 
 		// parameters:
 
@@ -33,16 +52,38 @@ namespace dsp
 
 		void updateFilter() noexcept;
 
+		// coefficients computed by another OnsetCore
+		void setCoefficients(const OnsetBandCoefficients&) noexcept;
+
+		// the block path's scans (see resonate and synthesizeEnvelopeFollowers)
+		void setKernels(const OnsetKernels&) noexcept;
+
 		// process:
 
-		// sampleRate
-		void prepare(double) noexcept;
+		// decimation > 1 runs the band at sampleRate, 1/decimation of the
+		// rate it stands in for (see Resonator3T::matchHighpass)
+		// sampleRate, decimation
+		void prepare(double, int = 1) noexcept;
+
+		// clears the filter and envelope states
+		void reset() noexcept;
+
+		// if the filter and envelopes are below OnsetSleepFloor, so that
+		// silent input can't make the band add to the odf
+		bool isAsleep() const noexcept;
+
+		// skips numSamples of silent input. the envelopes catch up
+		// analytically when the band processes again.
+		// numSamples
+		void sleep(int64_t) noexcept;
 
 		// other, numSamples
 		void copyFrom(OnsetBuffer&, int) noexcept;
 
-		// numSamples
-		void resonate(int) noexcept;
+		// the resonator's block mode on the buffer. the response is the
+		// caller's (getResonator().getResponse), the fused pass needs none.
+		// response, numSamples
+		void resonate(const Response&, int) noexcept;
 
 		// numSamples
 		void synthesizeEnvelopeFollowers(int) noexcept;
@@ -50,6 +91,15 @@ namespace dsp
 		// numSamples
 		void operator()(int) noexcept;
 
+		// fused resonate, rectify, envelopes and ratio in one pass.
+		// the ratio is added to odf instead of the band's buffer.
+		// input (rectified), odf, numSamples
+		void operator()(const float*, float*, int) noexcept;
+
+		// same, and writes every ratio to ratios too
+		// input (rectified), odf, ratios, numSamples
+		void operator()(const float*, float*, float*, int) noexcept;
+
 		// buffer, s
 		void addTo(OnsetBuffer&, int) noexcept;
 
@@ -67,16 +117,51 @@ namespace dsp
 		float getMaxMag(int) const noexcept;
 
 		const float& operator[](int) const noexcept;
+
+		const ResoClass& getResonator() const noexcept;
+
+		// i
+		const EnvelopeFollower& getEnvelopeFollower(int) const noexcept;
+
+		float getGain() const noexcept;
+
+		// centre frequency of the resonator
+		double getFreqHz() const noexcept;
+
+		// if the band can run in float (see ResonatorBaseT::fitsFloat)
+		bool fitsFloat() const noexcept;
+
+		// the filter and envelope state, so that several streams can take
+		// turns on one core. a sleeping core's envelopes are caught up.
+		// state
+		void getState(OnsetBandState&) const noexcept;
+
+		// wakes the core
+		// state
+		void setState(const OnsetBandState&) noexcept;
 	private:
-		Resonator3 reso;
+		ResoClass reso;
 		std::array<EnvelopeFollower, 2> envFols;
 		OnsetBuffer buffer;
+		const OnsetKernels* kernels;
 		double sampleRate, freqHz, bwHz, bwPercent, attack, decay;
+		int64_t sleepSamples;
+		int decimation;
 		float gain;
+		bool floatable;
 
 		void updateBandwidth() noexcept;
+
+		// the fused pass, Ratios writes them to ratios
+		// input, odf, ratios, numSamples
+		template<bool Ratios>
+		void process(const float*, float*, float*, int) noexcept;
+
+		void wake() noexcept;
 	};
 
+	using OnsetCore = OnsetCoreT<Resonator3>;
+
 	struct OnsetStrongHold
 	{
 		OnsetStrongHold();
@@ -94,16 +179,61 @@ namespace dsp
 		bool youShallPass() const noexcept;
 
 		void setLength(double) noexcept;
+
+		// writer
+		void saveState(OnsetStateWriter&) const noexcept;
+
+		// keeps the sampleRate
+		// reader
+		void restoreState(OnsetStateReader&) noexcept;
 	private:
 		double sampleRate, lengthD;
 		int timer, length;
 	};
 
-	struct OnsetDetector
+	// threshold and hold of a detection function
+	struct OnsetTrigger
 	{
-		OnsetDetector();
+		OnsetTrigger();
 
-		// parameters:
+		// sampleRate
+		void prepare(double) noexcept;
+
+		// db
+		void setThreshold(float) noexcept;
+
+		// ms
+		void setHoldLength(double) noexcept;
+
+		// Fast: every val is the squared odf (see OnsetMath), the event
+		// still gets the odf (default: Exact)
+		void setMath(OnsetMath) noexcept;
+
+		// appends an event if val starts an onset and returns if it did.
+		// val, position, events (can be nullptr)
+		bool operator()(float, int64_t, OnsetEvents*) noexcept;
+
+		// same as numSamples calls with a val of 0, which never triggers
+		// numSamples
+		void skip(int) noexcept;
+
+		// writer
+		void saveState(OnsetStateWriter&) const noexcept;
+
+		// reader
+		void restoreState(OnsetStateReader&) noexcept;
+	private:
+		OnsetStrongHold strongHold;
+		float threshold, lastVal;
+		bool squared;
+	};
+
+	// The parameters of all bands. The OnsetCores are spread across the
+	// pitch range and tilted, so their coefficients can also be copied
+	// into other engines.
+	struct OnsetBands
+	{
+		OnsetBands();
 
 		void setAttack(double) noexcept;
 
@@ -111,10 +241,6 @@ namespace dsp
 
 		void setTilt(float) noexcept;
 
-		void setThreshold(float) noexcept;
-
-		void setHoldLength(double) noexcept;
-
 		void setBandwidth(double) noexcept;
 
 		void setNumBands(int) noexcept;
@@ -123,26 +249,363 @@ namespace dsp
 
 		void setHighestPitch(double) noexcept;
 
-		// process:
+		// runs low bands at decimated rates (see OnsetMultirateT)
+		void setMultirate(bool) noexcept;
 
 		// sampleRate
 		void prepare(double) noexcept;
 
-		void operator()(float**, int, int) noexcept;
+		// every parameter at once, then prepare() at the design's sampleRate.
+		// the coefficients only depend on the design, not on earlier ones.
+		// design
+		void setDesign(const OnsetBandsDesign&) noexcept;
+
+		void reset() noexcept;
+
+		// snapshot
+		void getSnapshot(OnsetSnapshot&) const noexcept;
+
+		// takes over the coefficients and the design of another OnsetBands.
+		// bands that move to another octave level are reset.
+		// snapshot
+		void setSnapshot(const OnsetSnapshot&) noexcept;
+
+		// the design the coefficients come from
+		const OnsetBandsDesign& getDesign() const noexcept;
+
+		int getNumBands() const noexcept;
 
-		std::function<void(int)> onOnset;
+		// the octave level band i runs at, 0 means full rate
+		// i
+		int getLevel(int) const noexcept;
+
+		// levels needed by the active bands
+		int getNumLevels() const noexcept;
+
+		OnsetCore& operator[](int) noexcept;
+
+		const OnsetCore& operator[](int) const noexcept;
 	private:
-		OnsetBuffer buffer;
-		std::array<OnsetCore, OnsetNumBandsMax> detectors;
-		OnsetStrongHold strongHold;
-		double sampleRate, lowestPitch, highestPitch;
-		float threshold, tilt;
-		int numBands, onset, onsetOut;
+		std::array<OnsetCore, OnsetNumBandsMax> cores;
+		OnsetBandsDesign design;
+		std::array<int, OnsetNumBandsMax> levels;
 
 		void updatePitchRange() noexcept;
 
+		// level
+		double getLevelSampleRate(int) const noexcept;
+
 		void updateTilt() noexcept;
 	};
+
+	// Shares the band coefficients of equal designs across every detector
+	// of the process, so that instances with the same settings design them
+	// once and hold one snapshot between them. Snapshots are immutable and
+	// live as long as someone holds them. Locks, call it off the audio thread.
+	struct OnsetBandsCache
+	{
+		// the process' cache
+		static OnsetBandsCache& getInstance();
+
+		// the snapshot of design, designed now if nobody holds one yet
+		// design
+		std::shared_ptr<const OnsetSnapshot> operator()(const OnsetBandsDesign&);
+
+		// designs with a snapshot that is still held
+		int getNumDesigns();
+	private:
+		struct Entry
+		{
+			OnsetBandsDesign design;
+			std::weak_ptr<const OnsetSnapshot> snapshot;
+		};
+
+		std::mutex mutex;
+		std::vector<Entry> entries;
+		OnsetBands designer;
+
+		OnsetBandsCache();
+	};
+
+	// Gets the band coefficients from OnsetBandsCache on the thread that
+	// sets the parameters and hands them to the audio thread without locks,
+	// so that parameter changes never cost more than a copy on the audio
+	// thread. One thread may set parameters while another one pulls.
+	// The setters lock the process' cache and may design and allocate
+	// (bad_alloc leaves the last snapshot in place), so never call them
+	// from a realtime thread.
+	struct OnsetBandsHandoff
+	{
+		OnsetBandsHandoff();
+
+		// parameters (setter thread):
+
+		void setAttack(double);
+
+		void setDecay(double);
+
+		void setTilt(float);
+
+		void setBandwidth(double);
+
+		void setNumBands(int);
+
+		void setLowestPitch(double);
+
+		void setHighestPitch(double);
+
+		void setMultirate(bool);
+
+		// all of the above at once
+		// design
+		void setDesign(const OnsetBandsDesign&);
+
+		const OnsetBandsDesign& getDesign() const noexcept;
+
+		// sampleRate
+		void prepare(double);
+
+		// process (audio thread):
+
+		// applies the latest snapshot to bands and returns if there was a new one
+		// bands
+		bool pull(OnsetBands&) noexcept;
+	private:
+		OnsetBandsDesign design;
+		// the writer drops its old snapshots, never the audio thread
+		OnsetTripleBuffer<std::shared_ptr<const OnsetSnapshot>> snapshots;
+		// without a sampleRate there is nothing to design yet
+		bool prepared;
+
+		void publish();
+	};
+
+	// Cores: one OnsetCore per band (reference)
+	// Bank: all bands in one SIMD OnsetBank
+	// Multirate: OnsetCores, low bands at decimated rates, the odf lags
+	// so that they line up (see OnsetMultirateT)
+	enum class OnsetEngine { Cores, Bank, Multirate };
+
+	// what the Bank engine computes in
+	// Double: every band in double lanes
+	// Mixed: the bands that fit float (see ResonatorBaseT::fitsFloat) in float
+	// lanes, twice as many per register, the others in double
+	enum class OnsetPrecision { Double, Mixed };
+
+	// Accepts buffers of any length and processes them in chunks of
+	// BlockSize internally. Bigger blocks mean less per-call overhead,
+	// the onset positions are sample-accurate either way.
+	// The band parameters (attack to highest pitch) can be set from
+	// another thread than the processing one, they take effect at the
+	// next block (see OnsetBandsHandoff). They, the engine, the threshold
+	// mode, prepare() and restoreState() may lock and allocate, keep them
+	// off realtime threads.
+	// Bands skip silent blocks once they decayed below OnsetSleepFloor.
+	// When all of them sleep, a block costs one peak check of the input.
+	template<int BlockSize>
+	struct OnsetDetectorT
+	{
+		using Engine = OnsetEngine;
+
+		OnsetDetectorT();
+
+		// parameters:
+
+		void setAttack(double);
+
+		void setDecay(double);
+
+		void setTilt(float);
+
+		void setThreshold(float) noexcept;
+
+		void setHoldLength(double) noexcept;
+
+		// switching resets the adaptive window. the first switch to
+		// Adaptive allocates it (see OnsetPeakPicker). (default: Fixed)
+		void setThresholdMode(OnsetThresholdMode);
+
+		// the Adaptive mode's window, resets it
+		// ms
+		void setPeakWindow(double) noexcept;
+
+		// the Adaptive mode's MADs above the median
+		// spread
+		void setPeakSpread(float) noexcept;
+
+		// how long a peak has to be the highest before it
+		// ms
+		void setPeakLookBack(double) noexcept;
+
+		// fills every event's bands with the bands whose ratio tops the
+		// threshold on its own (default: off, bands stay 0)
+		void setBandMasks(bool) noexcept;
+
+		// groups of bands (e.g. low, mid and high) that compare their own
+		// odf with the threshold and hold on their own, from the same pass
+		// as the whole odf. a group's onsets are extra events with its group.
+		// masks (bit i: band i), numGroups [0, OnsetNumGroupsMax]
+		void setBandGroups(const uint32_t*, int) noexcept;
+
+		void setBandwidth(double);
+
+		void setNumBands(int);
+
+		void setLowestPitch(double);
+
+		void setHighestPitch(double);
+
+		void setEngine(Engine);
+
+		// the Bank engine's precision (default: Mixed)
+		void setPrecision(OnsetPrecision) noexcept;
+
+		// how the ratios are divided and the odf is compared (default: Exact)
+		void setMath(OnsetMath) noexcept;
+
+		// the widest instruction set prepare() may pick (default: the best one)
+		void setMaxISA(OnsetISA) noexcept;
+
+		// process:
+
+		// sampleRate
+		void prepare(double);
+
+		// samples, numChannels, numSamples
+		void operator()(float**, int, int) noexcept;
+
+		// appends every onset of the buffer to events and returns how many.
+		// samples, numChannels, numSamples, events
+		int operator()(float**, int, int, OnsetEvents&) noexcept;
+
+		// same, and fills the view's buffers with numSamples of the odf.
+		// a decimated band's row holds from the first block it was asked for.
+		// samples, numChannels, numSamples, events, view
+		int operator()(float**, int, int, OnsetEvents&, const OnsetOdfView&) noexcept;
+
+		// samples, numChannels, numSamples, view
+		void operator()(float**, int, int, const OnsetOdfView&) noexcept;
+
+		// samples processed since prepare()
+		int64_t getPosition() const noexcept;
+
+		// samples the odf (and its view) lags the input, the events'
+		// positions are the input's. only the Multirate engine has any.
+		int getLatency() const noexcept;
+
+		// the instruction set of the active kernels
+		OnsetISA getISA() const noexcept;
+
+		// checkpoints:
+
+		// bytes saveState needs right now
+		size_t getStateSize() const noexcept;
+
+		// writes the parameters and everything the detector remembers of
+		// the signal, and returns the bytes written, 0 if they don't fit.
+		// between blocks, on the processing thread.
+		// data, capacity
+		size_t saveState(uint8_t*, size_t) const noexcept;
+
+		// continues where the saved detector stopped, as if it had processed
+		// the same signal. it prepares the detector with the saved parameters,
+		// the saved block size doesn't matter. returns false and changes
+		// nothing, if data isn't a whole state of this OnsetStateVersion.
+		// like prepare(), not on a realtime thread.
+		// data, size
+		bool restoreState(const uint8_t*, size_t);
+	private:
+		OnsetBufferT<BlockSize> buffer, odf;
+		OnsetBands bands;
+		OnsetBandsHandoff handoff;
+		OnsetBank bank;
+		OnsetBankF bankF;
+		OnsetTrigger trigger;
+		OnsetPeakPicker picker;
+		// every group's trigger gets its mean ratio, the squared odf
+		std::array<OnsetTrigger, OnsetNumGroupsMax> groupTriggers;
+		std::array<OnsetBufferT<BlockSize>, OnsetNumGroupsMax> groupOdfs;
+		std::array<uint32_t, OnsetNumGroupsMax> groupMasks;
+		// the band rows if the caller's view has none
+		std::array<float, OnsetNumBandsMax * BlockSize> bandRows;
+		OnsetMultirateT<BlockSize> multirate;
+		// a decimated band's ratios before they are held to the full rate
+		OnsetBufferT<BlockSize> levelRatios;
+		// the last ratio every decimated band's row holds
+		std::array<float, OnsetNumBandsMax> heldRatios;
+		int64_t position, sleepSamples;
+		OnsetEvents* events;
+		// the threshold of a ratio, the band mask of the last sample
+		float bandThreshold;
+		uint32_t lastBandMask;
+		int numGroups;
+		const OnsetKernels* kernels;
+		OnsetISA maxISA;
+		Engine engine;
+		OnsetPrecision precision;
+		OnsetMath math;
+		OnsetThresholdMode thresholdMode;
+		// bit i: band i runs in bankF
+		uint32_t floatBands;
+		// bankNeedsUpdate: the banks' coefficients are stale
+		// bankLive: the banks hold the bands' states, from updateBank()
+		// until resetBank()
+		bool bankNeedsUpdate, bankLive, asleep, bandMasks;
+
+		// assigns every band to bank or bankF
+		void updateBank() noexcept;
+
+		// the state of every band the banks hold and returns how many
+		// states
+		int getBankStates(std::array<OnsetBandState, OnsetNumBandsMax>&) const noexcept;
+
+		// hands every band its state in bank or bankF
+		// states, numBands
+		void setBankStates(const std::array<OnsetBandState, OnsetNumBandsMax>&, int) noexcept;
+
+		// the state of every band of the engine and returns how many
+		// states
+		int getBandStates(std::array<OnsetBandState, OnsetNumBandsMax>&) const noexcept;
+
+		// writer
+		void save(OnsetStateWriter&) const noexcept;
+
+		// the parameters at the start of a state, false if they don't belong
+		// to a state of this version
+		// reader, design, engine, precision, math, maxISA
+		static bool readParameters(OnsetStateReader&, OnsetBandsDesign&,
+			Engine&, OnsetPrecision&, OnsetMath&, OnsetISA&) noexcept;
+
+		void resetBank() noexcept;
+
+		// numSamples, silent, view
+		void processCores(int, bool, const OnsetOdfView&) noexcept;
+
+		// numSamples, silent, view
+		void processMultirate(int, bool, const OnsetOdfView&) noexcept;
+
+		// numSamples, silent, view
+		void processBank(int, bool, const OnsetOdfView&) noexcept;
+
+		// if every band of the engine is asleep
+		bool isAsleep() const noexcept;
+
+		// hands the samples the whole detector slept to the engine's bands
+		void wake() noexcept;
+
+		// samples, numChannels, numSamples (<= BlockSize), view
+		void processBlock(float**, int, int, const OnsetOdfView&) noexcept;
+
+		// bit i: band i's ratio at s tops bandThreshold
+		// rows, s
+		uint32_t getBandMask(const OnsetOdfView&, int) const noexcept;
+
+		// triggers the whole odf and the groups and fills the events' bands
+		// rows, numSamples
+		void triggerBands(const OnsetOdfView&, int) noexcept;
+	};
+
+	using OnsetDetector = OnsetDetectorT<BlockSize>;
 }
 
 /*
@@ -0,0 +1,91 @@
+#include "OnsetEvaluation.h"
+#include <cmath>
+
+namespace dsp
+{
+	OnsetScore::OnsetScore() :
+		errorSum(0.), maxError(0.),
+		numOnsets(0), numEvents(0), numHits(0)
+	{
+	}
+
+	void OnsetScore::operator()(const std::vector<int64_t>& onsets,
+		const std::vector<OnsetEvent>& events, double sampleRate, double windowMs)
+	{
+		const auto msPerSample = 1000. / sampleRate;
+		numOnsets += static_cast<int>(onsets.size());
+		numEvents += static_cast<int>(events.size());
+		// both are sorted, so an onset that is too early for one event is
+		// too early for every later one
+		auto o = size_t(0);
+		for (const auto& e : events)
+		{
+			const auto eventTime = (static_cast<double>(e.position) + static_cast<double>(e.offset)) * msPerSample;
+			while (o < onsets.size() && static_cast<double>(onsets[o]) * msPerSample < eventTime - windowMs)
+				++o;
+			if (o == onsets.size())
+				break;
+			const auto error = eventTime - static_cast<double>(onsets[o]) * msPerSample;
+			// the next onset is too late
+			if (error < -windowMs)
+				continue;
+			++numHits;
+			errorSum += error;
+			if (maxError < std::abs(error))
+				maxError = std::abs(error);
+			++o;
+		}
+	}
+
+	void OnsetScore::add(const OnsetScore& other) noexcept
+	{
+		errorSum += other.errorSum;
+		if (maxError < other.maxError)
+			maxError = other.maxError;
+		numOnsets += other.numOnsets;
+		numEvents += other.numEvents;
+		numHits += other.numHits;
+	}
+
+	int OnsetScore::getNumHits() const noexcept
+	{
+		return numHits;
+	}
+
+	int OnsetScore::getNumFalse() const noexcept
+	{
+		return numEvents - numHits;
+	}
+
+	int OnsetScore::getNumMissed() const noexcept
+	{
+		return numOnsets - numHits;
+	}
+
+	double OnsetScore::getPrecision() const noexcept
+	{
+		return numEvents == 0 ? 1. : static_cast<double>(numHits) / static_cast<double>(numEvents);
+	}
+
+	double OnsetScore::getRecall() const noexcept
+	{
+		return numOnsets == 0 ? 1. : static_cast<double>(numHits) / static_cast<double>(numOnsets);
+	}
+
+	double OnsetScore::getFMeasure() const noexcept
+	{
+		const auto p = getPrecision();
+		const auto r = getRecall();
+		return p + r == 0. ? 0. : 2. * p * r / (p + r);
+	}
+
+	double OnsetScore::getMeanError() const noexcept
+	{
+		return numHits == 0 ? 0. : errorSum / static_cast<double>(numHits);
+	}
+
+	double OnsetScore::getMaxError() const noexcept
+	{
+		return maxError;
+	}
+}
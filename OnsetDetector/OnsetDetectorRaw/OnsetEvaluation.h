@@ -0,0 +1,44 @@
+#pragma once
+#include "OnsetEvent.h"
+#include <vector>
+
+namespace dsp
+{
+	// How well detected onsets match the true ones. Scores of several
+	// signals add up to one score of all of them.
+	struct OnsetScore
+	{
+		OnsetScore();
+
+		// matches every event to the earliest unmatched onset within
+		// windowMs of it. the events' positions count from the signal's start.
+		// onsets, events, sampleRate, windowMs
+		void operator()(const std::vector<int64_t>&, const std::vector<OnsetEvent>&, double, double);
+
+		// other
+		void add(const OnsetScore&) noexcept;
+
+		int getNumHits() const noexcept;
+
+		// events that match no onset
+		int getNumFalse() const noexcept;
+
+		// onsets that match no event
+		int getNumMissed() const noexcept;
+
+		double getPrecision() const noexcept;
+
+		double getRecall() const noexcept;
+
+		double getFMeasure() const noexcept;
+
+		// mean of event minus onset time of the hits in ms (the latency)
+		double getMeanError() const noexcept;
+
+		// largest distance of a hit from its onset in ms
+		double getMaxError() const noexcept;
+	private:
+		double errorSum, maxError;
+		int numOnsets, numEvents, numHits;
+	};
+}
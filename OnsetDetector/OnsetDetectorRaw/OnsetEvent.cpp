@@ -0,0 +1,60 @@
+#include "OnsetEvent.h"
+
+namespace dsp
+{
+	OnsetEvents::OnsetEvents(OnsetEvent* _data, int _capacity) noexcept :
+		data(_data),
+		capacity(_capacity),
+		numEvents(0),
+		numDropped(0)
+	{
+	}
+
+	void OnsetEvents::clear() noexcept
+	{
+		numEvents = 0;
+		numDropped = 0;
+	}
+
+	bool OnsetEvents::add(const OnsetEvent& e) noexcept
+	{
+		if (numEvents == capacity)
+		{
+			++numDropped;
+			return false;
+		}
+		data[numEvents] = e;
+		++numEvents;
+		return true;
+	}
+
+	int OnsetEvents::size() const noexcept
+	{
+		return numEvents;
+	}
+
+	int OnsetEvents::getNumDropped() const noexcept
+	{
+		return numDropped;
+	}
+
+	const OnsetEvent& OnsetEvents::operator[](int i) const noexcept
+	{
+		return data[i];
+	}
+
+	OnsetEvent& OnsetEvents::operator[](int i) noexcept
+	{
+		return data[i];
+	}
+
+	const OnsetEvent* OnsetEvents::begin() const noexcept
+	{
+		return data;
+	}
+
+	const OnsetEvent* OnsetEvents::end() const noexcept
+	{
+		return data + numEvents;
+	}
+}
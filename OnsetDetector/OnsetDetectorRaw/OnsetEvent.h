@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+
+namespace dsp
+{
+	struct OnsetEvent
+	{
+		// absolute sample index since prepare()
+		int64_t position;
+		// detection function value at position
+		float strength;
+		// where the threshold was crossed, relative to position [-1, 0],
+		// 0 for a peak (see OnsetPeakPicker)
+		float offset;
+		// bit i: band i's ratio topped the threshold on its own, 0 unless
+		// the detector fills it (see OnsetDetectorT::setBandMasks)
+		uint32_t bands;
+		// 0: the whole odf, g + 1: band group g (see OnsetDetectorT::setBandGroups)
+		int group;
+	};
+
+	// A view on caller-owned, preallocated events.
+	// The detector appends to it and never allocates.
+	struct OnsetEvents
+	{
+		// data, capacity
+		OnsetEvents(OnsetEvent*, int) noexcept;
+
+		void clear() noexcept;
+
+		// returns false and counts the event as dropped if full
+		bool add(const OnsetEvent&) noexcept;
+
+		int size() const noexcept;
+
+		int getNumDropped() const noexcept;
+
+		const OnsetEvent& operator[](int) const noexcept;
+
+		// lets a stage add to an event another one appended
+		OnsetEvent& operator[](int) noexcept;
+
+		const OnsetEvent* begin() const noexcept;
+
+		const OnsetEvent* end() const noexcept;
+	private:
+		OnsetEvent* data;
+		int capacity, numEvents, numDropped;
+	};
+}
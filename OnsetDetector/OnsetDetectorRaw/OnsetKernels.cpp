@@ -0,0 +1,142 @@
+#include "OnsetKernelsImpl.h"
+#include <cstdint>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define OnsetIsX86 1
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define OnsetIsX86 1
+#else
+#define OnsetIsX86 0
+#endif
+
+namespace dsp
+{
+	// defined in the translation unit of each instruction set.
+	// nullptr if it was not compiled with that set enabled.
+	const OnsetKernels* getOnsetKernelsSSE2() noexcept;
+	const OnsetKernels* getOnsetKernelsAVX2() noexcept;
+	const OnsetKernels* getOnsetKernelsAVX512() noexcept;
+
+	namespace
+	{
+#if OnsetIsX86
+		struct CpuId
+		{
+			unsigned a, b, c, d;
+		};
+
+		// leaf, subleaf
+		CpuId cpuId(unsigned leaf, unsigned subleaf) noexcept
+		{
+			CpuId r = { 0, 0, 0, 0 };
+#if defined(_MSC_VER)
+			int x[4];
+			__cpuidex(x, static_cast<int>(leaf), static_cast<int>(subleaf));
+			r = { static_cast<unsigned>(x[0]), static_cast<unsigned>(x[1]),
+				static_cast<unsigned>(x[2]), static_cast<unsigned>(x[3]) };
+#else
+			__cpuid_count(leaf, subleaf, r.a, r.b, r.c, r.d);
+#endif
+			return r;
+		}
+
+		// which register states the os saves on context switches
+		uint64_t getXCR0() noexcept
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			unsigned lo, hi;
+			__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+			return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+		}
+
+		bool hasBit(unsigned x, int bit) noexcept
+		{
+			return (x >> bit) & 1;
+		}
+
+		OnsetISA detectISA() noexcept
+		{
+			const auto maxLeaf = cpuId(0, 0).a;
+			const auto leaf1 = cpuId(1, 0);
+			if (!hasBit(leaf1.d, 26))
+				return OnsetISA::Scalar;
+			// avx needs the os to save the ymm registers (xcr0 bits 1, 2)
+			const auto osxsave = hasBit(leaf1.c, 27);
+			const auto xcr0 = osxsave ? getXCR0() : 0;
+			const auto osYmm = (xcr0 & 0x6) == 0x6;
+			const auto avx = hasBit(leaf1.c, 28) && hasBit(leaf1.c, 12) && osYmm;
+			if (!avx || maxLeaf < 7)
+				return OnsetISA::SSE2;
+			const auto leaf7 = cpuId(7, 0);
+			if (!hasBit(leaf7.b, 5))
+				return OnsetISA::SSE2;
+			// avx-512 also needs the opmask and zmm states (xcr0 bits 5 to 7).
+			// the compilers may emit any of F, DQ, BW and VL for it.
+			const auto osZmm = (xcr0 & 0xe6) == 0xe6;
+			const auto avx512 = hasBit(leaf7.b, 16) && hasBit(leaf7.b, 17)
+				&& hasBit(leaf7.b, 30) && hasBit(leaf7.b, 31);
+			if (!avx512 || !osZmm)
+				return OnsetISA::AVX2;
+			return OnsetISA::AVX512;
+		}
+#else
+		OnsetISA detectISA() noexcept
+		{
+			return OnsetISA::Scalar;
+		}
+#endif
+
+		const OnsetKernels* getOnsetKernelsScalar() noexcept
+		{
+			static const OnsetKernels kernels = makeOnsetKernels<simd::VecD1, simd::VecF1>(OnsetISA::Scalar);
+			return &kernels;
+		}
+	}
+
+	OnsetISA getOnsetISA() noexcept
+	{
+		static const auto isa = detectISA();
+		return isa;
+	}
+
+	const OnsetKernels* getOnsetKernels(OnsetISA isa) noexcept
+	{
+		if (static_cast<int>(isa) > static_cast<int>(getOnsetISA()))
+			return nullptr;
+		switch (isa)
+		{
+		case OnsetISA::Scalar: return getOnsetKernelsScalar();
+		case OnsetISA::SSE2: return getOnsetKernelsSSE2();
+		case OnsetISA::AVX2: return getOnsetKernelsAVX2();
+		case OnsetISA::AVX512: return getOnsetKernelsAVX512();
+		default: return nullptr;
+		}
+	}
+
+	const OnsetKernels& selectOnsetKernels(OnsetISA maxISA) noexcept
+	{
+		for (auto i = static_cast<int>(maxISA); i > 0; --i)
+		{
+			const auto kernels = getOnsetKernels(static_cast<OnsetISA>(i));
+			if (kernels != nullptr)
+				return *kernels;
+		}
+		return *getOnsetKernelsScalar();
+	}
+
+	const char* toString(OnsetISA isa) noexcept
+	{
+		switch (isa)
+		{
+		case OnsetISA::Scalar: return "Scalar";
+		case OnsetISA::SSE2: return "SSE2";
+		case OnsetISA::AVX2: return "AVX2";
+		case OnsetISA::AVX512: return "AVX512";
+		default: return "";
+		}
+	}
+}
@@ -0,0 +1,171 @@
+#pragma once
+#include "OnsetAxiom.h"
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace dsp
+{
+	// instruction sets the hot paths are compiled for, from narrow to wide
+	enum class OnsetISA { Scalar, SSE2, AVX2, AVX512 };
+
+	// how the band ratios are summed and the odf is compared
+	// Exact: the Bank engine sums every register of bands on its own and
+	// the combine takes the root of the odf (reference)
+	// Fast: the Bank engine sums all registers lane by lane first, in the
+	// lanes' precision, and the trigger compares the squared odf with the
+	// squared threshold, so the combine takes no root. the odf only differs
+	// by the rounding of the sum, a few float ulps, so onsets can only come
+	// or go where the odf is that close to the threshold.
+	enum class OnsetMath { Exact, Fast };
+
+	// the OnsetBank's lanes, see OnsetBank.h
+	template<typename Float>
+	struct OnsetBankLanesT
+	{
+		Float* resoA0, * resoB1, * resoB2, * resoZ1, * resoZ2;
+		Float* lpA0, * lpB1, * lpY1;
+		Float* env0Y1, * env0Atk, * env0Dcy, * env0State;
+		Float* env1Y1, * env1Atk, * env1Dcy, * env1State;
+		Float* gain;
+	};
+
+	using OnsetBankLanes = OnsetBankLanesT<double>;
+	using OnsetBankLanesF = OnsetBankLanesT<float>;
+
+	// one band of several streams (see MultiStreamOnsetDetector). every
+	// stream runs the band's coefficients on its own lane of the state.
+	template<typename Float>
+	struct OnsetStreamBandT
+	{
+		Float resoA0, resoB1, resoB2, lpA0, lpB1;
+		Float env0Atk, env0Dcy, env1Atk, env1Dcy, gain;
+		Float* resoZ1, * resoZ2, * lpY1;
+		Float* env0Y1, * env0State, * env1Y1, * env1State;
+	};
+
+	using OnsetStreamBand = OnsetStreamBandT<double>;
+	using OnsetStreamBandF = OnsetStreamBandT<float>;
+
+	// a lane that is all bits, what the kernels' compares give for true.
+	// the envelopes' states are all bits or none, in every lane type.
+	template<typename Float>
+	inline Float getOnsetTrueMask() noexcept
+	{
+		using Bits = typename std::conditional<sizeof(Float) == 8, uint64_t, uint32_t>::type;
+		const auto bits = ~Bits(0);
+		Float x;
+		std::memcpy(&x, &bits, sizeof(x));
+		return x;
+	}
+
+	// the lanes of the widest register of any instruction set, in float
+	static constexpr int OnsetMaxLanes = 16;
+
+	// A resonator's (Resonator2T, Resonator3T) outputs over a register of
+	// up to OnsetMaxLanes samples, without its clipping. the two-pole's
+	// output k is the sum of impulse[OnsetMaxLanes + k - j] x[j] over the
+	// inputs j, plus fromZ1[k] z1 + fromZ2[k] z2 for the state before the
+	// register. its lowpass (Resonator3T's highpass subtracts it) is the
+	// same with the low arrays, plus lowFromY1[k] lpY1.
+	template<typename Float>
+	struct OnsetResonatorResponseT
+	{
+		// zeros below OnsetMaxLanes, so that no output sees a later input
+		Float impulse[2 * OnsetMaxLanes];
+		Float fromZ1[OnsetMaxLanes], fromZ2[OnsetMaxLanes];
+		Float lowImpulse[2 * OnsetMaxLanes];
+		Float lowFromZ1[OnsetMaxLanes], lowFromZ2[OnsetMaxLanes], lowFromY1[OnsetMaxLanes];
+	};
+
+	using OnsetResonatorResponse = OnsetResonatorResponseT<double>;
+	using OnsetResonatorResponseF = OnsetResonatorResponseT<float>;
+
+	// what the lowpass scan checks in every register it filters. an
+	// envelope follower switches between attack and decay, where the
+	// input crosses the envelope, so it scans as long as it wouldn't.
+	enum class OnsetScanBound
+	{
+		// filters every sample
+		None,
+		// stops before the first register with an output above its input
+		Rising,
+		// stops before the first register with an output below its input
+		Falling
+	};
+
+	// One instruction set's version of every hot path. Every set lives in
+	// its own translation unit (OnsetKernelsSSE2.cpp, ...) that is compiled
+	// with that set enabled, so a single binary runs on every CPU and still
+	// uses the wide registers of the ones that have them.
+	struct OnsetKernels
+	{
+		// dst, samples, numChannels, numSamples
+		using CopyFromMid = void(*)(float*, const float* const*, int, int);
+		// samples, numSamples
+		using Rectify = void(*)(float*, int);
+		// samples, numSamples
+		using GetMaxMag = float(*)(const float*, int);
+		// lanes, numBands, input (rectified), output (adds the sum of band ratios),
+		// ratios (nullptr or a row per band that gets its ratios), numSamples
+		using ProcessBank = void(*)(const OnsetBankLanes&, int, const float*, float*, float* const*, int);
+		// same in float lanes
+		using ProcessBankF = void(*)(const OnsetBankLanesF&, int, const float*, float*, float* const*, int);
+		// one band of every stream, the streams in lanes. input and odf hold
+		// numStreams values per sample.
+		// band, numStreams, input (rectified), odf (adds the band's ratios), numSamples
+		using ProcessStreams = void(*)(const OnsetStreamBand&, int, const float*, float*, int);
+		// same in float lanes
+		using ProcessStreamsF = void(*)(const OnsetStreamBandF&, int, const float*, float*, int);
+		// odf (sum of band ratios, becomes sqrt(odf / numBands)), numBands, numSamples
+		using Combine = void(*)(float*, float, int);
+		// odf (sum of band ratios, becomes odf / numBands, the squared odf), numBands, numSamples
+		using CombineSquared = void(*)(float*, float, int);
+		// a one-pole lowpass over whole registers of samples at once.
+		// returns how many samples it filtered, all of them for
+		// OnsetScanBound::None, else a multiple of width.
+		// samples (become the output), a0, b1, y1, bound, numSamples
+		using ScanLowpass = int(*)(float*, double, double, double&, OnsetScanBound, int);
+		// same with the state in float, a multiple of widthF
+		using ScanLowpassF = int(*)(float*, float, float, float&, OnsetScanBound, int);
+		// a resonator over whole registers of samples at once. stops before
+		// the first register it would clip and returns how many samples it
+		// filtered, a multiple of width. without lpY1 it is the two-pole
+		// alone, with it the two-pole minus its lowpass.
+		// samples (become the output), response, z1, z2, lpY1 or nullptr, numSamples
+		using ScanResonator = int(*)(float*, const OnsetResonatorResponse&, double&, double&, double*, int);
+		// same with the state in float, a multiple of widthF
+		using ScanResonatorF = int(*)(float*, const OnsetResonatorResponseF&, float&, float&, float*, int);
+
+		OnsetISA isa;
+		// doubles and floats per register
+		int width, widthF;
+		CopyFromMid copyFromMid;
+		Rectify rectify;
+		GetMaxMag getMaxMag;
+		ProcessBank processBank;
+		ProcessBankF processBankF;
+		// OnsetMath::Fast versions
+		ProcessBank processBankFast;
+		ProcessBankF processBankFastF;
+		Combine combine;
+		CombineSquared combineSquared;
+		ScanLowpass scanLowpass;
+		ScanLowpassF scanLowpassF;
+		ScanResonator scanResonator;
+		ScanResonatorF scanResonatorF;
+		ProcessStreams processStreams;
+		ProcessStreamsF processStreamsF;
+	};
+
+	// the widest instruction set this cpu and os support. detected once.
+	OnsetISA getOnsetISA() noexcept;
+
+	// the kernels of isa or nullptr, if this cpu or build doesn't support it.
+	const OnsetKernels* getOnsetKernels(OnsetISA) noexcept;
+
+	// the kernels of the widest supported isa that is not wider than maxISA.
+	const OnsetKernels& selectOnsetKernels(OnsetISA = OnsetISA::AVX512) noexcept;
+
+	const char* toString(OnsetISA) noexcept;
+}
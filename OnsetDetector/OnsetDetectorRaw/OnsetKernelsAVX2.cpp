@@ -0,0 +1,16 @@
+#include "OnsetKernelsImpl.h"
+
+// Compiled with AVX2 enabled (see OnsetDetectorRaw.vcxproj).
+
+namespace dsp
+{
+	const OnsetKernels* getOnsetKernelsAVX2() noexcept
+	{
+#if OnsetHasAVX2
+		static const OnsetKernels kernels = makeOnsetKernels<simd::VecD4, simd::VecF8>(OnsetISA::AVX2);
+		return &kernels;
+#else
+		return nullptr;
+#endif
+	}
+}
@@ -0,0 +1,16 @@
+#include "OnsetKernelsImpl.h"
+
+// Compiled with AVX512 enabled (see OnsetDetectorRaw.vcxproj).
+
+namespace dsp
+{
+	const OnsetKernels* getOnsetKernelsAVX512() noexcept
+	{
+#if OnsetHasAVX512
+		static const OnsetKernels kernels = makeOnsetKernels<simd::VecD8, simd::VecF16>(OnsetISA::AVX512);
+		return &kernels;
+#else
+		return nullptr;
+#endif
+	}
+}
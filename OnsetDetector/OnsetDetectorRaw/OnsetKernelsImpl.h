@@ -0,0 +1,389 @@
+#pragma once
+#include "OnsetKernels.h"
+#include "OnsetSIMD.h"
+#include <type_traits>
+
+// The kernel bodies. Only included by the OnsetKernels*.cpp files, which
+// instantiate them for the vectors of the instruction set they are
+// compiled for. Everything is in an unnamed namespace, so no two sets can
+// share a symbol.
+namespace dsp
+{
+	namespace
+	{
+		template<class VecF>
+		void copyFromMidKernel(float* dst, const float* const* samples, int numChannels, int numSamples) noexcept
+		{
+			const auto l = samples[0];
+			auto s = 0;
+			if (numChannels != 2)
+			{
+				for (; s + VecF::Size <= numSamples; s += VecF::Size)
+					VecF::load(l + s).store(dst + s);
+				for (; s < numSamples; ++s)
+					dst[s] = l[s];
+				return;
+			}
+			const auto r = samples[1];
+			const auto half = VecF::broadcast(.5f);
+			for (; s + VecF::Size <= numSamples; s += VecF::Size)
+				((VecF::load(l + s) + VecF::load(r + s)) * half).store(dst + s);
+			for (; s < numSamples; ++s)
+				dst[s] = (l[s] + r[s]) * .5f;
+		}
+
+		template<class VecF>
+		void rectifyKernel(float* samples, int numSamples) noexcept
+		{
+			auto s = 0;
+			for (; s + VecF::Size <= numSamples; s += VecF::Size)
+				simd::abs(VecF::load(samples + s)).store(samples + s);
+			for (; s < numSamples; ++s)
+				samples[s] = std::abs(samples[s]);
+		}
+
+		template<class VecF>
+		float getMaxMagKernel(const float* samples, int numSamples) noexcept
+		{
+			auto s = 0;
+			auto maxV = VecF::broadcast(0.f);
+			for (; s + VecF::Size <= numSamples; s += VecF::Size)
+				maxV = simd::max(maxV, VecF::load(samples + s));
+			auto max = simd::reduceMax(maxV);
+			for (; s < numSamples; ++s)
+				if (max < samples[s])
+					max = samples[s];
+			return max;
+		}
+
+		// band groups are processed one after another with their state
+		// held in registers for the whole block. unused lanes up to the
+		// next full register must be cleared (see OnsetBank::clearBand).
+		// adds to output, so a double and a float bank can share it.
+		// Fast (OnsetMath::Fast) adds the groups' ratios lane by lane into
+		// one register per sample, chunk by chunk, so that every sample has
+		// a single horizontal sum instead of one per group.
+		// ratios gets every band's row, the branch is taken the same way
+		// for the whole block.
+		template<class Vec, bool Fast>
+		void processBankKernel(const OnsetBankLanesT<typename Vec::Scalar>& l, int numBands,
+			const float* input, float* output, float* const* ratios, int numSamples) noexcept
+		{
+			using Scalar = typename Vec::Scalar;
+			static constexpr int Chunk = 64;
+			alignas(64) Scalar sums[Fast ? Chunk * Vec::Size : 1];
+			const auto numLanes = (numBands + Vec::Size - 1) / Vec::Size * Vec::Size;
+			if (numLanes == 0)
+				return;
+			const auto one = Vec::broadcast(static_cast<Scalar>(1.));
+			const auto eps = Vec::broadcast(static_cast<Scalar>(1e-6));
+			// only the sums of Fast need chunks
+			const auto chunk = Fast ? Chunk : numSamples;
+			for (auto start = 0; start < numSamples; start += chunk)
+			{
+				const auto n = numSamples - start < chunk ? numSamples - start : chunk;
+				const auto in = input + start;
+				const auto out = output + start;
+				for (auto i = 0; i < numLanes; i += Vec::Size)
+				{
+					const auto resoA0 = Vec::load(l.resoA0 + i);
+					const auto resoB1 = Vec::load(l.resoB1 + i);
+					const auto resoB2 = Vec::load(l.resoB2 + i);
+					const auto lpA0 = Vec::load(l.lpA0 + i);
+					const auto lpB1 = Vec::load(l.lpB1 + i);
+					const auto env0Atk = Vec::load(l.env0Atk + i);
+					const auto env0Dcy = Vec::load(l.env0Dcy + i);
+					const auto env1Atk = Vec::load(l.env1Atk + i);
+					const auto env1Dcy = Vec::load(l.env1Dcy + i);
+					const auto gain = Vec::load(l.gain + i);
+					auto z1 = Vec::load(l.resoZ1 + i);
+					auto z2 = Vec::load(l.resoZ2 + i);
+					auto lpY1 = Vec::load(l.lpY1 + i);
+					auto env0Y1 = Vec::load(l.env0Y1 + i);
+					auto env0State = Vec::load(l.env0State + i);
+					auto env1Y1 = Vec::load(l.env1Y1 + i);
+					auto env1State = Vec::load(l.env1State + i);
+					const auto numRows = numBands - i < Vec::Size ? numBands - i : Vec::Size;
+					for (auto s = 0; s < n; ++s)
+					{
+						const auto x = Vec::broadcast(static_cast<Scalar>(in[s]));
+						const auto y = simd::resonate(x, resoA0, resoB1, resoB2, z1, z2, lpA0, lpB1, lpY1);
+						const auto rectified = simd::abs(y);
+						const auto e0 = simd::followEnvelope(rectified, env0Y1, env0State, env0Atk, env0Dcy, one);
+						const auto e1 = simd::followEnvelope(rectified, env1Y1, env1State, env1Atk, env1Dcy, one);
+						const auto ratio = gain * e0 / (e1 + eps);
+						if (Fast)
+						{
+							const auto sum = sums + s * Vec::Size;
+							(i == 0 ? ratio : Vec::load(sum) + ratio).store(sum);
+						}
+						else
+							out[s] += static_cast<float>(simd::sum(ratio));
+						if (ratios != nullptr)
+						{
+							alignas(64) Scalar lanes[Vec::Size];
+							ratio.store(lanes);
+							for (auto j = 0; j < numRows; ++j)
+								ratios[i + j][start + s] = static_cast<float>(lanes[j]);
+						}
+					}
+
+					z1.store(l.resoZ1 + i);
+					z2.store(l.resoZ2 + i);
+					lpY1.store(l.lpY1 + i);
+					env0Y1.store(l.env0Y1 + i);
+					env0State.store(l.env0State + i);
+					env1Y1.store(l.env1Y1 + i);
+					env1State.store(l.env1State + i);
+				}
+				if (Fast)
+					for (auto s = 0; s < n; ++s)
+						out[s] += static_cast<float>(simd::sum(Vec::load(sums + s * Vec::Size)));
+			}
+		}
+
+		// one band of the streams [first, first + Vec::Size). their state
+		// stays in registers for the whole block.
+		template<class Vec>
+		void processStreamLanes(const OnsetStreamBandT<typename Vec::Scalar>& b, int first, int numStreams,
+			const float* input, float* odf, int numSamples) noexcept
+		{
+			using Scalar = typename Vec::Scalar;
+			const auto resoA0 = Vec::broadcast(b.resoA0);
+			const auto resoB1 = Vec::broadcast(b.resoB1);
+			const auto resoB2 = Vec::broadcast(b.resoB2);
+			const auto lpA0 = Vec::broadcast(b.lpA0);
+			const auto lpB1 = Vec::broadcast(b.lpB1);
+			const auto env0Atk = Vec::broadcast(b.env0Atk);
+			const auto env0Dcy = Vec::broadcast(b.env0Dcy);
+			const auto env1Atk = Vec::broadcast(b.env1Atk);
+			const auto env1Dcy = Vec::broadcast(b.env1Dcy);
+			const auto gain = Vec::broadcast(b.gain);
+			const auto one = Vec::broadcast(static_cast<Scalar>(1.));
+			const auto eps = Vec::broadcast(static_cast<Scalar>(1e-6));
+			auto z1 = Vec::load(b.resoZ1 + first);
+			auto z2 = Vec::load(b.resoZ2 + first);
+			auto lpY1 = Vec::load(b.lpY1 + first);
+			auto env0Y1 = Vec::load(b.env0Y1 + first);
+			auto env0State = Vec::load(b.env0State + first);
+			auto env1Y1 = Vec::load(b.env1Y1 + first);
+			auto env1State = Vec::load(b.env1State + first);
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				const auto offset = s * numStreams + first;
+				const auto x = Vec::loadFloats(input + offset);
+				const auto y = simd::resonate(x, resoA0, resoB1, resoB2, z1, z2, lpA0, lpB1, lpY1);
+				const auto rectified = simd::abs(y);
+				const auto e0 = simd::followEnvelope(rectified, env0Y1, env0State, env0Atk, env0Dcy, one);
+				const auto e1 = simd::followEnvelope(rectified, env1Y1, env1State, env1Atk, env1Dcy, one);
+				(Vec::loadFloats(odf + offset) + gain * e0 / (e1 + eps)).storeFloats(odf + offset);
+			}
+			z1.store(b.resoZ1 + first);
+			z2.store(b.resoZ2 + first);
+			lpY1.store(b.lpY1 + first);
+			env0Y1.store(b.env0Y1 + first);
+			env0State.store(b.env0State + first);
+			env1Y1.store(b.env1Y1 + first);
+			env1State.store(b.env1State + first);
+		}
+
+		// the streams are the lanes and share the band's coefficients. the
+		// ones that don't fill a whole register run a lane at a time.
+		template<class Vec>
+		void processStreamsKernel(const OnsetStreamBandT<typename Vec::Scalar>& b, int numStreams,
+			const float* input, float* odf, int numSamples) noexcept
+		{
+			using Lane = typename std::conditional<std::is_same<typename Vec::Scalar, double>::value,
+				simd::VecD1, simd::VecF1>::type;
+			auto i = 0;
+			for (; i + Vec::Size <= numStreams; i += Vec::Size)
+				processStreamLanes<Vec>(b, i, numStreams, input, odf, numSamples);
+			for (; i < numStreams; ++i)
+				processStreamLanes<Lane>(b, i, numStreams, input, odf, numSamples);
+		}
+
+		template<class VecF>
+		void combineKernel(float* odf, float numBands, int numSamples) noexcept
+		{
+			auto s = 0;
+			const auto numBandsV = VecF::broadcast(numBands);
+			for (; s + VecF::Size <= numSamples; s += VecF::Size)
+				simd::sqrt(VecF::load(odf + s) / numBandsV).store(odf + s);
+			for (; s < numSamples; ++s)
+				odf[s] = std::sqrt(odf[s] / numBands);
+		}
+
+		template<class VecF>
+		void combineSquaredKernel(float* odf, float numBands, int numSamples) noexcept
+		{
+			auto s = 0;
+			const auto gain = 1.f / numBands;
+			const auto gainV = VecF::broadcast(gain);
+			for (; s + VecF::Size <= numSamples; s += VecF::Size)
+				(VecF::load(odf + s) * gainV).store(odf + s);
+			for (; s < numSamples; ++s)
+				odf[s] *= gain;
+		}
+
+		// the sum of a register's inputs through a response, 4 partial sums
+		// at a time, so that the adds don't wait for each other. response[k]
+		// weighs input j into output j + k, and the Size values below it
+		// are zeros (see OnsetResonatorResponseT).
+		// response, in
+		template<class Vec>
+		inline Vec sumThrough(const typename Vec::Scalar* response, const float* in) noexcept
+		{
+			using Scalar = typename Vec::Scalar;
+			static constexpr int Size = Vec::Size;
+			auto y = Vec::zero();
+			if (Size < 4)
+			{
+				for (auto j = 0; j < Size; ++j)
+					y = y + Vec::load(response - j) * Vec::broadcast(static_cast<Scalar>(in[j]));
+				return y;
+			}
+			auto sum1 = Vec::zero(), sum2 = Vec::zero(), sum3 = Vec::zero();
+			for (auto j = 0; j < Size; j += 4)
+			{
+				y = y + Vec::load(response - j) * Vec::broadcast(static_cast<Scalar>(in[j]));
+				sum1 = sum1 + Vec::load(response - j - 1) * Vec::broadcast(static_cast<Scalar>(in[j + 1]));
+				sum2 = sum2 + Vec::load(response - j - 2) * Vec::broadcast(static_cast<Scalar>(in[j + 2]));
+				sum3 = sum3 + Vec::load(response - j - 3) * Vec::broadcast(static_cast<Scalar>(in[j + 3]));
+			}
+			return (y + sum1) + (sum2 + sum3);
+		}
+
+		// y = a0 x + b1 y1 for a register of samples at once. unrolled, output
+		// k is the sum of a0 b1^(k - j) x[j] over the inputs j <= k plus
+		// b1^(k + 1) times the last output of the register before. only that
+		// value links the registers, so the sum of the inputs doesn't wait
+		// for the one before and the chain is one multiply-add per register.
+		template<class Vec>
+		int scanLowpassKernel(float* samples, typename Vec::Scalar a0, typename Vec::Scalar b1,
+			typename Vec::Scalar& y1, OnsetScanBound bound, int numSamples) noexcept
+		{
+			using Scalar = typename Vec::Scalar;
+			static constexpr int Size = Vec::Size;
+			// an instant one-pole follows its input, so it can't tell where
+			// an envelope would have switched
+			if (bound != OnsetScanBound::None && !(b1 > static_cast<Scalar>(0.)))
+				return 0;
+			// weights[Size + k] is a0 b1^k. the zeros below it make the
+			// register at Size - j the weights of input j for every output.
+			Scalar weights[2 * Size];
+			Scalar powers[Size];
+			auto power = static_cast<Scalar>(1.);
+			for (auto k = 0; k < Size; ++k)
+			{
+				weights[k] = static_cast<Scalar>(0.);
+				weights[Size + k] = a0 * power;
+				power *= b1;
+				powers[k] = power;
+			}
+			const auto carry = Vec::load(powers);
+
+			// y1 is written back once. in float it could alias the samples,
+			// so it wouldn't stay in a register otherwise.
+			auto state = y1;
+			auto s = 0;
+			for (; s + Size <= numSamples; s += Size)
+			{
+				const auto in = samples + s;
+				const auto y = sumThrough<Vec>(weights + Size, in) + carry * Vec::broadcast(state);
+				const auto x = Vec::loadFloats(in);
+				if ((bound == OnsetScanBound::Rising && simd::any(simd::lessThan(x, y)))
+					|| (bound == OnsetScanBound::Falling && simd::any(simd::lessThan(y, x))))
+					break;
+				y.storeFloats(samples + s);
+				state = simd::last(y);
+			}
+			if (bound == OnsetScanBound::None)
+				for (; s < numSamples; ++s)
+				{
+					state = static_cast<Scalar>(samples[s]) * a0 + state * b1;
+					samples[s] = static_cast<float>(state);
+				}
+			y1 = state;
+			return s;
+		}
+
+		// Resonator2T or Resonator3T for a register of samples at once: the
+		// inputs through the impulse responses plus the state's responses,
+		// so only the state after the register links it to the next. the
+		// result is only right while nothing clips, so the kernel stops
+		// before the first register with a two-pole output outside [-1, 1].
+		template<class Vec>
+		int scanResonatorKernel(float* samples, const OnsetResonatorResponseT<typename Vec::Scalar>& r,
+			typename Vec::Scalar& z1, typename Vec::Scalar& z2, typename Vec::Scalar* lpY1, int numSamples) noexcept
+		{
+			using Scalar = typename Vec::Scalar;
+			static constexpr int Size = Vec::Size;
+			const auto fromZ1 = Vec::load(r.fromZ1);
+			const auto fromZ2 = Vec::load(r.fromZ2);
+			const auto lowFromZ1 = Vec::load(r.lowFromZ1);
+			const auto lowFromZ2 = Vec::load(r.lowFromZ2);
+			const auto lowFromY1 = Vec::load(r.lowFromY1);
+			const auto one = Vec::broadcast(static_cast<Scalar>(1.));
+			const auto minusOne = Vec::broadcast(static_cast<Scalar>(-1.));
+			// written back once, like in scanLowpassKernel
+			auto y1 = z1, y2 = z2;
+			auto low = lpY1 != nullptr ? *lpY1 : static_cast<Scalar>(0.);
+			Scalar outputs[Size];
+			auto s = 0;
+			for (; s + Size <= numSamples; s += Size)
+			{
+				const auto in = samples + s;
+				const auto state1 = Vec::broadcast(y1);
+				const auto state2 = Vec::broadcast(y2);
+				const auto y = sumThrough<Vec>(r.impulse + OnsetMaxLanes, in)
+					+ fromZ1 * state1 + fromZ2 * state2;
+				if (simd::any(simd::maskOr(simd::lessThan(one, y), simd::lessThan(y, minusOne))))
+					break;
+				y.store(outputs);
+				y2 = Size > 1 ? outputs[Size > 1 ? Size - 2 : 0] : y1;
+				y1 = outputs[Size - 1];
+				if (lpY1 == nullptr)
+				{
+					y.storeFloats(in);
+					continue;
+				}
+				const auto l = sumThrough<Vec>(r.lowImpulse + OnsetMaxLanes, in)
+					+ lowFromZ1 * state1 + lowFromZ2 * state2 + lowFromY1 * Vec::broadcast(low);
+				(y - l).storeFloats(in);
+				low = simd::last(l);
+			}
+			z1 = y1;
+			z2 = y2;
+			if (lpY1 != nullptr)
+				*lpY1 = low;
+			return s;
+		}
+
+		// isa
+		template<class VecD, class VecF>
+		OnsetKernels makeOnsetKernels(OnsetISA isa) noexcept
+		{
+			return
+			{
+				isa,
+				VecD::Size,
+				VecF::Size,
+				&copyFromMidKernel<VecF>,
+				&rectifyKernel<VecF>,
+				&getMaxMagKernel<VecF>,
+				&processBankKernel<VecD, false>,
+				&processBankKernel<VecF, false>,
+				&processBankKernel<VecD, true>,
+				&processBankKernel<VecF, true>,
+				&combineKernel<VecF>,
+				&combineSquaredKernel<VecF>,
+				&scanLowpassKernel<VecD>,
+				&scanLowpassKernel<VecF>,
+				&scanResonatorKernel<VecD>,
+				&scanResonatorKernel<VecF>,
+				&processStreamsKernel<VecD>,
+				&processStreamsKernel<VecF>
+			};
+		}
+	}
+}
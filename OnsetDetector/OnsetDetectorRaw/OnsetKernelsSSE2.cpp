@@ -0,0 +1,16 @@
+#include "OnsetKernelsImpl.h"
+
+// SSE2 is the baseline of x64, nothing to enable there.
+
+namespace dsp
+{
+	const OnsetKernels* getOnsetKernelsSSE2() noexcept
+	{
+#if OnsetHasSSE2
+		static const OnsetKernels kernels = makeOnsetKernels<simd::VecD2, simd::VecF4>(OnsetISA::SSE2);
+		return &kernels;
+#else
+		return nullptr;
+#endif
+	}
+}
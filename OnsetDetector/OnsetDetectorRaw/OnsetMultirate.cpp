@@ -0,0 +1,317 @@
+#include "OnsetMultirate.h"
+#include <algorithm>
+
+namespace dsp
+{
+	namespace
+	{
+		// full rate samples from an input sample to the middle of the held
+		// level sample it ends up in
+		// level
+		int getLevelDelay(int level) noexcept
+		{
+			return 7 * ((1 << level) - 1) + ((1 << level) >> 1);
+		}
+
+		static_assert(OnsetMultirateT<32>::DelaySize > 7 * ((1 << (OnsetMultirateLevelsMax - 1)) - 1)
+			+ (1 << (OnsetMultirateLevelsMax - 2)), "level 0's line holds the deepest level's delay");
+	}
+
+	int getMultirateLevel(double freqHz, double sampleRate) noexcept
+	{
+		auto level = 0;
+		// a quarter of the next level's rate
+		auto nextQuarterRate = sampleRate * .125;
+		while (level + 1 < OnsetMultirateLevelsMax && freqHz <= nextQuarterRate)
+		{
+			++level;
+			nextQuarterRate *= .5;
+		}
+		return level;
+	}
+
+	// OnsetHalfBand
+
+	OnsetHalfBand::OnsetHalfBand() :
+		z(),
+		phase(false)
+	{
+	}
+
+	void OnsetHalfBand::reset() noexcept
+	{
+		z.fill(0.f);
+		phase = false;
+	}
+
+	bool OnsetHalfBand::operator()(float x, float& y) noexcept
+	{
+		// blackman windowed sinc, every other tap is 0
+		static constexpr float H0 = .4998364813f;
+		static constexpr float H1 = .2986387749f;
+		static constexpr float H3 = -.0588440114f;
+		static constexpr float H5 = .0109519903f;
+		static constexpr float H7 = -.0006649945f;
+
+		for (auto i = 14; i > 0; --i)
+			z[i] = z[i - 1];
+		z[0] = x;
+		phase = !phase;
+		if (phase)
+			return false;
+		y = H0 * z[7]
+			+ H1 * (z[6] + z[8])
+			+ H3 * (z[4] + z[10])
+			+ H5 * (z[2] + z[12])
+			+ H7 * (z[0] + z[14]);
+		return true;
+	}
+
+	void OnsetHalfBand::saveState(OnsetStateWriter& w) const noexcept
+	{
+		w(z);
+		w(phase);
+	}
+
+	void OnsetHalfBand::restoreState(OnsetStateReader& r) noexcept
+	{
+		r(z);
+		r(phase);
+	}
+
+	// OnsetMultirateT
+
+	template<int Size>
+	OnsetMultirateT<Size>::OnsetMultirateT() :
+		halfBands(),
+		inputs(),
+		odfs(),
+		positions(),
+		numSamples(),
+		held(),
+		delayLines(),
+		delays(),
+		writes(),
+		numLevels(1),
+		latency(0),
+		numQuiet(0)
+	{
+	}
+
+	template<int Size>
+	void OnsetMultirateT<Size>::allocate()
+	{
+		// DelaySize + DelaySize / 2 + .. + DelaySize >> (OnsetMultirateLevelsMax - 1)
+		if (delayLines.empty())
+			delayLines.assign(2 * DelaySize, 0.f);
+	}
+
+	template<int Size>
+	void OnsetMultirateT<Size>::reset() noexcept
+	{
+		for (auto& h : halfBands)
+			h.reset();
+		numSamples.fill(0);
+		held.fill(0.f);
+		updateDelays();
+	}
+
+	template<int Size>
+	void OnsetMultirateT<Size>::decimate(const float* input, int n, int _numLevels, bool silent) noexcept
+	{
+		if (numLevels != _numLevels)
+		{
+			for (auto k = numLevels; k < _numLevels; ++k)
+			{
+				halfBands[k].reset();
+				held[k] = 0.f;
+			}
+			numLevels = _numLevels;
+			updateDelays();
+		}
+		numQuiet = silent ? std::min(numQuiet + n, DelaySize) : 0;
+
+		auto in = input;
+		auto inN = n;
+		for (auto k = 1; k < numLevels; ++k)
+		{
+			auto& halfBand = halfBands[k];
+			auto out = inputs[k].getSamples();
+			auto& pos = positions[k];
+			auto m = 0;
+			for (auto j = 0; j < inN; ++j)
+				if (halfBand(in[j], out[m]))
+				{
+					pos[m] = k == 1 ? j : positions[k - 1][j];
+					++m;
+				}
+			numSamples[k] = m;
+			odfs[k].clear(m);
+			in = out;
+			inN = m;
+		}
+		// the half-bands above need the levels undelayed
+		std::copy(input, input + n, inputs[0].getSamples());
+		numSamples[0] = n;
+		for (auto k = 0; k < numLevels; ++k)
+			delay(k, inputs[k].getSamples(), numSamples[k]);
+	}
+
+	template<int Size>
+	int OnsetMultirateT<Size>::getLatency() const noexcept
+	{
+		return latency;
+	}
+
+	template<int Size>
+	bool OnsetMultirateT<Size>::isSettled() const noexcept
+	{
+		return numQuiet >= latency;
+	}
+
+	template<int Size>
+	const float* OnsetMultirateT<Size>::getInput(int level) const noexcept
+	{
+		return &inputs[level][0];
+	}
+
+	template<int Size>
+	float* OnsetMultirateT<Size>::getODF(int level) noexcept
+	{
+		return odfs[level].getSamples();
+	}
+
+	template<int Size>
+	int OnsetMultirateT<Size>::getNumSamples(int level) const noexcept
+	{
+		return numSamples[level];
+	}
+
+	template<int Size>
+	void OnsetMultirateT<Size>::expand(float* odf, int n) noexcept
+	{
+		for (auto k = 1; k < numLevels; ++k)
+		{
+			const auto& pos = positions[k];
+			const auto& levelODF = odfs[k];
+			const auto m = numSamples[k];
+			auto h = held[k];
+			auto j = 0;
+			for (auto s = 0; s < n; ++s)
+			{
+				if (j < m && pos[j] == s)
+				{
+					h = levelODF[j];
+					++j;
+				}
+				odf[s] += h;
+			}
+			held[k] = h;
+		}
+	}
+
+	template<int Size>
+	void OnsetMultirateT<Size>::hold(int level, const float* x, float* y, int n, float& last) const noexcept
+	{
+		const auto& pos = positions[level];
+		const auto m = numSamples[level];
+		auto h = last;
+		auto j = 0;
+		for (auto s = 0; s < n; ++s)
+		{
+			if (j < m && pos[j] == s)
+			{
+				h = x[j];
+				++j;
+			}
+			y[s] = h;
+		}
+		last = h;
+	}
+
+	template<int Size>
+	void OnsetMultirateT<Size>::saveState(OnsetStateWriter& w) const noexcept
+	{
+		for (const auto& h : halfBands)
+			h.saveState(w);
+		w(held);
+		w(numLevels);
+		w(numQuiet);
+		// what every line still has to give, oldest first
+		for (auto k = 0; k < numLevels; ++k)
+		{
+			const auto line = delayLines.data() + getLineStart(k);
+			const auto mask = (DelaySize >> k) - 1;
+			for (auto j = writes[k] - delays[k]; j < writes[k]; ++j)
+				w(line[j & mask]);
+		}
+	}
+
+	template<int Size>
+	bool OnsetMultirateT<Size>::restoreState(OnsetStateReader& r)
+	{
+		for (auto& h : halfBands)
+			h.restoreState(r);
+		r(held);
+		auto levels = 0, quiet = 0;
+		r(levels);
+		r(quiet);
+		if (!r.isValid() || levels < 1 || levels > OnsetMultirateLevelsMax || quiet < 0)
+			return false;
+		allocate();
+		numLevels = levels;
+		updateDelays();
+		numQuiet = quiet;
+		for (auto k = 0; k < numLevels; ++k)
+		{
+			const auto line = delayLines.data() + getLineStart(k);
+			for (auto j = 0; j < delays[k]; ++j)
+				r(line[j]);
+			writes[k] = delays[k] & ((DelaySize >> k) - 1);
+		}
+		return r.isValid();
+	}
+
+	template<int Size>
+	int OnsetMultirateT<Size>::getLineStart(int level) noexcept
+	{
+		return 2 * DelaySize - (2 * DelaySize >> level);
+	}
+
+	template<int Size>
+	void OnsetMultirateT<Size>::updateDelays() noexcept
+	{
+		latency = getLevelDelay(numLevels - 1);
+		numQuiet = DelaySize;
+		delays.fill(0);
+		writes.fill(0);
+		delays[0] = latency;
+		// rounded to the nearest level sample
+		for (auto k = 1; k < numLevels; ++k)
+			delays[k] = (latency - getLevelDelay(k) + ((1 << k) >> 1)) >> k;
+		std::fill(delayLines.begin(), delayLines.end(), 0.f);
+	}
+
+	template<int Size>
+	void OnsetMultirateT<Size>::delay(int level, float* x, int n) noexcept
+	{
+		const auto d = delays[level];
+		if (d == 0)
+			return;
+		const auto line = delayLines.data() + getLineStart(level);
+		const auto mask = (DelaySize >> level) - 1;
+		auto w = writes[level];
+		for (auto j = 0; j < n; ++j)
+		{
+			line[w] = x[j];
+			x[j] = line[(w - d) & mask];
+			w = (w + 1) & mask;
+		}
+		writes[level] = w;
+	}
+
+	template struct OnsetMultirateT<32>;
+	template struct OnsetMultirateT<64>;
+	template struct OnsetMultirateT<128>;
+	template struct OnsetMultirateT<256>;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include "OnsetBuffer.h"
+#include "OnsetState.h"
+#include <vector>
+
+namespace dsp
+{
+	// number of octave levels, level k runs at sampleRate / 2^k
+	static constexpr int OnsetMultirateLevelsMax = 8;
+
+	// the lowest level whose rate keeps freqHz within the flat passband
+	// of all half-bands above it.
+	// freqHz, sampleRate
+	int getMultirateLevel(double, double) noexcept;
+
+	// 15 tap half-band lowpass that halves the sample rate. It is flat
+	// (-0.1db) up to a quarter of its output rate, rejects what would
+	// alias onto that range by 40db and delays by 7 input samples.
+	struct OnsetHalfBand
+	{
+		OnsetHalfBand();
+
+		void reset() noexcept;
+
+		// pushes x and returns if it completed an output sample y.
+		// x, y
+		bool operator()(float, float&) noexcept;
+
+		// writer
+		void saveState(OnsetStateWriter&) const noexcept;
+
+		// reader
+		void restoreState(OnsetStateReader&) noexcept;
+	private:
+		std::array<float, 15> z;
+		bool phase;
+	};
+
+	// Octave decimation tree of the (rectified) input. Bands with a low
+	// centre frequency run at the lowest level that keeps their passband,
+	// and their detection function is held until the level's next sample
+	// to bring it back to the full rate.
+	// Every half-band delays by 7 of its input samples, so level k lags
+	// 7 * (2^k - 1) full rate samples, and holding adds half a level
+	// sample. Each level's input goes through a delay line that makes up
+	// the difference to the deepest level, so that all of them line up
+	// and the odf lags the input by the deepest level's delay (getLatency).
+	template<int Size>
+	struct OnsetMultirateT
+	{
+		// full rate samples of level 0's delay line, level k's is
+		// DelaySize >> k long and longer than the deepest level's delay
+		static constexpr int DelaySize = 1024;
+
+		OnsetMultirateT();
+
+		// the delay lines once, off the audio thread. decimate needs them.
+		void allocate();
+
+		void reset() noexcept;
+
+		// fills the levels 0 .. numLevels-1 with the delayed input and
+		// clears the odfs of the levels >0. a level that joins starts from
+		// silence, and the delay lines start over when numLevels changes.
+		// input (full rate), numSamples, numLevels, silent (below the sleep floor)
+		void decimate(const float*, int, int, bool) noexcept;
+
+		// full rate samples the levels lag the input
+		int getLatency() const noexcept;
+
+		// if the delay lines hold nothing but silence
+		bool isSettled() const noexcept;
+
+		// level
+		const float* getInput(int) const noexcept;
+
+		// level (>0)
+		float* getODF(int) noexcept;
+
+		// level
+		int getNumSamples(int) const noexcept;
+
+		// adds the held odf of all levels >0 to the full rate odf.
+		// odf, numSamples
+		void expand(float*, int) noexcept;
+
+		// brings a level's samples to the full rate like expand, but
+		// writes them to y. last is the x held before the block and
+		// becomes the one held after it.
+		// level (>0), x, y, numSamples, last
+		void hold(int, const float*, float*, int, float&) const noexcept;
+
+		// the half-bands and held odfs, what outlasts a block
+		// writer
+		void saveState(OnsetStateWriter&) const noexcept;
+
+		// allocates, returns false if the state is broken
+		// reader
+		bool restoreState(OnsetStateReader&);
+	private:
+		using Positions = std::array<int, Size>;
+
+		std::array<OnsetHalfBand, OnsetMultirateLevelsMax> halfBands;
+		std::array<OnsetBufferT<Size>, OnsetMultirateLevelsMax> inputs, odfs;
+		// full rate index of every level's samples in the block
+		std::array<Positions, OnsetMultirateLevelsMax> positions;
+		std::array<int, OnsetMultirateLevelsMax> numSamples;
+		std::array<float, OnsetMultirateLevelsMax> held;
+		// every level's line one after the other, empty until allocate()
+		std::vector<float> delayLines;
+		// in level samples
+		std::array<int, OnsetMultirateLevelsMax> delays, writes;
+		// numQuiet: full rate samples since the input was last above the floor
+		int numLevels, latency, numQuiet;
+
+		// where a level's line starts in delayLines
+		// level
+		static int getLineStart(int) noexcept;
+
+		// sets the delays for numLevels and clears the lines
+		void updateDelays() noexcept;
+
+		// level, x (in place), numSamples
+		void delay(int, float*, int) noexcept;
+	};
+}
@@ -0,0 +1,33 @@
+#include "OnsetOdf.h"
+
+namespace dsp
+{
+	OnsetOdfView::OnsetOdfView() noexcept :
+		combined(nullptr),
+		bands(nullptr),
+		stride(0)
+	{
+	}
+
+	OnsetOdfView::OnsetOdfView(float* _combined, float* _bands, int _stride) noexcept :
+		combined(_combined),
+		bands(_bands),
+		stride(_stride)
+	{
+	}
+
+	OnsetOdfView OnsetOdfView::from(int s) const noexcept
+	{
+		return
+		{
+			combined != nullptr ? combined + s : nullptr,
+			bands != nullptr ? bands + s : nullptr,
+			stride
+		};
+	}
+
+	float* OnsetOdfView::getBand(int band) const noexcept
+	{
+		return bands != nullptr ? bands + band * stride : nullptr;
+	}
+}
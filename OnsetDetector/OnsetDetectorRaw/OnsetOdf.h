@@ -0,0 +1,35 @@
+#pragma once
+
+namespace dsp
+{
+	// A view on caller-owned, preallocated buffers for the onset detection
+	// function. The detector fills them in the same pass as the onsets,
+	// sample by sample from the start of the call. Buffers that are
+	// nullptr cost nothing.
+	struct OnsetOdfView
+	{
+		// writes nothing
+		OnsetOdfView() noexcept;
+
+		// combined: numSamples of the odf the trigger compares with the
+		// threshold (its root, also with OnsetMath::Fast).
+		// bands: numBands rows of stride samples (structure of arrays),
+		// the ratio every band adds to the odf before the combine. a band
+		// at a decimated rate holds its ratio like the odf does, a sleeping
+		// band reads 0.
+		// combined (can be nullptr), bands (can be nullptr), stride (>= numSamples)
+		OnsetOdfView(float*, float*, int) noexcept;
+
+		// the same buffers from sample s on
+		// s
+		OnsetOdfView from(int) const noexcept;
+
+		// band's row or nullptr
+		// band
+		float* getBand(int) const noexcept;
+
+		float* combined;
+		float* bands;
+		int stride;
+	};
+}
@@ -0,0 +1,335 @@
+#include "OnsetParallelAnalyzer.h"
+#include <algorithm>
+#include <thread>
+
+namespace dsp
+{
+	namespace
+	{
+		// frames per detector call
+		static constexpr int ChunkSize = 1 << 16;
+
+		// samples until a one-pole state with coefficient x has fallen to
+		// OnsetWarmUpTolerance of where it started
+		double getConvergenceLength(double x) noexcept
+		{
+			if (x <= 0. || x >= 1.)
+				return 0.;
+			return std::log(OnsetWarmUpTolerance) / std::log(x);
+		}
+	}
+
+	template<int BlockSize>
+	OnsetParallelAnalyzerT<BlockSize>::OnsetParallelAnalyzerT() :
+		bands(),
+		sampleRate(1.),
+		attack(std::pow(2., static_cast<double>(OnsetAtkDefault))),
+		decay(std::pow(2., static_cast<double>(OnsetDcyDefault))),
+		holdLength(OnsetHoldDefault),
+		bandwidth(std::pow(2., static_cast<double>(OnsetBandwidthDefault))),
+		lowestPitch(freqHzToNote(OnsetLowestFreqHz)),
+		highestPitch(freqHzToNote(OnsetHighestFreqHz)),
+		peakWindow(OnsetPeakWindowDefault),
+		peakLookBack(OnsetPeakLookBackDefault),
+		tilt(OnsetTiltDefault),
+		threshold(OnsetThresholdDefault),
+		peakSpread(OnsetPeakSpreadDefault),
+		warmUpLength(0),
+		period(1),
+		numBands(static_cast<int>(OnsetNumBandsDefault)),
+		numThreads(0),
+		engine(OnsetEngine::Cores),
+		precision(OnsetPrecision::Mixed),
+		math(OnsetMath::Exact),
+		thresholdMode(OnsetThresholdMode::Fixed),
+		maxISA(OnsetISA::AVX512)
+	{
+	}
+
+	// parameters:
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setAttack(double x) noexcept
+	{
+		attack = x;
+		bands.setAttack(x);
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setDecay(double x) noexcept
+	{
+		decay = x;
+		bands.setDecay(x);
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setTilt(float db) noexcept
+	{
+		tilt = db;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setThreshold(float db) noexcept
+	{
+		threshold = db;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setHoldLength(double ms) noexcept
+	{
+		holdLength = ms;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setThresholdMode(OnsetThresholdMode mode) noexcept
+	{
+		thresholdMode = mode;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setPeakWindow(double ms) noexcept
+	{
+		peakWindow = ms;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setPeakSpread(float k) noexcept
+	{
+		peakSpread = k;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setPeakLookBack(double ms) noexcept
+	{
+		peakLookBack = ms;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setBandwidth(double b) noexcept
+	{
+		bandwidth = b;
+		bands.setBandwidth(b);
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setNumBands(int n) noexcept
+	{
+		numBands = n;
+		bands.setNumBands(n);
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setLowestPitch(double p) noexcept
+	{
+		lowestPitch = p;
+		bands.setLowestPitch(p);
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setHighestPitch(double p) noexcept
+	{
+		highestPitch = p;
+		bands.setHighestPitch(p);
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setEngine(OnsetEngine e) noexcept
+	{
+		engine = e;
+		bands.setMultirate(engine == OnsetEngine::Multirate);
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setPrecision(OnsetPrecision p) noexcept
+	{
+		precision = p;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setMath(OnsetMath m) noexcept
+	{
+		math = m;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setMaxISA(OnsetISA isa) noexcept
+	{
+		maxISA = isa;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::setNumThreads(int n) noexcept
+	{
+		numThreads = n;
+	}
+
+	// process:
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::prepare(double _sampleRate) noexcept
+	{
+		sampleRate = _sampleRate;
+		bands.prepare(sampleRate);
+
+		// the slowest state of any band decides. low bands of the multirate
+		// engine count their samples at their level's rate.
+		auto length = 0.;
+		for (auto i = 0; i < numBands; ++i)
+		{
+			const auto& core = bands[i];
+			const auto& reso = core.getResonator();
+			const double xs[] =
+			{
+				std::sqrt(reso.b2), // pole radius
+				reso.getLowpass().b1,
+				core.getEnvelopeFollower(0).getParams().atk,
+				core.getEnvelopeFollower(0).getParams().dcy,
+				core.getEnvelopeFollower(1).getParams().atk,
+				core.getEnvelopeFollower(1).getParams().dcy
+			};
+			const auto levelRatio = static_cast<double>(1 << bands.getLevel(i));
+			for (const auto x : xs)
+			{
+				const auto l = getConvergenceLength(x) * levelRatio;
+				if (length < l)
+					length = l;
+			}
+		}
+		// plus one hold, so the trigger knows about onsets right before the segment
+		length += holdLength * .001 * sampleRate;
+		// a warm-up must start where the slowest level takes its samples, or
+		// its decimators see other samples than a detector from the start.
+		period = int64_t(1) << (bands.getNumLevels() - 1);
+		if (thresholdMode == OnsetThresholdMode::Adaptive)
+		{
+			// plus a whole window, which the peak picker fills every stride
+			// samples. both periods are powers of 2.
+			OnsetPeakPicker picker;
+			picker.setWindow(peakWindow);
+			picker.prepare(sampleRate);
+			length += peakWindow * .001 * sampleRate;
+			period = std::max(period, static_cast<int64_t>(picker.getStride()));
+		}
+		warmUpLength = static_cast<int64_t>(std::ceil(length));
+	}
+
+	template<int BlockSize>
+	int64_t OnsetParallelAnalyzerT<BlockSize>::getWarmUpLength() const noexcept
+	{
+		return warmUpLength;
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::operator()(float** samples, int numChannels,
+		int64_t numSamples, std::vector<OnsetEvent>& events)
+	{
+		auto maxSegments = numThreads;
+		if (maxSegments < 1)
+			maxSegments = static_cast<int>(std::thread::hardware_concurrency());
+		if (maxSegments < 1)
+			maxSegments = 1;
+		// segments shorter than the warm-up would spend most of their time warming up
+		const auto minSegmentLength = warmUpLength > 0 ? warmUpLength : int64_t(1);
+		auto numSegments = static_cast<int>(numSamples / minSegmentLength);
+		if (numSegments > maxSegments)
+			numSegments = maxSegments;
+		if (numSegments < 1)
+			numSegments = 1;
+
+		std::vector<std::vector<OnsetEvent>> segmentEvents(numSegments);
+		std::vector<std::thread> threads;
+		threads.reserve(numSegments - 1);
+		const auto getStart = [numSamples, numSegments](int i)
+		{
+			return numSamples * i / numSegments;
+		};
+		for (auto i = 1; i < numSegments; ++i)
+			threads.emplace_back([this, samples, numChannels, &segmentEvents, getStart, i]()
+			{
+				analyzeSegment(samples, numChannels, getStart(i), getStart(i + 1), segmentEvents[i]);
+			});
+		analyzeSegment(samples, numChannels, 0, getStart(1), segmentEvents[0]);
+		for (auto& t : threads)
+			t.join();
+
+		// a detector that ran from the start never reports two onsets within
+		// one hold, so any such pair straddles a boundary and is one onset.
+		const auto holdSamples = static_cast<int64_t>(holdLength * .001 * sampleRate);
+		const auto numBefore = events.size();
+		for (const auto& segment : segmentEvents)
+			for (const auto& e : segment)
+			{
+				if (events.size() > numBefore && e.position - events.back().position < holdSamples)
+					continue;
+				events.push_back(e);
+			}
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::configure(Detector& detector) const
+	{
+		detector.setAttack(attack);
+		detector.setDecay(decay);
+		detector.setTilt(tilt);
+		detector.setThreshold(threshold);
+		detector.setHoldLength(holdLength);
+		detector.setThresholdMode(thresholdMode);
+		detector.setPeakWindow(peakWindow);
+		detector.setPeakSpread(peakSpread);
+		detector.setPeakLookBack(peakLookBack);
+		detector.setBandwidth(bandwidth);
+		detector.setNumBands(numBands);
+		detector.setLowestPitch(lowestPitch);
+		detector.setHighestPitch(highestPitch);
+		detector.setEngine(engine);
+		detector.setPrecision(precision);
+		detector.setMath(math);
+		detector.setMaxISA(maxISA);
+		detector.prepare(sampleRate);
+	}
+
+	template<int BlockSize>
+	void OnsetParallelAnalyzerT<BlockSize>::analyzeSegment(float** samples, int numChannels,
+		int64_t start, int64_t end, std::vector<OnsetEvent>& segmentEvents) const
+	{
+		Detector detector;
+		configure(detector);
+
+		auto warmUpStart = start > warmUpLength ? start - warmUpLength : int64_t(0);
+		warmUpStart -= warmUpStart % period;
+		std::vector<float*> chunk(numChannels);
+		const auto getChunk = [&](int64_t s, int64_t chunkEnd)
+		{
+			for (auto ch = 0; ch < numChannels; ++ch)
+				chunk[ch] = samples[ch] + s;
+			return static_cast<int>(chunkEnd - s < ChunkSize ? chunkEnd - s : ChunkSize);
+		};
+
+		// the warm-up's onsets belong to the segment before
+		for (auto s = warmUpStart; s < start; s += ChunkSize)
+		{
+			const auto numChunkSamples = getChunk(s, start);
+			detector(chunk.data(), numChannels, numChunkSamples);
+		}
+
+		std::vector<OnsetEvent> eventData(ChunkSize);
+		OnsetEvents chunkEvents(eventData.data(), ChunkSize);
+		for (auto s = start; s < end; s += ChunkSize)
+		{
+			const auto numChunkSamples = getChunk(s, end);
+			chunkEvents.clear();
+			detector(chunk.data(), numChannels, numChunkSamples, chunkEvents);
+			for (auto e : chunkEvents)
+			{
+				// the detector counts from the warm-up's start
+				e.position += warmUpStart;
+				segmentEvents.push_back(e);
+			}
+		}
+	}
+
+	template struct OnsetParallelAnalyzerT<32>;
+	template struct OnsetParallelAnalyzerT<64>;
+	template struct OnsetParallelAnalyzerT<128>;
+	template struct OnsetParallelAnalyzerT<256>;
+}
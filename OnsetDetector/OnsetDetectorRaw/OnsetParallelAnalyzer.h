@@ -0,0 +1,99 @@
+#pragma once
+#include "OnsetDetector.h"
+#include <vector>
+
+namespace dsp
+{
+	// how far from its final value a state may be when the warm-up ends
+	static constexpr double OnsetWarmUpTolerance = 1e-4;
+
+	// Analyses a whole recording on several threads. The recording is cut
+	// into one segment per thread and every segment gets its own detector.
+	// Each detector first runs over the audio before its segment (the
+	// warm-up), until its resonators and envelopes forgot their start
+	// values and only reflect the signal, like the ones of a detector that
+	// ran from the start. Onsets in the warm-up are dropped, so every onset
+	// is reported by exactly one segment.
+	// The results equal a single detector's, apart from onsets whose
+	// detection function is within OnsetWarmUpTolerance of the threshold
+	// right after a segment boundary.
+	template<int BlockSize>
+	struct OnsetParallelAnalyzerT
+	{
+		using Detector = OnsetDetectorT<BlockSize>;
+
+		OnsetParallelAnalyzerT();
+
+		// parameters (see OnsetDetectorT):
+
+		void setAttack(double) noexcept;
+
+		void setDecay(double) noexcept;
+
+		void setTilt(float) noexcept;
+
+		void setThreshold(float) noexcept;
+
+		void setHoldLength(double) noexcept;
+
+		void setThresholdMode(OnsetThresholdMode) noexcept;
+
+		void setPeakWindow(double) noexcept;
+
+		void setPeakSpread(float) noexcept;
+
+		void setPeakLookBack(double) noexcept;
+
+		void setBandwidth(double) noexcept;
+
+		void setNumBands(int) noexcept;
+
+		void setLowestPitch(double) noexcept;
+
+		void setHighestPitch(double) noexcept;
+
+		void setEngine(OnsetEngine) noexcept;
+
+		void setPrecision(OnsetPrecision) noexcept;
+
+		void setMath(OnsetMath) noexcept;
+
+		void setMaxISA(OnsetISA) noexcept;
+
+		// 0 uses every hardware thread
+		// numThreads
+		void setNumThreads(int) noexcept;
+
+		// process:
+
+		// sampleRate
+		void prepare(double) noexcept;
+
+		// samples every segment's detector runs before its segment
+		int64_t getWarmUpLength() const noexcept;
+
+		// appends the onsets of the whole recording to events, sorted.
+		// samples, numChannels, numSamples, events
+		void operator()(float**, int, int64_t, std::vector<OnsetEvent>&);
+	private:
+		OnsetBands bands;
+		double sampleRate, attack, decay, holdLength, bandwidth, lowestPitch, highestPitch;
+		double peakWindow, peakLookBack;
+		float tilt, threshold, peakSpread;
+		int64_t warmUpLength, period;
+		int numBands, numThreads;
+		OnsetEngine engine;
+		OnsetPrecision precision;
+		OnsetMath math;
+		OnsetThresholdMode thresholdMode;
+		OnsetISA maxISA;
+
+		// detector
+		void configure(Detector&) const;
+
+		// samples, numChannels, start, end, events (of the segment)
+		void analyzeSegment(float**, int, int64_t, int64_t, std::vector<OnsetEvent>&) const;
+	};
+
+	using OnsetParallelAnalyzer = OnsetParallelAnalyzerT<BlockSize>;
+}
@@ -0,0 +1,330 @@
+#include "OnsetPeakPicker.h"
+#include "OnsetAxiom.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace dsp
+{
+	namespace
+	{
+		static_assert((OnsetPeakPicker::HistorySize & (OnsetPeakPicker::HistorySize - 1)) == 0,
+			"the window wraps with a mask");
+		static_assert((OnsetPeakPicker::LookBackMax & (OnsetPeakPicker::LookBackMax - 1)) == 0,
+			"the deque wraps with a mask");
+
+		int msToSamples(double ms, double sampleRate) noexcept
+		{
+			return static_cast<int>(ms * .001 * sampleRate);
+		}
+	}
+
+	OnsetPeakPicker::OnsetPeakPicker() :
+		histogram(),
+		history(),
+		maxima(),
+		sampleRate(1.),
+		windowMs(OnsetPeakWindowDefault),
+		lookBackMs(OnsetPeakLookBackDefault),
+		holdMs(OnsetHoldDefault),
+		clock(0),
+		minThreshold(std::pow(10.f, OnsetThresholdDefault / 20.f)),
+		spread(OnsetPeakSpreadDefault),
+		threshold(minThreshold),
+		lastVal(0.f),
+		windowSize(1), stride(1), phase(1), first(0), count(0),
+		median(0), below(0),
+		firstMaximum(0), numMaxima(0), lookBack(0),
+		holdTimer(0), holdLength(0),
+		squared(false)
+	{
+	}
+
+	void OnsetPeakPicker::allocate()
+	{
+		if (!histogram.empty())
+			return;
+		histogram.assign(NumBins, 0);
+		history.assign(HistorySize, 0);
+		maxima.assign(LookBackMax, Maximum());
+	}
+
+	void OnsetPeakPicker::prepare(double _sampleRate) noexcept
+	{
+		sampleRate = _sampleRate;
+		setWindow(windowMs);
+		setLookBack(lookBackMs);
+		setHoldLength(holdMs);
+		reset();
+	}
+
+	void OnsetPeakPicker::reset() noexcept
+	{
+		clearWindow();
+		clock = 0;
+		lastVal = 0.f;
+		firstMaximum = numMaxima = 0;
+		holdTimer = 0;
+	}
+
+	void OnsetPeakPicker::setThreshold(float db) noexcept
+	{
+		minThreshold = std::pow(10.f, db / 20.f);
+		updateThreshold();
+	}
+
+	void OnsetPeakPicker::setHoldLength(double ms) noexcept
+	{
+		holdMs = ms;
+		holdLength = msToSamples(holdMs, sampleRate);
+		holdTimer = 0;
+	}
+
+	void OnsetPeakPicker::setMath(OnsetMath m) noexcept
+	{
+		const auto s = m == OnsetMath::Fast;
+		if (squared == s)
+			return;
+		squared = s;
+		// squaring keeps the order, the deque stays a deque
+		const auto convert = [s](float x) { return s ? x * x : std::sqrt(x); };
+		lastVal = convert(lastVal);
+		for (auto i = 0; i < numMaxima; ++i)
+		{
+			auto& maximum = maxima[(firstMaximum + i) & (LookBackMax - 1)];
+			maximum.val = convert(maximum.val);
+		}
+	}
+
+	void OnsetPeakPicker::setWindow(double ms) noexcept
+	{
+		windowMs = ms;
+		const auto numSamples = msToSamples(windowMs, sampleRate);
+		stride = 1;
+		while (numSamples > stride * HistorySize)
+			stride *= 2;
+		windowSize = (numSamples + stride - 1) / stride;
+		if (windowSize < 1)
+			windowSize = 1;
+		clearWindow();
+	}
+
+	void OnsetPeakPicker::setSpread(float k) noexcept
+	{
+		spread = k;
+		updateThreshold();
+	}
+
+	void OnsetPeakPicker::setLookBack(double ms) noexcept
+	{
+		lookBackMs = ms;
+		lookBack = msToSamples(lookBackMs, sampleRate);
+		// the deque also holds the sample after the look-back
+		if (lookBack > LookBackMax - 2)
+			lookBack = LookBackMax - 2;
+		if (lookBack < 0)
+			lookBack = 0;
+	}
+
+	int OnsetPeakPicker::getStride() const noexcept
+	{
+		return stride;
+	}
+
+	float OnsetPeakPicker::getThreshold() const noexcept
+	{
+		return threshold;
+	}
+
+	bool OnsetPeakPicker::operator()(float val, int64_t position, OnsetEvents* events) noexcept
+	{
+		// counted per sample like OnsetStrongHold's, but it stops at the hold
+		if (holdTimer < holdLength)
+			++holdTimer;
+		// the last sample is a peak if it tops the look-back and this sample
+		auto triggered = false;
+		while (numMaxima != 0 && maxima[firstMaximum].clock < clock - 1 - lookBack)
+		{
+			firstMaximum = (firstMaximum + 1) & (LookBackMax - 1);
+			--numMaxima;
+		}
+		if (numMaxima != 0 && maxima[firstMaximum].clock == clock - 1 && lastVal > val
+			&& lastVal > (squared ? threshold * threshold : threshold))
+		{
+			triggered = holdTimer >= holdLength;
+			if (triggered)
+			{
+				if (events != nullptr)
+					events->add({ position - 1, squared ? std::sqrt(lastVal) : lastVal, 0.f, 0, 0 });
+				holdTimer = 0;
+			}
+		}
+		// the deque's values fall from the front to the back
+		while (numMaxima != 0 && maxima[(firstMaximum + numMaxima - 1) & (LookBackMax - 1)].val <= val)
+			--numMaxima;
+		maxima[(firstMaximum + numMaxima) & (LookBackMax - 1)] = { clock, val };
+		++numMaxima;
+		++clock;
+
+		if (--phase == 0)
+		{
+			phase = stride;
+			push(getBin(squared ? std::sqrt(val) : val));
+			updateThreshold();
+		}
+		lastVal = val;
+		return triggered;
+	}
+
+	void OnsetPeakPicker::skip(int numSamples) noexcept
+	{
+		for (auto s = 0; s < numSamples; ++s)
+			operator()(0.f, 0, nullptr);
+	}
+
+	void OnsetPeakPicker::saveState(OnsetStateWriter& w) const noexcept
+	{
+		w(windowMs);
+		w(lookBackMs);
+		w(holdMs);
+		w(minThreshold);
+		w(spread);
+		w(clock);
+		w(lastVal);
+		w(phase);
+		w(holdTimer);
+		// the window from its oldest value, the deque from its front
+		w(count);
+		for (auto i = 0; i < count; ++i)
+			w(history[(first + i) & (HistorySize - 1)]);
+		w(numMaxima);
+		for (auto i = 0; i < numMaxima; ++i)
+		{
+			const auto& m = maxima[(firstMaximum + i) & (LookBackMax - 1)];
+			w(m.clock);
+			w(m.val);
+		}
+	}
+
+	bool OnsetPeakPicker::restoreState(OnsetStateReader& r)
+	{
+		allocate();
+		auto window = windowMs, look = lookBackMs, hold = holdMs;
+		r(window);
+		r(look);
+		r(hold);
+		r(minThreshold);
+		r(spread);
+		setWindow(window);
+		setLookBack(look);
+		setHoldLength(hold);
+		reset();
+		r(clock);
+		r(lastVal);
+		r(phase);
+		r(holdTimer);
+		auto n = 0;
+		r(n);
+		if (!r.isValid() || phase < 1 || phase > stride || n < 0 || n > windowSize)
+			return false;
+		for (auto i = 0; i < n; ++i)
+		{
+			auto bin = uint16_t(0);
+			r(bin);
+			if (bin >= NumBins)
+				return false;
+			push(bin);
+		}
+		r(n);
+		if (!r.isValid() || n < 0 || n > LookBackMax)
+			return false;
+		for (auto i = 0; i < n; ++i)
+		{
+			r(maxima[i].clock);
+			r(maxima[i].val);
+		}
+		numMaxima = n;
+		updateThreshold();
+		return r.isValid();
+	}
+
+	int OnsetPeakPicker::getBin(float x) noexcept
+	{
+		if (!(x > 0.f))
+			return 0;
+		// a piecewise linear log2
+		auto bits = uint32_t(0);
+		std::memcpy(&bits, &x, sizeof(x));
+		const auto bin = static_cast<int>(bits >> (23 - MantissaBits)) - ((127 + LowestOctave) << MantissaBits);
+		return bin < 0 ? 0 : bin < NumBins ? bin : NumBins - 1;
+	}
+
+	float OnsetPeakPicker::getValue(float bin) noexcept
+	{
+		const auto octave = std::floor(bin / static_cast<float>(BinsPerOctave));
+		const auto fraction = bin / static_cast<float>(BinsPerOctave) - octave;
+		return std::ldexp(1.f + fraction, static_cast<int>(octave) + LowestOctave);
+	}
+
+	void OnsetPeakPicker::push(int bin) noexcept
+	{
+		if (count == windowSize)
+		{
+			const auto oldest = history[first];
+			first = (first + 1) & (HistorySize - 1);
+			--count;
+			--histogram[oldest];
+			if (oldest < median)
+				--below;
+		}
+		history[(first + count) & (HistorySize - 1)] = static_cast<uint16_t>(bin);
+		++count;
+		++histogram[bin];
+		if (bin < median)
+			++below;
+		// the lower median, the value with (count - 1) / 2 values below it
+		const auto rank = (count - 1) / 2;
+		while (below > rank)
+		{
+			--median;
+			below -= histogram[median];
+		}
+		while (below + histogram[median] <= rank)
+		{
+			below += histogram[median];
+			++median;
+		}
+	}
+
+	void OnsetPeakPicker::updateThreshold() noexcept
+	{
+		threshold = minThreshold;
+		if (count == 0)
+			return;
+		// the fewest bins around the median that hold half the values
+		const auto rank = (count - 1) / 2;
+		auto numValues = histogram[median];
+		auto mad = 0;
+		while (numValues <= rank)
+		{
+			++mad;
+			if (median - mad >= 0)
+				numValues += histogram[median - mad];
+			if (median + mad < NumBins)
+				numValues += histogram[median + mad];
+		}
+		// the values in the median's bin are up to half a bin from it
+		const auto adaptive = getValue(static_cast<float>(median) + .5f + spread * (static_cast<float>(mad) + .5f));
+		if (threshold < adaptive)
+			threshold = adaptive;
+	}
+
+	void OnsetPeakPicker::clearWindow() noexcept
+	{
+		std::fill(histogram.begin(), histogram.end(), 0);
+		phase = stride;
+		first = count = 0;
+		median = below = 0;
+		threshold = minThreshold;
+	}
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "OnsetEvent.h"
+#include "OnsetKernels.h"
+#include "OnsetState.h"
+#include <vector>
+
+namespace dsp
+{
+	// Fixed: an onset where the odf crosses the threshold (OnsetTrigger)
+	// Adaptive: an onset at every peak of the odf above the threshold and
+	// above the recent odf's median plus spread (see OnsetPeakPicker)
+	enum class OnsetThresholdMode { Fixed, Adaptive };
+
+	static constexpr double OnsetPeakWindowDefault = 500.;
+	static constexpr float OnsetPeakSpreadDefault = 4.f;
+	static constexpr double OnsetPeakLookBackDefault = 20.;
+
+	// Picks the peaks of the odf with an adaptive threshold. The window
+	// holds the last windowMs of the odf as a histogram of 1/128 octaves
+	// (.05db), which keeps its median and the median absolute deviation
+	// (MAD) around it. The threshold is the median times spread MADs in
+	// db, but never below the fixed threshold. Long windows take every
+	// stride-th sample, so that the window never holds more than
+	// HistorySize values.
+	// A sample is a peak if it is higher than the next one and the highest
+	// since lookBackMs before it (a monotonic deque), so an onset comes
+	// one sample after its peak. Peaks closer than the hold are dropped.
+	// Every sample costs O(1), plus the bins the median moves. The MAD is
+	// searched once per stride, from the median outwards.
+	// The window and the deque (37kb) only exist after allocate(), so
+	// that a detector in the Fixed mode doesn't carry them.
+	struct OnsetPeakPicker
+	{
+		// the most values in the window
+		static constexpr int HistorySize = 4096;
+		// the longest look-back in samples
+		static constexpr int LookBackMax = 1024;
+		// a bin is a float's exponent and its mantissa's first bits
+		static constexpr int MantissaBits = 7;
+		static constexpr int BinsPerOctave = 1 << MantissaBits;
+		// the histogram covers 2^LowestOctave .. 2^(LowestOctave + NumOctaves)
+		static constexpr int LowestOctave = -20;
+		static constexpr int NumOctaves = 24;
+		static constexpr int NumBins = BinsPerOctave * NumOctaves;
+
+		OnsetPeakPicker();
+
+		// the window and the deque once, off the audio thread. operator(),
+		// skip and restoreState need them, the parameters don't.
+		void allocate();
+
+		// sampleRate, resets
+		void prepare(double) noexcept;
+
+		void reset() noexcept;
+
+		// the fixed threshold, the lowest a peak can be
+		// db
+		void setThreshold(float) noexcept;
+
+		// ms
+		void setHoldLength(double) noexcept;
+
+		// Fast: every val is the squared odf (see OnsetMath), the event
+		// still gets the odf (default: Exact)
+		void setMath(OnsetMath) noexcept;
+
+		// resets the window
+		// ms
+		void setWindow(double) noexcept;
+
+		// MADs above the median
+		// spread
+		void setSpread(float) noexcept;
+
+		// ms
+		void setLookBack(double) noexcept;
+
+		// samples between two values of the window, a power of 2
+		int getStride() const noexcept;
+
+		// the threshold the next peak has to top
+		float getThreshold() const noexcept;
+
+		// appends an event if the sample before val is a peak and returns if
+		// it did. the event's position is the peak's.
+		// val, position, events (can be nullptr)
+		bool operator()(float, int64_t, OnsetEvents*) noexcept;
+
+		// same as numSamples calls with a val of 0 without events
+		// numSamples
+		void skip(int) noexcept;
+
+		// writer
+		void saveState(OnsetStateWriter&) const noexcept;
+
+		// keeps the sampleRate, returns false if the state is broken.
+		// allocates like allocate().
+		// reader
+		bool restoreState(OnsetStateReader&);
+	private:
+		struct Maximum
+		{
+			int64_t clock;
+			float val;
+		};
+
+		std::vector<int> histogram;
+		std::vector<uint16_t> history;
+		std::vector<Maximum> maxima;
+		double sampleRate, windowMs, lookBackMs, holdMs;
+		int64_t clock;
+		// the fixed threshold, the adaptive one (both of the odf, not squared)
+		float minThreshold, spread, threshold, lastVal;
+		// window: values it can hold, samples between two, samples until
+		// the next, the oldest value, values in it
+		int windowSize, stride, phase, first, count;
+		// median bin, values below it
+		int median, below;
+		// the deque of maxima, lookBack in samples
+		int firstMaximum, numMaxima, lookBack;
+		int holdTimer, holdLength;
+		bool squared;
+
+		// x (the odf)
+		static int getBin(float) noexcept;
+
+		// the odf at a fractional bin
+		// bin
+		static float getValue(float) noexcept;
+
+		// bin
+		void push(int) noexcept;
+
+		void updateThreshold() noexcept;
+
+		void clearWindow() noexcept;
+	};
+}
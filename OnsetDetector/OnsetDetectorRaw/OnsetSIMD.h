@@ -0,0 +1,447 @@
+#pragma once
+#include <cmath>
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define OnsetHasAVX512 1
+#define OnsetHasAVX2 1
+#define OnsetHasAVX 1
+#define OnsetHasSSE2 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define OnsetHasAVX512 0
+#define OnsetHasAVX2 1
+#define OnsetHasAVX 1
+#define OnsetHasSSE2 1
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define OnsetHasAVX512 0
+#define OnsetHasAVX2 0
+#define OnsetHasAVX 1
+#define OnsetHasSSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OnsetHasAVX512 0
+#define OnsetHasAVX2 0
+#define OnsetHasAVX 0
+#define OnsetHasSSE2 1
+#else
+#define OnsetHasAVX512 0
+#define OnsetHasAVX2 0
+#define OnsetHasAVX 0
+#define OnsetHasSSE2 0
+#endif
+
+// translation units can be compiled for different instruction sets (see
+// OnsetKernels.h). the inline namespace gives every set its own symbols,
+// so the linker can't swap an AVX copy of a helper into the SSE2 code.
+#if OnsetHasAVX512
+#define OnsetSIMDNamespace avx512
+#elif OnsetHasAVX2
+#define OnsetSIMDNamespace avx2
+#elif OnsetHasAVX
+#define OnsetSIMDNamespace avx
+#elif OnsetHasSSE2
+#define OnsetSIMDNamespace sse2
+#else
+#define OnsetSIMDNamespace scalar
+#endif
+
+namespace dsp
+{
+	// thin wrappers around the native vector registers, so that the band
+	// kernels can be written once and instantiated for every lane width.
+	namespace simd
+	{
+	inline namespace OnsetSIMDNamespace
+	{
+		// 1 lane, used where no vector unit is available
+		struct VecD1
+		{
+			using Scalar = double;
+			static constexpr int Size = 1;
+
+			static VecD1 load(const double* x) noexcept { return { *x }; }
+			static VecD1 broadcast(double x) noexcept { return { x }; }
+			static VecD1 zero() noexcept { return { 0. }; }
+			static VecD1 loadFloats(const float* x) noexcept { return { static_cast<double>(*x) }; }
+			void store(double* x) const noexcept { *x = v; }
+			void storeFloats(float* x) const noexcept { *x = static_cast<float>(v); }
+
+			double v;
+		};
+
+		inline VecD1 operator+(VecD1 a, VecD1 b) noexcept { return { a.v + b.v }; }
+		inline VecD1 operator-(VecD1 a, VecD1 b) noexcept { return { a.v - b.v }; }
+		inline VecD1 operator*(VecD1 a, VecD1 b) noexcept { return { a.v * b.v }; }
+		inline VecD1 operator/(VecD1 a, VecD1 b) noexcept { return { a.v / b.v }; }
+		inline VecD1 min(VecD1 a, VecD1 b) noexcept { return { a.v < b.v ? a.v : b.v }; }
+		inline VecD1 max(VecD1 a, VecD1 b) noexcept { return { a.v > b.v ? a.v : b.v }; }
+		inline VecD1 abs(VecD1 a) noexcept { return { std::abs(a.v) }; }
+		inline VecD1 lessThan(VecD1 a, VecD1 b) noexcept { return { a.v < b.v ? 1. : 0. }; }
+		inline VecD1 equal(VecD1 a, VecD1 b) noexcept { return { a.v == b.v ? 1. : 0. }; }
+		inline VecD1 maskAnd(VecD1 a, VecD1 b) noexcept { return { a.v != 0. && b.v != 0. ? 1. : 0. }; }
+		inline VecD1 maskOr(VecD1 a, VecD1 b) noexcept { return { a.v != 0. || b.v != 0. ? 1. : 0. }; }
+		// mask, a (if true), b (if false)
+		inline VecD1 select(VecD1 m, VecD1 a, VecD1 b) noexcept { return m.v != 0. ? a : b; }
+		inline double sum(VecD1 a) noexcept { return a.v; }
+		inline bool any(VecD1 m) noexcept { return m.v != 0.; }
+		inline double last(VecD1 a) noexcept { return a.v; }
+
+#if OnsetHasSSE2
+		// 2 lanes
+		struct VecD2
+		{
+			using Scalar = double;
+			static constexpr int Size = 2;
+
+			static VecD2 load(const double* x) noexcept { return { _mm_loadu_pd(x) }; }
+			static VecD2 broadcast(double x) noexcept { return { _mm_set1_pd(x) }; }
+			static VecD2 zero() noexcept { return { _mm_setzero_pd() }; }
+			static VecD2 loadFloats(const float* x) noexcept
+			{
+				return { _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(x)))) };
+			}
+			void store(double* x) const noexcept { _mm_storeu_pd(x, v); }
+			void storeFloats(float* x) const noexcept
+			{
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(x), _mm_castps_si128(_mm_cvtpd_ps(v)));
+			}
+
+			__m128d v;
+		};
+
+		inline VecD2 operator+(VecD2 a, VecD2 b) noexcept { return { _mm_add_pd(a.v, b.v) }; }
+		inline VecD2 operator-(VecD2 a, VecD2 b) noexcept { return { _mm_sub_pd(a.v, b.v) }; }
+		inline VecD2 operator*(VecD2 a, VecD2 b) noexcept { return { _mm_mul_pd(a.v, b.v) }; }
+		inline VecD2 operator/(VecD2 a, VecD2 b) noexcept { return { _mm_div_pd(a.v, b.v) }; }
+		inline VecD2 min(VecD2 a, VecD2 b) noexcept { return { _mm_min_pd(a.v, b.v) }; }
+		inline VecD2 max(VecD2 a, VecD2 b) noexcept { return { _mm_max_pd(a.v, b.v) }; }
+		inline VecD2 abs(VecD2 a) noexcept { return { _mm_andnot_pd(_mm_set1_pd(-0.), a.v) }; }
+		inline VecD2 lessThan(VecD2 a, VecD2 b) noexcept { return { _mm_cmplt_pd(a.v, b.v) }; }
+		inline VecD2 equal(VecD2 a, VecD2 b) noexcept { return { _mm_cmpeq_pd(a.v, b.v) }; }
+		inline VecD2 maskAnd(VecD2 a, VecD2 b) noexcept { return { _mm_and_pd(a.v, b.v) }; }
+		inline VecD2 maskOr(VecD2 a, VecD2 b) noexcept { return { _mm_or_pd(a.v, b.v) }; }
+		inline VecD2 select(VecD2 m, VecD2 a, VecD2 b) noexcept
+		{
+			return { _mm_or_pd(_mm_and_pd(m.v, a.v), _mm_andnot_pd(m.v, b.v)) };
+		}
+		inline double sum(VecD2 a) noexcept
+		{
+			return _mm_cvtsd_f64(_mm_add_sd(a.v, _mm_unpackhi_pd(a.v, a.v)));
+		}
+		inline bool any(VecD2 m) noexcept { return _mm_movemask_pd(m.v) != 0; }
+		inline double last(VecD2 a) noexcept { return _mm_cvtsd_f64(_mm_unpackhi_pd(a.v, a.v)); }
+#endif
+
+#if OnsetHasAVX
+		// 4 lanes
+		struct VecD4
+		{
+			using Scalar = double;
+			static constexpr int Size = 4;
+
+			static VecD4 load(const double* x) noexcept { return { _mm256_loadu_pd(x) }; }
+			static VecD4 broadcast(double x) noexcept { return { _mm256_set1_pd(x) }; }
+			static VecD4 zero() noexcept { return { _mm256_setzero_pd() }; }
+			static VecD4 loadFloats(const float* x) noexcept { return { _mm256_cvtps_pd(_mm_loadu_ps(x)) }; }
+			void store(double* x) const noexcept { _mm256_storeu_pd(x, v); }
+			void storeFloats(float* x) const noexcept { _mm_storeu_ps(x, _mm256_cvtpd_ps(v)); }
+
+			__m256d v;
+		};
+
+		inline VecD4 operator+(VecD4 a, VecD4 b) noexcept { return { _mm256_add_pd(a.v, b.v) }; }
+		inline VecD4 operator-(VecD4 a, VecD4 b) noexcept { return { _mm256_sub_pd(a.v, b.v) }; }
+		inline VecD4 operator*(VecD4 a, VecD4 b) noexcept { return { _mm256_mul_pd(a.v, b.v) }; }
+		inline VecD4 operator/(VecD4 a, VecD4 b) noexcept { return { _mm256_div_pd(a.v, b.v) }; }
+		inline VecD4 min(VecD4 a, VecD4 b) noexcept { return { _mm256_min_pd(a.v, b.v) }; }
+		inline VecD4 max(VecD4 a, VecD4 b) noexcept { return { _mm256_max_pd(a.v, b.v) }; }
+		inline VecD4 abs(VecD4 a) noexcept { return { _mm256_andnot_pd(_mm256_set1_pd(-0.), a.v) }; }
+		inline VecD4 lessThan(VecD4 a, VecD4 b) noexcept { return { _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ) }; }
+		inline VecD4 equal(VecD4 a, VecD4 b) noexcept { return { _mm256_cmp_pd(a.v, b.v, _CMP_EQ_OQ) }; }
+		inline VecD4 maskAnd(VecD4 a, VecD4 b) noexcept { return { _mm256_and_pd(a.v, b.v) }; }
+		inline VecD4 maskOr(VecD4 a, VecD4 b) noexcept { return { _mm256_or_pd(a.v, b.v) }; }
+		inline VecD4 select(VecD4 m, VecD4 a, VecD4 b) noexcept { return { _mm256_blendv_pd(b.v, a.v, m.v) }; }
+		inline double sum(VecD4 a) noexcept
+		{
+			const auto lo = _mm256_castpd256_pd128(a.v);
+			const auto hi = _mm256_extractf128_pd(a.v, 1);
+			const auto x = _mm_add_pd(lo, hi);
+			return _mm_cvtsd_f64(_mm_add_sd(x, _mm_unpackhi_pd(x, x)));
+		}
+		inline bool any(VecD4 m) noexcept { return _mm256_movemask_pd(m.v) != 0; }
+		inline double last(VecD4 a) noexcept
+		{
+			const auto hi = _mm256_extractf128_pd(a.v, 1);
+			return _mm_cvtsd_f64(_mm_unpackhi_pd(hi, hi));
+		}
+#endif
+
+#if OnsetHasAVX512
+		// 8 lanes. compares give bit masks here, they are widened back
+		// to lane masks so that the kernels see the same mask semantics.
+		struct VecD8
+		{
+			using Scalar = double;
+			static constexpr int Size = 8;
+
+			static VecD8 load(const double* x) noexcept { return { _mm512_loadu_pd(x) }; }
+			static VecD8 broadcast(double x) noexcept { return { _mm512_set1_pd(x) }; }
+			static VecD8 zero() noexcept { return { _mm512_setzero_pd() }; }
+			static VecD8 loadFloats(const float* x) noexcept { return { _mm512_cvtps_pd(_mm256_loadu_ps(x)) }; }
+			void store(double* x) const noexcept { _mm512_storeu_pd(x, v); }
+			void storeFloats(float* x) const noexcept { _mm256_storeu_ps(x, _mm512_cvtpd_ps(v)); }
+
+			__m512d v;
+		};
+
+		inline VecD8 toMask(__mmask8 m) noexcept
+		{
+			return { _mm512_castsi512_pd(_mm512_maskz_set1_epi64(m, -1)) };
+		}
+		inline __mmask8 toBits(VecD8 m) noexcept
+		{
+			const auto i = _mm512_castpd_si512(m.v);
+			return _mm512_test_epi64_mask(i, i);
+		}
+
+		inline VecD8 operator+(VecD8 a, VecD8 b) noexcept { return { _mm512_add_pd(a.v, b.v) }; }
+		inline VecD8 operator-(VecD8 a, VecD8 b) noexcept { return { _mm512_sub_pd(a.v, b.v) }; }
+		inline VecD8 operator*(VecD8 a, VecD8 b) noexcept { return { _mm512_mul_pd(a.v, b.v) }; }
+		inline VecD8 operator/(VecD8 a, VecD8 b) noexcept { return { _mm512_div_pd(a.v, b.v) }; }
+		inline VecD8 min(VecD8 a, VecD8 b) noexcept { return { _mm512_min_pd(a.v, b.v) }; }
+		inline VecD8 max(VecD8 a, VecD8 b) noexcept { return { _mm512_max_pd(a.v, b.v) }; }
+		inline VecD8 abs(VecD8 a) noexcept { return { _mm512_abs_pd(a.v) }; }
+		inline VecD8 lessThan(VecD8 a, VecD8 b) noexcept { return toMask(_mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ)); }
+		inline VecD8 equal(VecD8 a, VecD8 b) noexcept { return toMask(_mm512_cmp_pd_mask(a.v, b.v, _CMP_EQ_OQ)); }
+		inline VecD8 maskAnd(VecD8 a, VecD8 b) noexcept
+		{
+			return { _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a.v), _mm512_castpd_si512(b.v))) };
+		}
+		inline VecD8 maskOr(VecD8 a, VecD8 b) noexcept
+		{
+			return { _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(a.v), _mm512_castpd_si512(b.v))) };
+		}
+		inline VecD8 select(VecD8 m, VecD8 a, VecD8 b) noexcept { return { _mm512_mask_blend_pd(toBits(m), b.v, a.v) }; }
+		inline double sum(VecD8 a) noexcept { return _mm512_reduce_add_pd(a.v); }
+		inline bool any(VecD8 m) noexcept { return toBits(m) != 0; }
+		inline double last(VecD8 a) noexcept { return last(VecD4{ _mm512_extractf64x4_pd(a.v, 1) }); }
+#endif
+
+		// float lanes, used by the buffer kernels and the float bank:
+
+		// 1 lane
+		struct VecF1
+		{
+			using Scalar = float;
+			static constexpr int Size = 1;
+
+			static VecF1 load(const float* x) noexcept { return { *x }; }
+			static VecF1 broadcast(float x) noexcept { return { x }; }
+			static VecF1 zero() noexcept { return { 0.f }; }
+			static VecF1 loadFloats(const float* x) noexcept { return load(x); }
+			void store(float* x) const noexcept { *x = v; }
+			void storeFloats(float* x) const noexcept { store(x); }
+
+			float v;
+		};
+
+		inline VecF1 operator+(VecF1 a, VecF1 b) noexcept { return { a.v + b.v }; }
+		inline VecF1 operator-(VecF1 a, VecF1 b) noexcept { return { a.v - b.v }; }
+		inline VecF1 operator*(VecF1 a, VecF1 b) noexcept { return { a.v * b.v }; }
+		inline VecF1 operator/(VecF1 a, VecF1 b) noexcept { return { a.v / b.v }; }
+		inline VecF1 min(VecF1 a, VecF1 b) noexcept { return { a.v < b.v ? a.v : b.v }; }
+		inline VecF1 max(VecF1 a, VecF1 b) noexcept { return { a.v < b.v ? b.v : a.v }; }
+		inline VecF1 abs(VecF1 a) noexcept { return { std::abs(a.v) }; }
+		inline VecF1 sqrt(VecF1 a) noexcept { return { std::sqrt(a.v) }; }
+		inline VecF1 lessThan(VecF1 a, VecF1 b) noexcept { return { a.v < b.v ? 1.f : 0.f }; }
+		inline VecF1 equal(VecF1 a, VecF1 b) noexcept { return { a.v == b.v ? 1.f : 0.f }; }
+		inline VecF1 maskAnd(VecF1 a, VecF1 b) noexcept { return { a.v != 0.f && b.v != 0.f ? 1.f : 0.f }; }
+		inline VecF1 maskOr(VecF1 a, VecF1 b) noexcept { return { a.v != 0.f || b.v != 0.f ? 1.f : 0.f }; }
+		// mask, a (if true), b (if false)
+		inline VecF1 select(VecF1 m, VecF1 a, VecF1 b) noexcept { return m.v != 0.f ? a : b; }
+		inline float sum(VecF1 a) noexcept { return a.v; }
+		inline float reduceMax(VecF1 a) noexcept { return a.v; }
+		inline bool any(VecF1 m) noexcept { return m.v != 0.f; }
+		inline float last(VecF1 a) noexcept { return a.v; }
+
+#if OnsetHasSSE2
+		// 4 lanes
+		struct VecF4
+		{
+			using Scalar = float;
+			static constexpr int Size = 4;
+
+			static VecF4 load(const float* x) noexcept { return { _mm_loadu_ps(x) }; }
+			static VecF4 broadcast(float x) noexcept { return { _mm_set1_ps(x) }; }
+			static VecF4 zero() noexcept { return { _mm_setzero_ps() }; }
+			static VecF4 loadFloats(const float* x) noexcept { return load(x); }
+			void store(float* x) const noexcept { _mm_storeu_ps(x, v); }
+			void storeFloats(float* x) const noexcept { store(x); }
+
+			__m128 v;
+		};
+
+		inline VecF4 operator+(VecF4 a, VecF4 b) noexcept { return { _mm_add_ps(a.v, b.v) }; }
+		inline VecF4 operator-(VecF4 a, VecF4 b) noexcept { return { _mm_sub_ps(a.v, b.v) }; }
+		inline VecF4 operator*(VecF4 a, VecF4 b) noexcept { return { _mm_mul_ps(a.v, b.v) }; }
+		inline VecF4 operator/(VecF4 a, VecF4 b) noexcept { return { _mm_div_ps(a.v, b.v) }; }
+		inline VecF4 min(VecF4 a, VecF4 b) noexcept { return { _mm_min_ps(a.v, b.v) }; }
+		inline VecF4 max(VecF4 a, VecF4 b) noexcept { return { _mm_max_ps(a.v, b.v) }; }
+		inline VecF4 abs(VecF4 a) noexcept { return { _mm_andnot_ps(_mm_set1_ps(-0.f), a.v) }; }
+		inline VecF4 sqrt(VecF4 a) noexcept { return { _mm_sqrt_ps(a.v) }; }
+		inline VecF4 lessThan(VecF4 a, VecF4 b) noexcept { return { _mm_cmplt_ps(a.v, b.v) }; }
+		inline VecF4 equal(VecF4 a, VecF4 b) noexcept { return { _mm_cmpeq_ps(a.v, b.v) }; }
+		inline VecF4 maskAnd(VecF4 a, VecF4 b) noexcept { return { _mm_and_ps(a.v, b.v) }; }
+		inline VecF4 maskOr(VecF4 a, VecF4 b) noexcept { return { _mm_or_ps(a.v, b.v) }; }
+		inline VecF4 select(VecF4 m, VecF4 a, VecF4 b) noexcept
+		{
+			return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) };
+		}
+		inline float sum(VecF4 a) noexcept
+		{
+			const auto x = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+			return _mm_cvtss_f32(_mm_add_ss(x, _mm_shuffle_ps(x, x, 1)));
+		}
+		inline float reduceMax(VecF4 a) noexcept
+		{
+			const auto x = _mm_max_ps(a.v, _mm_movehl_ps(a.v, a.v));
+			return _mm_cvtss_f32(_mm_max_ss(x, _mm_shuffle_ps(x, x, 1)));
+		}
+		inline bool any(VecF4 m) noexcept { return _mm_movemask_ps(m.v) != 0; }
+		inline float last(VecF4 a) noexcept { return _mm_cvtss_f32(_mm_shuffle_ps(a.v, a.v, 3)); }
+#endif
+
+#if OnsetHasAVX
+		// 8 lanes
+		struct VecF8
+		{
+			using Scalar = float;
+			static constexpr int Size = 8;
+
+			static VecF8 load(const float* x) noexcept { return { _mm256_loadu_ps(x) }; }
+			static VecF8 broadcast(float x) noexcept { return { _mm256_set1_ps(x) }; }
+			static VecF8 zero() noexcept { return { _mm256_setzero_ps() }; }
+			static VecF8 loadFloats(const float* x) noexcept { return load(x); }
+			void store(float* x) const noexcept { _mm256_storeu_ps(x, v); }
+			void storeFloats(float* x) const noexcept { store(x); }
+
+			__m256 v;
+		};
+
+		inline VecF8 operator+(VecF8 a, VecF8 b) noexcept { return { _mm256_add_ps(a.v, b.v) }; }
+		inline VecF8 operator-(VecF8 a, VecF8 b) noexcept { return { _mm256_sub_ps(a.v, b.v) }; }
+		inline VecF8 operator*(VecF8 a, VecF8 b) noexcept { return { _mm256_mul_ps(a.v, b.v) }; }
+		inline VecF8 operator/(VecF8 a, VecF8 b) noexcept { return { _mm256_div_ps(a.v, b.v) }; }
+		inline VecF8 min(VecF8 a, VecF8 b) noexcept { return { _mm256_min_ps(a.v, b.v) }; }
+		inline VecF8 max(VecF8 a, VecF8 b) noexcept { return { _mm256_max_ps(a.v, b.v) }; }
+		inline VecF8 abs(VecF8 a) noexcept { return { _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v) }; }
+		inline VecF8 sqrt(VecF8 a) noexcept { return { _mm256_sqrt_ps(a.v) }; }
+		inline VecF8 lessThan(VecF8 a, VecF8 b) noexcept { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+		inline VecF8 equal(VecF8 a, VecF8 b) noexcept { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+		inline VecF8 maskAnd(VecF8 a, VecF8 b) noexcept { return { _mm256_and_ps(a.v, b.v) }; }
+		inline VecF8 maskOr(VecF8 a, VecF8 b) noexcept { return { _mm256_or_ps(a.v, b.v) }; }
+		inline VecF8 select(VecF8 m, VecF8 a, VecF8 b) noexcept { return { _mm256_blendv_ps(b.v, a.v, m.v) }; }
+		inline float sum(VecF8 a) noexcept
+		{
+			return sum(VecF4{ _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1)) });
+		}
+		inline float reduceMax(VecF8 a) noexcept
+		{
+			return reduceMax(VecF4{ _mm_max_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1)) });
+		}
+		inline bool any(VecF8 m) noexcept { return _mm256_movemask_ps(m.v) != 0; }
+		inline float last(VecF8 a) noexcept { return last(VecF4{ _mm256_extractf128_ps(a.v, 1) }); }
+#endif
+
+#if OnsetHasAVX512
+		// 16 lanes, masks like VecD8
+		struct VecF16
+		{
+			using Scalar = float;
+			static constexpr int Size = 16;
+
+			static VecF16 load(const float* x) noexcept { return { _mm512_loadu_ps(x) }; }
+			static VecF16 broadcast(float x) noexcept { return { _mm512_set1_ps(x) }; }
+			static VecF16 zero() noexcept { return { _mm512_setzero_ps() }; }
+			static VecF16 loadFloats(const float* x) noexcept { return load(x); }
+			void store(float* x) const noexcept { _mm512_storeu_ps(x, v); }
+			void storeFloats(float* x) const noexcept { store(x); }
+
+			__m512 v;
+		};
+
+		inline VecF16 toMask(__mmask16 m) noexcept
+		{
+			return { _mm512_castsi512_ps(_mm512_maskz_set1_epi32(m, -1)) };
+		}
+		inline __mmask16 toBits(VecF16 m) noexcept
+		{
+			const auto i = _mm512_castps_si512(m.v);
+			return _mm512_test_epi32_mask(i, i);
+		}
+
+		inline VecF16 operator+(VecF16 a, VecF16 b) noexcept { return { _mm512_add_ps(a.v, b.v) }; }
+		inline VecF16 operator-(VecF16 a, VecF16 b) noexcept { return { _mm512_sub_ps(a.v, b.v) }; }
+		inline VecF16 operator*(VecF16 a, VecF16 b) noexcept { return { _mm512_mul_ps(a.v, b.v) }; }
+		inline VecF16 operator/(VecF16 a, VecF16 b) noexcept { return { _mm512_div_ps(a.v, b.v) }; }
+		inline VecF16 min(VecF16 a, VecF16 b) noexcept { return { _mm512_min_ps(a.v, b.v) }; }
+		inline VecF16 max(VecF16 a, VecF16 b) noexcept { return { _mm512_max_ps(a.v, b.v) }; }
+		inline VecF16 abs(VecF16 a) noexcept { return { _mm512_abs_ps(a.v) }; }
+		inline VecF16 sqrt(VecF16 a) noexcept { return { _mm512_sqrt_ps(a.v) }; }
+		inline VecF16 lessThan(VecF16 a, VecF16 b) noexcept { return toMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)); }
+		inline VecF16 equal(VecF16 a, VecF16 b) noexcept { return toMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_EQ_OQ)); }
+		inline VecF16 maskAnd(VecF16 a, VecF16 b) noexcept
+		{
+			return { _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a.v), _mm512_castps_si512(b.v))) };
+		}
+		inline VecF16 maskOr(VecF16 a, VecF16 b) noexcept
+		{
+			return { _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(a.v), _mm512_castps_si512(b.v))) };
+		}
+		inline VecF16 select(VecF16 m, VecF16 a, VecF16 b) noexcept { return { _mm512_mask_blend_ps(toBits(m), b.v, a.v) }; }
+		inline float sum(VecF16 a) noexcept { return _mm512_reduce_add_ps(a.v); }
+		inline float reduceMax(VecF16 a) noexcept { return _mm512_reduce_max_ps(a.v); }
+		inline bool any(VecF16 m) noexcept { return toBits(m) != 0; }
+		inline float last(VecF16 a) noexcept { return last(VecF4{ _mm512_extractf32x4_ps(a.v, 3) }); }
+#endif
+
+		// Resonator3 on every lane: the clipped 2-pole resonator minus its lowpass.
+		// x, a0, b1, b2, z1, z2, lpA0, lpB1, lpY1
+		template<class Vec>
+		inline Vec resonate(Vec x, Vec a0, Vec b1, Vec b2, Vec& z1, Vec& z2,
+			Vec lpA0, Vec lpB1, Vec& lpY1) noexcept
+		{
+			auto y = a0 * x - b1 * z1 - b2 * z2;
+			using Scalar = typename Vec::Scalar;
+			y = min(Vec::broadcast(static_cast<Scalar>(1.)), max(Vec::broadcast(static_cast<Scalar>(-1.)), y));
+			z2 = z1;
+			z1 = y;
+			lpY1 = y * lpA0 + lpY1 * lpB1;
+			return y - lpY1;
+		}
+
+		// EnvelopeFollower::processSample on every lane. attack while rising,
+		// decay while falling, keep the state on equality.
+		// s1 (rectified), y1, state, atk, dcy, one
+		template<class Vec>
+		inline Vec followEnvelope(Vec s1, Vec& y1, Vec& state, Vec atk, Vec dcy, Vec one) noexcept
+		{
+			const auto s0 = y1;
+			state = maskOr(lessThan(s0, s1), maskAnd(state, equal(s0, s1)));
+			const auto x = select(state, atk, dcy);
+			y1 = s1 * (one - x) + y1 * x;
+			return y1;
+		}
+
+		// the widest vector this translation unit was compiled for
+#if OnsetHasAVX
+		using VecD = VecD4;
+#elif OnsetHasSSE2
+		using VecD = VecD2;
+#else
+		using VecD = VecD1;
+#endif
+	}
+	}
+}
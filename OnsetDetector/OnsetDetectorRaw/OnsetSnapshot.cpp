@@ -0,0 +1,65 @@
+#include "OnsetSnapshot.h"
+#include "OnsetDetector.h"
+#include <cmath>
+
+namespace dsp
+{
+	OnsetSnapshot::OnsetSnapshot() :
+		bands(),
+		design()
+	{
+	}
+
+	// the defaults of OnsetBands
+	OnsetBandsDesign::OnsetBandsDesign() :
+		sampleRate(1.),
+		lowestPitch(freqHzToNote(OnsetLowestFreqHz)),
+		highestPitch(freqHzToNote(OnsetHighestFreqHz)),
+		bandwidth(std::pow(2., static_cast<double>(OnsetBandwidthDefault))),
+		attack(std::pow(2., static_cast<double>(OnsetAtkDefault))),
+		decay(std::pow(2., static_cast<double>(OnsetDcyDefault))),
+		tilt(OnsetTiltDefault),
+		numBands(static_cast<int>(OnsetNumBandsDefault)),
+		multirate(false)
+	{
+	}
+
+	bool OnsetBandsDesign::operator==(const OnsetBandsDesign& other) const noexcept
+	{
+		return sampleRate == other.sampleRate
+			&& lowestPitch == other.lowestPitch
+			&& highestPitch == other.highestPitch
+			&& bandwidth == other.bandwidth
+			&& attack == other.attack
+			&& decay == other.decay
+			&& tilt == other.tilt
+			&& numBands == other.numBands
+			&& multirate == other.multirate;
+	}
+
+	void OnsetBandsDesign::saveState(OnsetStateWriter& w) const noexcept
+	{
+		w(sampleRate);
+		w(lowestPitch);
+		w(highestPitch);
+		w(bandwidth);
+		w(attack);
+		w(decay);
+		w(tilt);
+		w(numBands);
+		w(multirate);
+	}
+
+	void OnsetBandsDesign::restoreState(OnsetStateReader& r) noexcept
+	{
+		r(sampleRate);
+		r(lowestPitch);
+		r(highestPitch);
+		r(bandwidth);
+		r(attack);
+		r(decay);
+		r(tilt);
+		r(numBands);
+		r(multirate);
+	}
+}
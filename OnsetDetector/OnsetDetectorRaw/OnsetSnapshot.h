@@ -0,0 +1,53 @@
+#pragma once
+#include "OnsetAxiom.h"
+#include "OnsetState.h"
+#include <array>
+
+namespace dsp
+{
+	// the coefficients of one band
+	struct OnsetBandCoefficients
+	{
+		// resonator and its highpass
+		double resoA0, resoB1, resoB2, lpX;
+		// fast (0) and slow (1) envelope followers
+		double env0Atk, env0Dcy, env1Atk, env1Dcy;
+		float gain;
+		// octave level (see OnsetMultirateT)
+		int level;
+		// if the band can run in float (see ResonatorBaseT::fitsFloat)
+		bool fitsFloat;
+	};
+
+	// The parameters that decide every band's coefficients (see
+	// OnsetBands). Equal designs give equal snapshots.
+	struct OnsetBandsDesign
+	{
+		OnsetBandsDesign();
+
+		// other
+		bool operator==(const OnsetBandsDesign&) const noexcept;
+
+		// writer
+		void saveState(OnsetStateWriter&) const noexcept;
+
+		// reader
+		void restoreState(OnsetStateReader&) noexcept;
+
+		double sampleRate, lowestPitch, highestPitch, bandwidth, attack, decay;
+		float tilt;
+		int numBands;
+		bool multirate;
+	};
+
+	// The coefficients of all bands at one point in time. Computing them
+	// costs pow, log2, exp, cos and sqrt per band, copying them doesn't.
+	struct OnsetSnapshot
+	{
+		OnsetSnapshot();
+
+		std::array<OnsetBandCoefficients, OnsetNumBandsMax> bands;
+		// the design they come from
+		OnsetBandsDesign design;
+	};
+}
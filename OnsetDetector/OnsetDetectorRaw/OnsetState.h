@@ -0,0 +1,130 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace dsp
+{
+	// "ODST", tells a saved detector state (see OnsetDetectorT::saveState)
+	// from other bytes and from one of the other byte order
+	static constexpr uint32_t OnsetStateMagic = 0x5453444f;
+	// bumped whenever the layout of the state changes
+	static constexpr uint32_t OnsetStateVersion = 5;
+
+	// Appends numbers and enums to caller-owned bytes in the machine's
+	// representation, bools as one byte 0 or 1. Structs go field by
+	// field, so that no padding ends up in the state. It never writes
+	// past the capacity, but keeps counting, so that a writer without
+	// bytes measures a state.
+	struct OnsetStateWriter
+	{
+		// data (can be nullptr), capacity
+		OnsetStateWriter(uint8_t* _data, size_t _capacity) noexcept :
+			data(_data),
+			capacity(_capacity),
+			size(0)
+		{ }
+
+		// x
+		template<typename T>
+		void operator()(const T& x) noexcept
+		{
+			static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+				"numbers and enums only, structs go field by field");
+			if (size + sizeof(T) <= capacity)
+				std::memcpy(data + size, &x, sizeof(T));
+			size += sizeof(T);
+		}
+
+		// x
+		void operator()(bool x) noexcept
+		{
+			operator()(static_cast<uint8_t>(x ? 1 : 0));
+		}
+
+		// x
+		template<typename T, size_t Size>
+		void operator()(const std::array<T, Size>& x) noexcept
+		{
+			for (const auto& v : x)
+				operator()(v);
+		}
+
+		// bytes written, or needed if they didn't fit
+		size_t getSize() const noexcept
+		{
+			return size;
+		}
+
+		// if everything fit
+		bool isValid() const noexcept
+		{
+			return size <= capacity;
+		}
+	private:
+		uint8_t* data;
+		size_t capacity, size;
+	};
+
+	// Reads what an OnsetStateWriter wrote, in the same order. Reading
+	// past the end or a bool that is neither 0 nor 1 leaves the value
+	// untouched and invalidates the reader.
+	struct OnsetStateReader
+	{
+		// data, size
+		OnsetStateReader(const uint8_t* _data, size_t _size) noexcept :
+			data(_data),
+			size(_size),
+			position(0),
+			broken(false)
+		{ }
+
+		// x
+		template<typename T>
+		void operator()(T& x) noexcept
+		{
+			static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+				"numbers and enums only, structs go field by field");
+			if (position + sizeof(T) <= size)
+				std::memcpy(&x, data + position, sizeof(T));
+			position += sizeof(T);
+		}
+
+		// x
+		void operator()(bool& x) noexcept
+		{
+			auto b = uint8_t(0);
+			operator()(b);
+			if (b > 1)
+				broken = true;
+			else if (position <= size)
+				x = b == 1;
+		}
+
+		// x
+		template<typename T, size_t Size>
+		void operator()(std::array<T, Size>& x) noexcept
+		{
+			for (auto& v : x)
+				operator()(v);
+		}
+
+		// bytes read so far
+		size_t getPosition() const noexcept
+		{
+			return position;
+		}
+
+		// if nothing was read past the end and every bool was 0 or 1
+		bool isValid() const noexcept
+		{
+			return !broken && position <= size;
+		}
+	private:
+		const uint8_t* data;
+		size_t size, position;
+		bool broken;
+	};
+}
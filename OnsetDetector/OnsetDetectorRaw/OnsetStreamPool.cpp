@@ -0,0 +1,312 @@
+#include "OnsetStreamPool.h"
+#include <algorithm>
+#include <new>
+
+namespace dsp
+{
+	namespace
+	{
+		static constexpr size_t CacheLine = 64;
+
+		size_t alignToCacheLine(size_t numBytes) noexcept
+		{
+			return (numBytes + CacheLine - 1) & ~(CacheLine - 1);
+		}
+	}
+
+	// STREAM:
+
+	OnsetStream::OnsetStream() :
+		trigger(),
+		position(0), sleepSamples(0),
+		next(nullptr),
+		alive(false), asleep(false)
+	{
+	}
+
+	void OnsetStream::setThreshold(float db) noexcept
+	{
+		trigger.setThreshold(db);
+	}
+
+	void OnsetStream::setHoldLength(double ms) noexcept
+	{
+		trigger.setHoldLength(ms);
+	}
+
+	int64_t OnsetStream::getPosition() const noexcept
+	{
+		return position;
+	}
+
+	OnsetBandState* OnsetStream::getBands() noexcept
+	{
+		return reinterpret_cast<OnsetBandState*>(this + 1);
+	}
+
+	// STREAM POOL:
+
+	OnsetStreamPool::OnsetStreamPool(int _maxBands) :
+		chunks(),
+		design(),
+		snapshot(),
+		resetState(),
+		freeList(nullptr),
+		slotSize(0),
+		maxBands(std::min(std::max(_maxBands, 1), OnsetNumBandsMax)),
+		numStreams(0),
+		version(0),
+		prepared(false)
+	{
+		static_assert(sizeof(OnsetStream) % alignof(OnsetBandState) == 0,
+			"the bands follow the stream");
+		slotSize = alignToCacheLine(sizeof(OnsetStream) + maxBands * sizeof(OnsetBandState));
+		design.numBands = std::min(design.numBands, maxBands);
+		OnsetCore core;
+		core.reset();
+		core.getState(resetState);
+	}
+
+	OnsetStreamPool::~OnsetStreamPool()
+	{
+		for (auto chunk : chunks)
+			::operator delete(chunk);
+	}
+
+	// parameters:
+
+	void OnsetStreamPool::setAttack(double x)
+	{
+		design.attack = x;
+		update();
+	}
+
+	void OnsetStreamPool::setDecay(double x)
+	{
+		design.decay = x;
+		update();
+	}
+
+	void OnsetStreamPool::setTilt(float db)
+	{
+		design.tilt = db;
+		update();
+	}
+
+	void OnsetStreamPool::setBandwidth(double b)
+	{
+		design.bandwidth = b;
+		update();
+	}
+
+	void OnsetStreamPool::setNumBands(int n)
+	{
+		design.numBands = std::min(std::max(n, 1), maxBands);
+		update();
+	}
+
+	void OnsetStreamPool::setLowestPitch(double p)
+	{
+		design.lowestPitch = p;
+		update();
+	}
+
+	void OnsetStreamPool::setHighestPitch(double p)
+	{
+		design.highestPitch = p;
+		update();
+	}
+
+	void OnsetStreamPool::prepare(double sampleRate)
+	{
+		design.sampleRate = sampleRate;
+		prepared = true;
+		update();
+		for (auto chunk : chunks)
+			for (auto i = 0; i < ChunkSize; ++i)
+			{
+				auto& stream = getSlot(chunk, i);
+				if (!stream.alive)
+					continue;
+				stream.trigger.prepare(sampleRate);
+				reset(stream);
+			}
+	}
+
+	// streams:
+
+	OnsetStream* OnsetStreamPool::create()
+	{
+		if (freeList == nullptr)
+			addChunk();
+		auto stream = freeList;
+		freeList = stream->next;
+		stream->next = nullptr;
+		stream->alive = true;
+		// like a new detector, then prepared
+		stream->trigger = OnsetTrigger();
+		stream->trigger.prepare(design.sampleRate);
+		reset(*stream);
+		++numStreams;
+		return stream;
+	}
+
+	void OnsetStreamPool::destroy(OnsetStream* stream) noexcept
+	{
+		if (stream == nullptr || !stream->alive)
+			return;
+		stream->alive = false;
+		stream->next = freeList;
+		freeList = stream;
+		--numStreams;
+	}
+
+	int OnsetStreamPool::getNumStreams() const noexcept
+	{
+		return numStreams;
+	}
+
+	size_t OnsetStreamPool::getSlotSize() const noexcept
+	{
+		return slotSize;
+	}
+
+	size_t OnsetStreamPool::getNumBytes() const noexcept
+	{
+		return chunks.size() * (ChunkSize * slotSize + CacheLine);
+	}
+
+	const OnsetSnapshot* OnsetStreamPool::getSnapshot() const noexcept
+	{
+		return snapshot.get();
+	}
+
+	int OnsetStreamPool::getVersion() const noexcept
+	{
+		return version;
+	}
+
+	void OnsetStreamPool::reset(OnsetStream& stream) noexcept
+	{
+		stream.position = 0;
+		stream.sleepSamples = 0;
+		stream.asleep = false;
+		auto bands = stream.getBands();
+		for (auto i = 0; i < maxBands; ++i)
+			bands[i] = resetState;
+	}
+
+	void OnsetStreamPool::update()
+	{
+		if (!prepared)
+			return;
+		snapshot = OnsetBandsCache::getInstance()(design);
+		++version;
+	}
+
+	void OnsetStreamPool::addChunk()
+	{
+		// operator new only promises alignof(max_align_t), the chunk is
+		// aligned by hand and keeps the pointer it got
+		const auto chunk = static_cast<char*>(::operator new(ChunkSize * slotSize + CacheLine));
+		chunks.push_back(chunk);
+		for (auto i = ChunkSize - 1; i >= 0; --i)
+		{
+			auto& stream = *new(&getSlot(chunk, i)) OnsetStream();
+			stream.next = freeList;
+			freeList = &stream;
+		}
+	}
+
+	OnsetStream& OnsetStreamPool::getSlot(char* chunk, int i) const noexcept
+	{
+		const auto address = reinterpret_cast<uintptr_t>(chunk);
+		const auto aligned = (address + CacheLine - 1) & ~static_cast<uintptr_t>(CacheLine - 1);
+		return *reinterpret_cast<OnsetStream*>(aligned + static_cast<uintptr_t>(i) * slotSize);
+	}
+
+	// STREAM WORKER:
+
+	OnsetStreamWorker::OnsetStreamWorker() :
+		bands(),
+		buffer(),
+		odf(),
+		pool(nullptr),
+		kernels(&selectOnsetKernels()),
+		version(0)
+	{
+	}
+
+	void OnsetStreamWorker::setMaxISA(OnsetISA isa) noexcept
+	{
+		kernels = &selectOnsetKernels(isa);
+		for (auto i = 0; i < OnsetNumBandsMax; ++i)
+			bands[i].setKernels(*kernels);
+	}
+
+	int OnsetStreamWorker::operator()(const OnsetStreamPool& p, OnsetStream& stream,
+		float** samples, int numChannels, int numSamples, OnsetEvents* events) noexcept
+	{
+		pull(p);
+		if (p.getSnapshot() == nullptr)
+			return 0;
+		const auto numEventsBefore = events != nullptr ? events->size() : 0;
+		for (auto s = 0; s < numSamples; s += BlockSize)
+		{
+			const auto n = std::min(BlockSize, numSamples - s);
+			float* block[] = { &samples[0][s], &samples[numChannels > 1 ? 1 : 0][s] };
+			processBlock(stream, block, numChannels, n, events);
+		}
+		return events != nullptr ? events->size() - numEventsBefore : 0;
+	}
+
+	void OnsetStreamWorker::pull(const OnsetStreamPool& p) noexcept
+	{
+		if (pool == &p && version == p.getVersion())
+			return;
+		pool = &p;
+		version = p.getVersion();
+		if (p.getSnapshot() != nullptr)
+			bands.setSnapshot(*p.getSnapshot());
+	}
+
+	void OnsetStreamWorker::processBlock(OnsetStream& stream, float** samples,
+		int numChannels, int numSamples, OnsetEvents* events) noexcept
+	{
+		// like OnsetDetectorT's Cores engine, but only the whole stream sleeps
+		kernels->copyFromMid(buffer.getSamples(), samples, numChannels, numSamples);
+		kernels->rectify(buffer.getSamples(), numSamples);
+		const auto silent = kernels->getMaxMag(buffer.getSamples(), numSamples) < OnsetSleepFloor;
+		if (stream.asleep)
+		{
+			if (silent)
+			{
+				stream.sleepSamples += numSamples;
+				stream.trigger.skip(numSamples);
+				stream.position += numSamples;
+				return;
+			}
+			stream.asleep = false;
+		}
+		const auto numBands = bands.getNumBands();
+		const auto states = stream.getBands();
+		auto asleep = silent;
+		odf.clear(numSamples);
+		for (auto i = 0; i < numBands; ++i)
+		{
+			auto& band = bands[i];
+			band.setState(states[i]);
+			if (stream.sleepSamples != 0)
+				band.sleep(stream.sleepSamples);
+			band(buffer.getSamples(), odf.getSamples(), numSamples);
+			band.getState(states[i]);
+			asleep = asleep && band.isAsleep();
+		}
+		stream.sleepSamples = 0;
+		kernels->combine(odf.getSamples(), static_cast<float>(numBands), numSamples);
+		for (auto s = 0; s < numSamples; ++s)
+			stream.trigger(odf[s], stream.position + s, events);
+		stream.position += numSamples;
+		stream.asleep = asleep;
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include "OnsetDetector.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dsp
+{
+	// The compact state of one stream of an OnsetStreamPool: its trigger,
+	// position and the state of every band, which lives right behind it
+	// in the same slot. Everything else is shared by the pool or belongs
+	// to the OnsetStreamWorker that processes it.
+	struct OnsetStream
+	{
+		OnsetStream();
+
+		// db
+		void setThreshold(float) noexcept;
+
+		// ms
+		void setHoldLength(double) noexcept;
+
+		// samples processed since the stream was created or prepared
+		int64_t getPosition() const noexcept;
+
+		// maxBands of them (see OnsetStreamPool)
+		OnsetBandState* getBands() noexcept;
+
+		OnsetTrigger trigger;
+		int64_t position, sleepSamples;
+		// the next free slot while it isn't in use
+		OnsetStream* next;
+		bool alive, asleep;
+	};
+
+	// Thousands of detectors with the same band parameters, like one
+	// OnsetDetector (Cores engine) per stream, but each stream only keeps
+	// its state. The slots are sized to maxBands and come from 64 byte
+	// aligned chunks of the pool's arena, creating and destroying a stream
+	// only takes one from or gives one back to the free list. The band
+	// coefficients are one shared snapshot (see OnsetBandsCache), the
+	// cores and buffers are the workers'.
+	// Set the parameters and prepare while no worker processes, and not
+	// on a realtime thread: they lock the cache and may allocate.
+	struct OnsetStreamPool
+	{
+		// streams per chunk of the arena
+		static constexpr int ChunkSize = 64;
+
+		// the most bands any stream can have
+		// maxBands [1, OnsetNumBandsMax]
+		OnsetStreamPool(int = OnsetNumBandsMax);
+
+		~OnsetStreamPool();
+
+		// parameters (all streams):
+
+		void setAttack(double);
+
+		void setDecay(double);
+
+		void setTilt(float);
+
+		void setBandwidth(double);
+
+		// numBands [1, maxBands]
+		void setNumBands(int);
+
+		void setLowestPitch(double);
+
+		void setHighestPitch(double);
+
+		// sampleRate, resets every stream
+		void prepare(double);
+
+		// streams:
+
+		// a new stream at position 0, it starts like a freshly prepared
+		// detector. only allocates when every chunk is full.
+		OnsetStream* create();
+
+		// stream
+		void destroy(OnsetStream*) noexcept;
+
+		int getNumStreams() const noexcept;
+
+		// bytes of one stream's slot
+		size_t getSlotSize() const noexcept;
+
+		// bytes the arena holds
+		size_t getNumBytes() const noexcept;
+
+		// the coefficients the workers pull, nullptr before prepare()
+		const OnsetSnapshot* getSnapshot() const noexcept;
+
+		// changes with every new snapshot
+		int getVersion() const noexcept;
+	private:
+		std::vector<char*> chunks;
+		OnsetBandsDesign design;
+		std::shared_ptr<const OnsetSnapshot> snapshot;
+		// the state of a freshly reset band
+		OnsetBandState resetState;
+		OnsetStream* freeList;
+		size_t slotSize;
+		int maxBands, numStreams, version;
+		// without a sampleRate there is nothing to design yet
+		bool prepared;
+
+		// stream
+		void reset(OnsetStream&) noexcept;
+
+		// designs the bands if prepared
+		void update();
+
+		void addChunk();
+
+		// chunk, i
+		OnsetStream& getSlot(char*, int) const noexcept;
+	};
+
+	// The scratch of one thread that processes streams of OnsetStreamPools:
+	// the band cores and buffers every stream of that thread takes turns on.
+	struct OnsetStreamWorker
+	{
+		OnsetStreamWorker();
+
+		// the widest instruction set it may pick (default: the best one)
+		void setMaxISA(OnsetISA) noexcept;
+
+		// appends the stream's onsets to events (can be nullptr) and returns how many.
+		// pool, stream, samples, numChannels, numSamples, events
+		int operator()(const OnsetStreamPool&, OnsetStream&, float**, int, int, OnsetEvents*) noexcept;
+	private:
+		OnsetBands bands;
+		OnsetBuffer buffer, odf;
+		const OnsetStreamPool* pool;
+		const OnsetKernels* kernels;
+		int version;
+
+		// takes the pool's coefficients if they changed
+		// pool
+		void pull(const OnsetStreamPool&) noexcept;
+
+		// stream, samples, numChannels, numSamples (<= BlockSize), events
+		void processBlock(OnsetStream&, float**, int, int, OnsetEvents*) noexcept;
+	};
+}
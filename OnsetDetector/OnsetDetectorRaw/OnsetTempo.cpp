@@ -0,0 +1,190 @@
+#include "OnsetTempo.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dsp
+{
+	namespace
+	{
+		static_assert((OnsetTempo::HistorySize & (OnsetTempo::HistorySize - 1)) == 0,
+			"the history wraps with a mask");
+
+		// seconds the novelty's mean follows
+		static constexpr double MeanSeconds = 1.;
+		// octaves away from the preferred tempo that weigh 1 / sqrt(e)
+		static constexpr double TempoSpread = 1.;
+	}
+
+	OnsetTempo::OnsetTempo() :
+		history(),
+		acf(),
+		weights(),
+		sampleRate(1.),
+		frameRate(1.),
+		lowestTempo(OnsetTempoLowestDefault),
+		highestTempo(OnsetTempoHighestDefault),
+		memory(OnsetTempoMemoryDefault),
+		period(0.),
+		position(0), clock(0), lastBeatFrame(-1),
+		frameSum(0.f), lastFrame(0.f), mean(0.f), meanCoef(0.f), decay(0.f),
+		hop(1), numFrameSamples(0), lagMin(2), lagMax(2)
+	{
+	}
+
+	void OnsetTempo::prepare(double _sampleRate) noexcept
+	{
+		sampleRate = _sampleRate;
+		hop = std::max(1, static_cast<int>(std::round(sampleRate / FrameRate)));
+		frameRate = sampleRate / static_cast<double>(hop);
+		meanCoef = static_cast<float>(1. - std::exp(-1. / (MeanSeconds * frameRate)));
+		setMemory(memory);
+		updateLags();
+		reset();
+	}
+
+	void OnsetTempo::reset() noexcept
+	{
+		history.fill(0.f);
+		acf.fill(0.f);
+		period = 0.;
+		position = clock = 0;
+		lastBeatFrame = -1;
+		frameSum = lastFrame = mean = 0.f;
+		numFrameSamples = 0;
+	}
+
+	void OnsetTempo::setLowestTempo(double bpm) noexcept
+	{
+		lowestTempo = bpm;
+		updateLags();
+	}
+
+	void OnsetTempo::setHighestTempo(double bpm) noexcept
+	{
+		highestTempo = bpm;
+		updateLags();
+	}
+
+	void OnsetTempo::setMemory(double seconds) noexcept
+	{
+		memory = seconds;
+		decay = static_cast<float>(std::exp(-1. / (std::max(memory, 1e-3) * frameRate)));
+	}
+
+	void OnsetTempo::operator()(const float* odf, int numSamples) noexcept
+	{
+		for (auto s = 0; s < numSamples;)
+		{
+			const auto n = std::min(hop - numFrameSamples, numSamples - s);
+			for (auto i = 0; i < n; ++i)
+				frameSum += odf[s + i];
+			s += n;
+			numFrameSamples += n;
+			if (numFrameSamples == hop)
+			{
+				push(frameSum / static_cast<float>(hop));
+				frameSum = 0.f;
+				numFrameSamples = 0;
+			}
+		}
+		position += numSamples;
+	}
+
+	double OnsetTempo::getTempo() const noexcept
+	{
+		return period != 0. ? 60. * frameRate / period : 0.;
+	}
+
+	double OnsetTempo::getBeatPhase() const noexcept
+	{
+		if (period == 0.)
+			return 0.;
+		const auto beatLength = period * static_cast<double>(hop);
+		const auto elapsed = static_cast<double>(position - lastBeatFrame * hop) / beatLength;
+		return elapsed - std::floor(elapsed);
+	}
+
+	int64_t OnsetTempo::getLastBeat() const noexcept
+	{
+		if (period == 0.)
+			return -1;
+		const auto beatLength = period * static_cast<double>(hop);
+		const auto beat = lastBeatFrame * hop;
+		const auto numBeats = std::floor(static_cast<double>(position - beat) / beatLength);
+		return beat + static_cast<int64_t>(numBeats * beatLength);
+	}
+
+	int64_t OnsetTempo::getPosition() const noexcept
+	{
+		return position;
+	}
+
+	void OnsetTempo::updateLags() noexcept
+	{
+		const auto lowest = std::min(lowestTempo, highestTempo);
+		const auto highest = std::max(lowestTempo, highestTempo);
+		lagMin = std::max(2, static_cast<int>(std::floor(60. * frameRate / highest)));
+		lagMax = std::min(LagMax, static_cast<int>(std::ceil(60. * frameRate / lowest)));
+		lagMin = std::min(lagMin, lagMax);
+		// a log-normal around the preferred tempo
+		weights[0] = 0.f;
+		for (auto lag = 1; lag < static_cast<int>(weights.size()); ++lag)
+		{
+			const auto octaves = std::log2(60. * frameRate / static_cast<double>(lag) / OnsetTempoPreferred) / TempoSpread;
+			weights[lag] = static_cast<float>(std::exp(-.5 * octaves * octaves));
+		}
+	}
+
+	void OnsetTempo::push(float frame) noexcept
+	{
+		const auto rise = std::max(frame - lastFrame, 0.f);
+		lastFrame = frame;
+		mean += meanCoef * (rise - mean);
+		const auto x = rise - mean;
+		history[clock & (HistorySize - 1)] = x;
+		// the frames before the first one are 0
+		for (auto lag = 0; lag <= lagMax + 1; ++lag)
+			acf[lag] = decay * acf[lag] + x * history[(clock - lag) & (HistorySize - 1)];
+		++clock;
+		if (clock % UpdateInterval == 0)
+			estimate();
+	}
+
+	void OnsetTempo::estimate() noexcept
+	{
+		if (clock < 2 * lagMax || !(acf[0] > 0.f))
+			return;
+		auto best = lagMin;
+		for (auto lag = lagMin + 1; lag <= lagMax; ++lag)
+			if (acf[lag] * weights[lag] > acf[best] * weights[best])
+				best = lag;
+		if (!(acf[best] > 0.f))
+			return;
+		// the top of a parabola through the lags around it
+		const auto a = acf[best - 1], b = acf[best], c = acf[best + 1];
+		const auto curvature = a - 2.f * b + c;
+		const auto offset = curvature < 0.f ? .5f * (a - c) / curvature : 0.f;
+		period = static_cast<double>(best) + static_cast<double>(std::min(std::max(offset, -.5f), .5f));
+
+		// the frames since the last beat
+		const auto numPhases = static_cast<int>(std::ceil(period));
+		const auto last = clock - 1;
+		auto bestPhase = 0;
+		auto bestSum = 0.f;
+		for (auto phase = 0; phase < numPhases; ++phase)
+		{
+			auto sum = 0.f;
+			for (auto k = 0; k < NumPeriods; ++k)
+			{
+				const auto frame = last - phase - static_cast<int64_t>(std::round(static_cast<double>(k) * period));
+				sum += history[frame & (HistorySize - 1)];
+			}
+			if (phase == 0 || sum > bestSum)
+			{
+				bestSum = sum;
+				bestPhase = phase;
+			}
+		}
+		lastBeatFrame = last - bestPhase;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+namespace dsp
+{
+	static constexpr double OnsetTempoLowestDefault = 40.;
+	static constexpr double OnsetTempoHighestDefault = 240.;
+	// the tempo the estimate leans to when several would fit
+	static constexpr double OnsetTempoPreferred = 120.;
+	static constexpr double OnsetTempoMemoryDefault = 8.;
+
+	// Estimates the tempo and the beat phase from the odf while it streams,
+	// so that they come from the same filterbank pass as the onsets (see
+	// OnsetOdfView). The odf is averaged to novelty frames at about
+	// FrameRate, whose rise (minus its mean) is the novelty curve.
+	// Every frame adds to a leaky autocorrelation of the curve over the
+	// lags of the tempo range. The lag with the most autocorrelation,
+	// weighted towards OnsetTempoPreferred, is the beat period. The beat
+	// phase is where an impulse train of that period collects the most
+	// novelty over the last NumPeriods beats.
+	// Memory is bounded by HistorySize frames. A frame costs one
+	// multiply-add per lag, an estimate every UpdateInterval frames one
+	// add per frame of NumPeriods beats. The plugin's dsp::FFT wraps
+	// juce::dsp::FFT, so it isn't available here, and only the few
+	// hundred lags of the tempo range matter anyway.
+	struct OnsetTempo
+	{
+		// novelty frames per second, roughly
+		static constexpr double FrameRate = 200.;
+		// frames of novelty kept, a power of 2
+		static constexpr int HistorySize = 2048;
+		// beats the phase is searched over
+		static constexpr int NumPeriods = 4;
+		// the longest beat period in frames
+		static constexpr int LagMax = HistorySize / NumPeriods - 1;
+		// frames between two estimates
+		static constexpr int UpdateInterval = 16;
+
+		OnsetTempo();
+
+		// sampleRate, resets
+		void prepare(double) noexcept;
+
+		void reset() noexcept;
+
+		// bpm
+		void setLowestTempo(double) noexcept;
+
+		// bpm
+		void setHighestTempo(double) noexcept;
+
+		// how long a beat period is remembered
+		// seconds
+		void setMemory(double) noexcept;
+
+		// odf, numSamples
+		void operator()(const float*, int) noexcept;
+
+		// bpm, 0 until the history holds two of the longest periods
+		double getTempo() const noexcept;
+
+		// how far the next sample is into its beat [0, 1), 0 until known
+		double getBeatPhase() const noexcept;
+
+		// samples since prepare() of the latest beat before the next
+		// sample, -1 until known
+		int64_t getLastBeat() const noexcept;
+
+		// samples processed since prepare()
+		int64_t getPosition() const noexcept;
+	private:
+		std::array<float, HistorySize> history;
+		// autocorrelation and tempo weight of every lag up to LagMax + 1
+		std::array<float, LagMax + 2> acf, weights;
+		double sampleRate, frameRate, lowestTempo, highestTempo, memory;
+		// beat period in frames, 0 if unknown
+		double period;
+		int64_t position, clock, lastBeatFrame;
+		float frameSum, lastFrame, mean, meanCoef, decay;
+		int hop, numFrameSamples, lagMin, lagMax;
+
+		void updateLags() noexcept;
+
+		// frame (mean of the odf)
+		void push(float) noexcept;
+
+		void estimate() noexcept;
+	};
+}
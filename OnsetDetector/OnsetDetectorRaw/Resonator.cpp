@@ -1,117 +1,265 @@
 #include "Resonator.h"
+#include "OnsetAxiom.h"
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 namespace dsp
 {
+	namespace
+	{
+		int scanResonator(const OnsetKernels& kernels, float* samples, const OnsetResonatorResponse& response,
+			double& z1, double& z2, double* lpY1, int numSamples) noexcept
+		{
+			return kernels.scanResonator(samples, response, z1, z2, lpY1, numSamples);
+		}
+
+		int scanResonator(const OnsetKernels& kernels, float* samples, const OnsetResonatorResponseF& response,
+			float& z1, float& z2, float* lpY1, int numSamples) noexcept
+		{
+			return kernels.scanResonatorF(samples, response, z1, z2, lpY1, numSamples);
+		}
+
+		// the scan until it would clip, then that register sample by sample
+		// resonator, kernels, samples, lpY1 or nullptr, perSample, numSamples
+		template<class Reso, typename Float, typename PerSample>
+		void processBlock(Reso& reso, const OnsetKernels& kernels, const OnsetResonatorResponseT<Float>& response,
+			float* samples, Float* lpY1, PerSample perSample, int numSamples) noexcept
+		{
+			const auto width = LowpassT<Float>::getScanWidth(kernels);
+			// a register of one sample gains nothing over the recurrence
+			auto s = width == 1 ? numSamples : 0;
+			for (auto i = 0; i < s; ++i)
+				samples[i] = static_cast<float>(perSample(static_cast<Float>(samples[i])));
+			while (s < numSamples)
+			{
+				s += scanResonator(kernels, samples + s, response, reso.z1, reso.z2, lpY1, numSamples - s);
+				// the register that clips and the rest that doesn't fill one
+				const auto end = std::min(s + width, numSamples);
+				for (; s < end; ++s)
+					samples[s] = static_cast<float>(perSample(static_cast<Float>(samples[s])));
+			}
+		}
+	}
+
 	// ResonatorBase
 
-	ResonatorBase::ResonatorBase() :
+	template<typename Float, class Derived>
+	ResonatorBaseT<Float, Derived>::ResonatorBaseT() :
 		fc(0.), bw(0.)
 	{}
 
-	void ResonatorBase::setCutoffFc(double _fc) noexcept
+	template<typename Float, class Derived>
+	void ResonatorBaseT<Float, Derived>::setCutoffFc(double _fc) noexcept
 	{
 		fc = _fc;
 	}
 
-	void ResonatorBase::setCutoffFc(float _fc) noexcept
+	template<typename Float, class Derived>
+	void ResonatorBaseT<Float, Derived>::setCutoffFc(float _fc) noexcept
 	{
 		fc = static_cast<double>(_fc);
 	}
 
-	void ResonatorBase::setBandwidth(double _bw) noexcept
+	template<typename Float, class Derived>
+	void ResonatorBaseT<Float, Derived>::setBandwidth(double _bw) noexcept
 	{
 		bw = _bw;
 	}
 
-	void ResonatorBase::setBandwidth(float _bw) noexcept
+	template<typename Float, class Derived>
+	void ResonatorBaseT<Float, Derived>::setBandwidth(float _bw) noexcept
 	{
 		bw = static_cast<double>(_bw);
 	}
 
-	double ResonatorBase::distort(double y) const noexcept
+	template<typename Float, class Derived>
+	bool ResonatorBaseT<Float, Derived>::fitsFloat() const noexcept
 	{
-		return y > 1. ? 1. : y < -1. ? -1. : y;
-	}
-
-	double ResonatorBase::operator()(float x) noexcept
-	{
-		return operator()(static_cast<double>(x));
+		static constexpr double Pi = 3.14159265358979323846;
+		static constexpr double TauD = 2. * Pi;
+		// half an ulp, relative to the value
+		const auto roundoff = .5 * static_cast<double>(std::numeric_limits<float>::epsilon());
+		const auto shift = roundoff / std::abs(std::tan(TauD * fc));
+		return shift < .1 * TauD * bw;
 	}
 
 	// Resonator2
 
-	Resonator2::Resonator2() :
-		ResonatorBase(),
+	template<typename Float, class Derived>
+	Resonator2T<Float, Derived>::Resonator2T() :
+		Base(),
 		b2(0.), b1(0.), a0(0.),
 		z1(0.), z2(0.)
 	{}
 
-	void Resonator2::reset() noexcept
+	template<typename Float, class Derived>
+	void Resonator2T<Float, Derived>::reset() noexcept
 	{
-		z1 = 0.;
-		z2 = 0.;
+		z1 = z2 = static_cast<Float>(0.);
 	}
 
-	void Resonator2::update() noexcept
+	template<typename Float, class Derived>
+	void Resonator2T<Float, Derived>::update() noexcept
 	{
 		static constexpr double Pi = 3.14159265358979323846;
 		static constexpr double TauD = 2. * Pi;
-		b2 = std::exp(-TauD * bw);
-		const auto fcTau = TauD * fc;
-		const auto b2_4 = 4. * b2;
+		// designed in double, whatever Float is
+		const auto b2D = std::exp(-TauD * this->bw);
+		const auto fcTau = TauD * this->fc;
+		const auto b2_4 = 4. * b2D;
 		const auto cosFc = std::cos(fcTau);
-		b1 = (-b2_4 / (1. + b2)) * cosFc;
-		const auto sqrtVal = static_cast<float>(1. - b1 * b1 / b2_4);
-		a0 = (1. - b2) * std::sqrt(sqrtVal);
+		const auto b1D = (-b2_4 / (1. + b2D)) * cosFc;
+		const auto sqrtVal = static_cast<float>(1. - b1D * b1D / b2_4);
+		b2 = static_cast<Float>(b2D);
+		b1 = static_cast<Float>(b1D);
+		a0 = static_cast<Float>((1. - b2D) * std::sqrt(sqrtVal));
 	}
 
-	void Resonator2::copyFrom(const Resonator2& other) noexcept
+	template<typename Float, class Derived>
+	void Resonator2T<Float, Derived>::copyFrom(const Resonator2T& other) noexcept
 	{
 		b2 = other.b2;
 		b1 = other.b1;
 		a0 = other.a0;
 	}
 
-	double Resonator2::operator()(double x) noexcept
+	template<typename Float, class Derived>
+	void Resonator2T<Float, Derived>::operator()(const OnsetKernels& kernels,
+		const OnsetResonatorResponseT<Float>& response, float* samples, int numSamples) noexcept
+	{
+		processBlock(*this, kernels, response, samples, static_cast<Float*>(nullptr),
+			[this](Float x) { return Resonator2T::operator()(x); }, numSamples);
+	}
+
+	template<typename Float, class Derived>
+	void Resonator2T<Float, Derived>::getResponse(OnsetResonatorResponseT<Float>& response) const noexcept
 	{
-		auto y =
-			a0 * x
-			- b1 * z1
-			- b2 * z2;
-		y = distort(y);
-		z2 = z1;
-		z1 = y;
-		return y;
+		// the recurrence without clipping from an impulse and from either
+		// state alone, with the coefficients as they are processed
+		const auto a0D = static_cast<double>(a0);
+		const auto b1D = static_cast<double>(b1);
+		const auto b2D = static_cast<double>(b2);
+		auto h1 = 0., h2 = 0., u1 = 1., u2 = 0., v1 = 0., v2 = 1.;
+		for (auto k = 0; k < OnsetMaxLanes; ++k)
+		{
+			const auto h = (k == 0 ? a0D : 0.) - b1D * h1 - b2D * h2;
+			const auto u = -b1D * u1 - b2D * u2;
+			const auto v = -b1D * v1 - b2D * v2;
+			h2 = h1;
+			h1 = h;
+			u2 = u1;
+			u1 = u;
+			v2 = v1;
+			v1 = v;
+			response.impulse[k] = static_cast<Float>(0.);
+			response.impulse[OnsetMaxLanes + k] = static_cast<Float>(h);
+			response.fromZ1[k] = static_cast<Float>(u);
+			response.fromZ2[k] = static_cast<Float>(v);
+		}
 	}
 
 	// Resonator3
 
-	void Resonator3::reset() noexcept
+	template<typename Float>
+	void Resonator3T<Float>::reset() noexcept
 	{
-		Resonator2::reset();
+		Base::reset();
 		lp.reset();
 	}
 
-	void Resonator3::update() noexcept
+	template<typename Float>
+	void Resonator3T<Float>::update() noexcept
+	{
+		Base::update();
+		lp.makeFromDecayInFc(this->fc);
+	}
+
+	template<typename Float>
+	void Resonator3T<Float>::matchHighpass(int decimation) noexcept
 	{
-		Resonator2::update();
-		lp.makeFromDecayInFc(fc);
+		static constexpr double Pi = 3.14159265358979323846;
+		// the highpass' gain at w is x * c / |1 - x * e^-jw|, c = 2sin(w/2)
+		const auto w = 2. * Pi * this->fc;
+		const auto wFull = w / static_cast<double>(decimation);
+		const auto xFull = LowpassT<Float>::getXFromFc(this->fc / static_cast<double>(decimation));
+		const auto cFull = 2. * std::sin(.5 * wFull);
+		const auto g = xFull * cFull / std::sqrt(1. - 2. * xFull * std::cos(wFull) + xFull * xFull);
+		// solved for x at w
+		const auto c = 2. * std::sin(.5 * w);
+		const auto cosHalf = std::cos(.5 * w);
+		const auto x = g / (g * std::cos(w) + c * std::sqrt(1. - g * g * cosHalf * cosHalf));
+		lp.setX(x);
 	}
 
-	void Resonator3::copyFrom(const Resonator3& other) noexcept
+	template<typename Float>
+	void Resonator3T<Float>::copyFrom(const Resonator3T& other) noexcept
 	{
-		Resonator2::copyFrom(other);
+		Base::copyFrom(other);
 		lp.copyCutoffFrom(other.lp);
 	}
 
-	double Resonator3::operator()(double x) noexcept
+	template<typename Float>
+	void Resonator3T<Float>::operator()(const OnsetKernels& kernels,
+		const OnsetResonatorResponseT<Float>& response, float* samples, int numSamples) noexcept
+	{
+		processBlock(*this, kernels, response, samples, &lp.y1,
+			[this](Float x) { return Resonator3T::operator()(x); }, numSamples);
+	}
+
+	template<typename Float>
+	void Resonator3T<Float>::getResponse(OnsetResonatorResponseT<Float>& response) const noexcept
+	{
+		Base::getResponse(response);
+		// the lowpass of those same three responses, and of its own state
+		const auto a0D = static_cast<double>(lp.a0);
+		const auto b1D = static_cast<double>(lp.b1);
+		auto h1 = 0., u1 = 0., v1 = 0., w1 = 1.;
+		for (auto k = 0; k < OnsetMaxLanes; ++k)
+		{
+			h1 = a0D * static_cast<double>(response.impulse[OnsetMaxLanes + k]) + b1D * h1;
+			u1 = a0D * static_cast<double>(response.fromZ1[k]) + b1D * u1;
+			v1 = a0D * static_cast<double>(response.fromZ2[k]) + b1D * v1;
+			w1 *= b1D;
+			response.lowImpulse[k] = static_cast<Float>(0.);
+			response.lowImpulse[OnsetMaxLanes + k] = static_cast<Float>(h1);
+			response.lowFromZ1[k] = static_cast<Float>(u1);
+			response.lowFromZ2[k] = static_cast<Float>(v1);
+			response.lowFromY1[k] = static_cast<Float>(w1);
+		}
+	}
+
+	template<typename Float>
+	const LowpassT<Float>& Resonator3T<Float>::getLowpass() const noexcept
 	{
-		auto y = Resonator2::operator()(x);
-		y -= lp(y);
-		return y;
+		return lp;
 	}
 
+	template<typename Float>
+	void Resonator3T<Float>::setLowpassX(double x) noexcept
+	{
+		lp.setX(x);
+	}
+
+	template<typename Float>
+	void Resonator3T<Float>::setState(double z1, double z2, double lpY1) noexcept
+	{
+		this->z1 = static_cast<Float>(z1);
+		this->z2 = static_cast<Float>(z2);
+		lp.y1 = static_cast<Float>(lpY1);
+	}
+
+	template struct ResonatorBaseT<double, Resonator2T<double>>;
+	template struct ResonatorBaseT<float, Resonator2T<float>>;
+	template struct ResonatorBaseT<double, Resonator3T<double>>;
+	template struct ResonatorBaseT<float, Resonator3T<float>>;
+	template struct Resonator2T<double>;
+	template struct Resonator2T<float>;
+	template struct Resonator2T<double, Resonator3T<double>>;
+	template struct Resonator2T<float, Resonator3T<float>>;
+	template struct Resonator3T<double>;
+	template struct Resonator3T<float>;
+
 	// ResonatorStereo
 
 	template<class ResoClass>
@@ -1,14 +1,24 @@
 #pragma once
 #include <array>
+#include <type_traits>
 #include "Smooth.h"
 
 namespace dsp
 {
-	struct ResonatorBase
+	// What every resonator shares. Derived is the resonator itself
+	// (CRTP), so nothing is virtual and the per-sample calls resolve at
+	// compile time. Derived provides reset(), update() and
+	// operator()(Float), the latter inline in this header (see below).
+	// Float is the type of the coefficients and state while processing,
+	// the coefficients are always designed in double.
+	template<typename Float, class Derived>
+	struct ResonatorBaseT
 	{
-		ResonatorBase();
-		
-		virtual void reset() noexcept = 0;
+		using SampleType = Float;
+		// the sample type that isn't Float
+		using Other = typename LowpassT<Float>::Other;
+
+		ResonatorBaseT();
 
 		// fc [0, .5]
 		void setCutoffFc(double) noexcept;
@@ -22,50 +32,141 @@ namespace dsp
 		// bw [0, .5]
 		void setBandwidth(float) noexcept;
 
-		virtual void update() noexcept = 0;
-
-		virtual double operator()(double) noexcept = 0;
+		// converts x and calls Derived::operator()(Float)
+		Float operator()(Other) noexcept;
 
-		double operator()(float) noexcept;
+		// if the coefficients can be stored as floats. rounding b1 to float
+		// moves the centre by about 2^-24 / tan(2pi * fc) radians, which must
+		// stay below a tenth of the bandwidth. that fails first for narrow
+		// bands far below the nyquist, like the lowest ones at high sample rates.
+		bool fitsFloat() const noexcept;
 
 		double fc, bw;
 	protected:
-		double distort(double y) const noexcept;
+		Float distort(Float y) const noexcept;
 	};
 
 	// https://github.com/julianksdj/Resonator2pole/tree/main
-	struct Resonator2 :
-		public ResonatorBase
+	// Derived is void, unless a resonator extends this one (see Resonator3T).
+	template<typename Float, class Derived = void>
+	struct Resonator2T :
+		public ResonatorBaseT<Float, typename std::conditional<std::is_void<Derived>::value,
+			Resonator2T<Float, Derived>, Derived>::type>
 	{
-		Resonator2();
+		using Base = ResonatorBaseT<Float, typename std::conditional<std::is_void<Derived>::value,
+			Resonator2T<Float, Derived>, Derived>::type>;
+		using Base::operator();
+
+		Resonator2T();
+
+		void reset() noexcept;
+
+		void update() noexcept;
 
-		void reset() noexcept override;
+		void copyFrom(const Resonator2T&) noexcept;
 
-		void update() noexcept override;
+		Float operator()(Float) noexcept;
 
-		void copyFrom(const Resonator2&) noexcept;
+		// block mode: whole registers run on the kernels' state-space
+		// ScanResonator, the ones that would clip go sample by sample.
+		// the response is the caller's, so that only block users keep one.
+		// kernels, response (from getResponse), samples, numSamples
+		void operator()(const OnsetKernels&, const OnsetResonatorResponseT<Float>&, float*, int) noexcept;
 
-		double operator()(double) noexcept override;
+		// the block mode's response for a0, b1 and b2. whoever changes
+		// them has to get it again.
+		// response
+		void getResponse(OnsetResonatorResponseT<Float>&) const noexcept;
 
-		double b2, b1, a0;
-		double z1, z2;
+		Float b2, b1, a0;
+		Float z1, z2;
 	};
 
 	// like Resonator2, but with an added highpass filter
-	struct Resonator3 :
-		public Resonator2
+	template<typename Float>
+	struct Resonator3T :
+		public Resonator2T<Float, Resonator3T<Float>>
 	{
-		void reset() noexcept override;
+		using Base = Resonator2T<Float, Resonator3T<Float>>;
+		using Base::operator();
+
+		void reset() noexcept;
+
+		void update() noexcept;
+
+		// for a resonator that runs at 1/decimation of the rate it stands
+		// in for: moves the highpass' pole so that its gain at fc is the
+		// one it has at that rate. The pole's design loses gain as fc
+		// nears the nyquist (0.70 far below it, 0.47 at an 8th of the rate).
+		// call it after update().
+		// decimation
+		void matchHighpass(int) noexcept;
+
+		void copyFrom(const Resonator3T&) noexcept;
 
-		void update() noexcept override;
+		Float operator()(Float) noexcept;
 
-		void copyFrom(const Resonator3&) noexcept;
+		// Resonator2T's block mode with the highpass in the same registers
+		// kernels, response (from getResponse), samples, numSamples
+		void operator()(const OnsetKernels&, const OnsetResonatorResponseT<Float>&, float*, int) noexcept;
 
-		double operator()(double) noexcept override;
+		// Resonator2T's, plus the lowpass' part
+		// response
+		void getResponse(OnsetResonatorResponseT<Float>&) const noexcept;
+
+		const LowpassT<Float>& getLowpass() const noexcept;
+
+		// x
+		void setLowpassX(double) noexcept;
+
+		// z1, z2, lpY1
+		void setState(double, double, double) noexcept;
 	protected:
-		Lowpass lp;
+		LowpassT<Float> lp;
 	};
 
+	using Resonator2 = Resonator2T<double>;
+	using Resonator3 = Resonator3T<double>;
+	using Resonator2F = Resonator2T<float>;
+	using Resonator3F = Resonator3T<float>;
+
+	// per sample. defined here, so that the loops around them can inline
+	// the whole filter.
+
+	template<typename Float, class Derived>
+	inline Float ResonatorBaseT<Float, Derived>::operator()(Other x) noexcept
+	{
+		return static_cast<Derived&>(*this)(static_cast<Float>(x));
+	}
+
+	template<typename Float, class Derived>
+	inline Float ResonatorBaseT<Float, Derived>::distort(Float y) const noexcept
+	{
+		const auto one = static_cast<Float>(1.);
+		return y > one ? one : y < -one ? -one : y;
+	}
+
+	template<typename Float, class Derived>
+	inline Float Resonator2T<Float, Derived>::operator()(Float x) noexcept
+	{
+		auto y =
+			a0 * x
+			- b1 * z1
+			- b2 * z2;
+		y = this->distort(y);
+		z2 = z1;
+		z1 = y;
+		return y;
+	}
+
+	template<typename Float>
+	inline Float Resonator3T<Float>::operator()(Float x) noexcept
+	{
+		auto y = Base::operator()(x);
+		y -= lp(y);
+		return y;
+	}
+
 	template<class ResoClass>
 	struct ResonatorStereo
 	{
@@ -3,34 +3,83 @@
 
 namespace dsp
 {
+	namespace
+	{
+		int scanLowpass(const OnsetKernels& kernels, float* buffer, double a0, double b1,
+			double& y1, OnsetScanBound bound, int numSamples) noexcept
+		{
+			return kernels.scanLowpass(buffer, a0, b1, y1, bound, numSamples);
+		}
+
+		int scanLowpass(const OnsetKernels& kernels, float* buffer, float a0, float b1,
+			float& y1, OnsetScanBound bound, int numSamples) noexcept
+		{
+			return kernels.scanLowpassF(buffer, a0, b1, y1, bound, numSamples);
+		}
+
+		int getWidth(const OnsetKernels& kernels, double) noexcept
+		{
+			return kernels.width;
+		}
+
+		int getWidth(const OnsetKernels& kernels, float) noexcept
+		{
+			return kernels.widthF;
+		}
+
+		template<typename Float>
+		void filter(LowpassT<Float>& lp, float* buffer, int numSamples) noexcept
+		{
+			lp.scan(selectOnsetKernels(), buffer, OnsetScanBound::None, numSamples);
+		}
+
+		template<typename Float>
+		void filter(LowpassT<Float>& lp, double* buffer, int numSamples) noexcept
+		{
+			for (auto s = 0; s < numSamples; ++s)
+				buffer[s] = static_cast<double>(lp.processSample(buffer[s]));
+		}
+	}
+
 	// Lowpass static
 
-	double Lowpass::getXFromFc(double fc) noexcept
+	template<typename Float>
+	int LowpassT<Float>::getScanWidth(const OnsetKernels& kernels) noexcept
+	{
+		return getWidth(kernels, Float());
+	}
+
+	template<typename Float>
+	double LowpassT<Float>::getXFromFc(double fc) noexcept
 	{
 		static constexpr double Pi = 3.14159265358979323846;
 		constexpr double TauD = 2. * Pi;
 		return std::exp(-TauD * fc);
 	}
 
-	double Lowpass::getXFromHz(double hz, double Fs) noexcept
+	template<typename Float>
+	double LowpassT<Float>::getXFromHz(double hz, double Fs) noexcept
 	{
 		return getXFromFc(hz / Fs);
 	}
 
-	double Lowpass::getXFromSamples(double lengthSamples) noexcept
+	template<typename Float>
+	double LowpassT<Float>::getXFromSamples(double lengthSamples) noexcept
 	{
 		const auto dInv = -1. / lengthSamples;
 		const auto dExp = std::exp(dInv);
 		return dExp;
 	}
 
-	double Lowpass::getXFromSecs(double secs, double Fs) noexcept
+	template<typename Float>
+	double LowpassT<Float>::getXFromSecs(double secs, double Fs) noexcept
 	{
 		const auto lengthSamples = secs * Fs;
 		return getXFromSamples(lengthSamples);
 	}
 
-	double Lowpass::getXFromMs(double ms, double Fs) noexcept
+	template<typename Float>
+	double LowpassT<Float>::getXFromMs(double ms, double Fs) noexcept
 	{
 		const auto secs = ms * .001;
 		return getXFromSecs(secs, Fs);
@@ -38,12 +87,12 @@ namespace dsp
 
 	// Lowpass
 
-	void Lowpass::makeFromDecayInSamples(double d) noexcept
+	template<typename Float>
+	void LowpassT<Float>::makeFromDecayInSamples(double d) noexcept
 	{
 		if (d == 0.)
 		{
-			a0 = 1.;
-			b1 = 0.;
+			setX(0.);
 			return;
 		}
 		const auto dInv = -1. / d;
@@ -51,103 +100,96 @@ namespace dsp
 		setX(dExp);
 	}
 
-	void Lowpass::makeFromDecayInFc(double fc) noexcept
+	template<typename Float>
+	void LowpassT<Float>::makeFromDecayInFc(double fc) noexcept
 	{
 		setX(getXFromFc(fc));
 	}
 
-	void Lowpass::makeFromDecayInHz(double hz, double Fs) noexcept
+	template<typename Float>
+	void LowpassT<Float>::makeFromDecayInHz(double hz, double Fs) noexcept
 	{
 		setX(getXFromHz(hz, Fs));
 	}
 
-	void Lowpass::makeFromDecayInSecs(double d, double Fs) noexcept
+	template<typename Float>
+	void LowpassT<Float>::makeFromDecayInSecs(double d, double Fs) noexcept
 	{
 		makeFromDecayInSamples(d * Fs);
 	}
 
-	void Lowpass::makeFromDecayInSecs(float d, float Fs) noexcept
+	template<typename Float>
+	void LowpassT<Float>::makeFromDecayInSecs(float d, float Fs) noexcept
 	{
 		makeFromDecayInSecs(static_cast<double>(d), static_cast<double>(Fs));
 	}
 
-	void Lowpass::makeFromDecayInMs(double d, double Fs) noexcept
+	template<typename Float>
+	void LowpassT<Float>::makeFromDecayInMs(double d, double Fs) noexcept
 	{
 		makeFromDecayInSecs(d * .001, Fs);
 	}
 
-	void Lowpass::makeFromDecayInMs(float d, float Fs) noexcept
+	template<typename Float>
+	void LowpassT<Float>::makeFromDecayInMs(float d, float Fs) noexcept
 	{
 		makeFromDecayInMs(static_cast<double>(d), static_cast<double>(Fs));
 	}
 
-	void Lowpass::copyCutoffFrom(const Lowpass& other) noexcept
+	template<typename Float>
+	void LowpassT<Float>::copyCutoffFrom(const LowpassT& other) noexcept
 	{
 		a0 = other.a0;
 		b1 = other.b1;
 	}
 
-	Lowpass::Lowpass(double _startVal) :
-		a0(1.),
-		b1(0.),
-		y1(_startVal),
-		startVal(_startVal)
+	template<typename Float>
+	LowpassT<Float>::LowpassT(double _startVal) :
+		a0(static_cast<Float>(1.)),
+		b1(static_cast<Float>(0.)),
+		y1(static_cast<Float>(_startVal)),
+		startVal(static_cast<Float>(_startVal))
 	{}
 
-	void Lowpass::reset()
+	template<typename Float>
+	void LowpassT<Float>::reset()
 	{
 		reset(startVal);
 	}
 
-	void Lowpass::reset(double v)
+	template<typename Float>
+	void LowpassT<Float>::reset(double v)
 	{
-		y1 = v;
+		y1 = static_cast<Float>(v);
 	}
 
-	void Lowpass::operator()(double* buffer, double val, int numSamples) noexcept
+	template<typename Float>
+	void LowpassT<Float>::operator()(Float* buffer, Float val, int numSamples) noexcept
 	{
 		for (auto s = 0; s < numSamples; ++s)
 			buffer[s] = processSample(val);
 	}
 
-	void Lowpass::operator()(double* buffer, int numSamples) noexcept
-	{
-		for (auto s = 0; s < numSamples; ++s)
-		{
-			const auto y = processSample(buffer[s]);
-			buffer[s] = y;
-		}
-	}
-
-	void Lowpass::operator()(float* buffer, int numSamples) noexcept
+	template<typename Float>
+	void LowpassT<Float>::operator()(Float* buffer, int numSamples) noexcept
 	{
-		for (auto s = 0; s < numSamples; ++s)
-		{
-			const auto y = processSample(buffer[s]);
-			buffer[s] = static_cast<float>(y);
-		}
+		filter(*this, buffer, numSamples);
 	}
 
-	double Lowpass::operator()(double sample) noexcept
+	template<typename Float>
+	void LowpassT<Float>::operator()(Other* buffer, int numSamples) noexcept
 	{
-		return processSample(sample);
+		filter(*this, buffer, numSamples);
 	}
 
-	double Lowpass::processSample(double x0) noexcept
+	template<typename Float>
+	int LowpassT<Float>::scan(const OnsetKernels& kernels, float* buffer,
+		OnsetScanBound bound, int numSamples) noexcept
 	{
-		y1 = x0 * a0 + y1 * b1;
-		return y1;
+		return scanLowpass(kernels, buffer, a0, b1, y1, bound, numSamples);
 	}
 
-	double Lowpass::processSample(float x0) noexcept
-	{
-		return processSample(static_cast<double>(x0));
-	}
-
-	void Lowpass::setX(double x) noexcept
-	{
-		a0 = 1. - x;
-		b1 = x;
-	}
+	template struct LowpassT<double>;
+	template struct LowpassT<float>;
 
 }
\ No newline at end of file
@@ -1,9 +1,17 @@
 #pragma once
+#include "OnsetKernels.h"
+#include <type_traits>
 
 namespace dsp
 {
-	struct Lowpass
+	// One-pole lowpass. The coefficients are always designed in double,
+	// Float is what they and the state are stored and processed in.
+	template<typename Float>
+	struct LowpassT
 	{
+		// the sample type that isn't Float
+		using Other = typename std::conditional<std::is_same<Float, double>::value, float, double>::type;
+
 		// decay
 		static double getXFromFc(double) noexcept;
 		// decay, Fs
@@ -30,10 +38,10 @@ namespace dsp
 		// decay, Fs
 		void makeFromDecayInMs(float, float) noexcept;
 
-		void copyCutoffFrom(const Lowpass&) noexcept;
+		void copyCutoffFrom(const LowpassT&) noexcept;
 
 		// startVal
-		Lowpass(double = 0.);
+		LowpassT(double = 0.);
 
 		// resets to startVal
 		void reset();
@@ -42,23 +50,69 @@ namespace dsp
 		void reset(double);
 
 		// buffer, val, numSamples
-		void operator()(double*, double, int) noexcept;
+		void operator()(Float*, Float, int) noexcept;
 
+		// float buffers are filtered a register at a time (see scan)
 		// buffer, numSamples
-		void operator()(double*, int) noexcept;
+		void operator()(Float*, int) noexcept;
 
 		// buffer, numSamples
-		void operator()(float*, int) noexcept;
+		void operator()(Other*, int) noexcept;
+
+		// filters whole registers of samples at once with the kernels'
+		// ScanLowpass. returns how many samples it filtered.
+		// a standalone block API: no engine calls it. OnsetCoreT's fused
+		// pass runs its envelopes per sample, where attack and decay
+		// switch every few samples, only EnvelopeFollowerT's block
+		// operator() and the stage benchmark scan.
+		// kernels, buffer, bound, numSamples
+		int scan(const OnsetKernels&, float*, OnsetScanBound, int) noexcept;
+
+		// the samples per register of scan
+		// kernels
+		static int getScanWidth(const OnsetKernels&) noexcept;
 
 		// val
-		double operator()(double) noexcept;
+		Float operator()(Float) noexcept;
 
 		void setX(double) noexcept;
 
-		double a0, b1, y1, startVal;
+		Float a0, b1, y1, startVal;
 
-		double processSample(double) noexcept;
+		Float processSample(Float) noexcept;
 
-		double processSample(float) noexcept;
+		Float processSample(Other) noexcept;
 	};
+
+	using Lowpass = LowpassT<double>;
+	using LowpassF = LowpassT<float>;
+
+	// per sample, or between samples like the envelopes' attack and decay
+	// switches. defined here, so that the loops around them can inline them.
+
+	template<typename Float>
+	inline void LowpassT<Float>::setX(double x) noexcept
+	{
+		a0 = static_cast<Float>(1. - x);
+		b1 = static_cast<Float>(x);
+	}
+
+	template<typename Float>
+	inline Float LowpassT<Float>::operator()(Float sample) noexcept
+	{
+		return processSample(sample);
+	}
+
+	template<typename Float>
+	inline Float LowpassT<Float>::processSample(Float x0) noexcept
+	{
+		y1 = x0 * a0 + y1 * b1;
+		return y1;
+	}
+
+	template<typename Float>
+	inline Float LowpassT<Float>::processSample(Other x0) noexcept
+	{
+		return processSample(static_cast<Float>(x0));
+	}
 }
\ No newline at end of file
@@ -1,12 +1,975 @@
 #include "OnsetDetector.h"
+#include "OnsetAudioReader.h"
+#include "OnsetBenchmark.h"
+#include "OnsetCorpus.h"
+#include "OnsetEvaluation.h"
+#include "OnsetParallelAnalyzer.h"
+#include "OnsetTempo.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
 
-int main()
+namespace
 {
-	dsp::OnsetDetector onsetDetector;
-	onsetDetector.onOnset = [](int onsetIndex)
+	using Clock = std::chrono::steady_clock;
+
+	enum class OutputFormat { Text, CSV, JSONL };
+
+	struct Options
+	{
+		Options() :
+			path(nullptr),
+			rawFormat(dsp::OnsetSampleFormat::F32),
+			rawSampleRate(0.),
+			rawNumChannels(1),
+			output(OutputFormat::Text),
+			chunkSize(1 << 16),
+			blockSize(dsp::BlockSize),
+			engine(dsp::OnsetEngine::Cores),
+			precision(dsp::OnsetPrecision::Mixed),
+			math(dsp::OnsetMath::Exact),
+			thresholdMode(dsp::OnsetThresholdMode::Fixed),
+			maxISA(dsp::OnsetISA::AVX512),
+			attack(dsp::OnsetAtkDefault),
+			decay(dsp::OnsetDcyDefault),
+			bandwidth(dsp::OnsetBandwidthDefault),
+			holdLength(dsp::OnsetHoldDefault),
+			lowestPitch(dsp::freqHzToNote(dsp::OnsetLowestFreqHz)),
+			highestPitch(dsp::freqHzToNote(dsp::OnsetHighestFreqHz)),
+			peakWindow(dsp::OnsetPeakWindowDefault),
+			peakLookBack(dsp::OnsetPeakLookBackDefault),
+			tilt(dsp::OnsetTiltDefault),
+			threshold(dsp::OnsetThresholdDefault),
+			peakSpread(dsp::OnsetPeakSpreadDefault),
+			numBands(static_cast<int>(dsp::OnsetNumBandsDefault)),
+			groupMasks(),
+			numGroups(0),
+			numThreads(-1),
+			benchSeconds(1.),
+			benchRepeats(3),
+			evalSeconds(20.),
+			evalWindow(50.),
+			evalTolerance(.02),
+			evalLatency(1.),
+			raw(false),
+			stats(false),
+			tempo(false),
+			bandMasks(false),
+			bench(false),
+			evaluate(false)
+		{
+		}
+
+		const char* path;
+		dsp::OnsetSampleFormat rawFormat;
+		double rawSampleRate;
+		int rawNumChannels;
+		OutputFormat output;
+		int chunkSize, blockSize;
+		dsp::OnsetEngine engine;
+		dsp::OnsetPrecision precision;
+		dsp::OnsetMath math;
+		dsp::OnsetThresholdMode thresholdMode;
+		dsp::OnsetISA maxISA;
+		// the detector's parameters, in the units of the plugin's parameters
+		double attack, decay, bandwidth, holdLength, lowestPitch, highestPitch;
+		double peakWindow, peakLookBack;
+		float tilt, threshold, peakSpread;
+		int numBands;
+		// bit i: band i
+		uint32_t groupMasks[dsp::OnsetNumGroupsMax];
+		int numGroups;
+		// -1 streams on one thread, else the whole input is loaded and
+		// analysed in parallel (0: every hardware thread)
+		int numThreads;
+		double benchSeconds;
+		int benchRepeats;
+		// corpus length per case, match window and allowed losses
+		double evalSeconds, evalWindow, evalTolerance, evalLatency;
+		bool raw, stats, tempo, bandMasks, bench, evaluate;
+	};
+
+	void printUsage()
+	{
+		const Options d;
+		std::printf(
+			"usage: OnsetDetectorRaw [options] <file.wav | ->\n"
+			"       OnsetDetectorRaw --bench [options]\n"
+			"       OnsetDetectorRaw --evaluate [options]\n"
+			"\n"
+			"Streams a WAV file (or raw pcm with --raw) through the onset detector\n"
+			"and writes every onset as soon as it is found. '-' reads from stdin.\n"
+			"Only the first two channels are analysed (their mid).\n"
+			"\n"
+			"input:\n"
+			"  --raw                 headerless interleaved pcm\n"
+			"  --rate <hz>           sample rate of raw pcm (and of the corpus)\n"
+			"  --channels <n>        channels of raw pcm (default %d)\n"
+			"  --format <fmt>        s16, s24, s32, f32 or f64 (raw pcm, default f32)\n"
+			"  --chunk <frames>      frames read and processed at once (default %d)\n"
+			"  --threads <n>         load the whole input and analyse it on n threads\n"
+			"                        (0: all), onsets are written at the end\n"
+			"\n"
+			"output:\n"
+			"  --output <fmt>        text, csv or jsonl (default text)\n"
+			"  --stats               realtime factor and samples/s on stderr\n"
+			"  --tempo               tempo and beat phase at the end on stderr, from the\n"
+			"                        detector's odf (not with --threads)\n"
+			"  --band-masks          every onset lists the bands that topped the\n"
+			"                        threshold on their own (not with --threads)\n"
+			"  --band-groups <list>  bands that also trigger as a group, like 0-3,4-7,8-11\n"
+			"                        or 0+2,1+3 (up to %d groups, not with --threads)\n"
+			"\n"
+			"detector:\n"
+			"  --attack <x>          attack order [%d, %d] (default %g)\n"
+			"  --decay <x>           decay order [%d, %d] (default %g)\n"
+			"  --tilt <db>           [%d, %d] (default %g)\n"
+			"  --threshold <db>      [%d, %d] (default %g)\n"
+			"  --hold <ms>           [%d, %d] (default %g)\n"
+			"  --threshold-mode <name> fixed: onsets where the odf crosses the threshold,\n"
+			"                        adaptive: at the odf's peaks above the threshold and\n"
+			"                        above the window's median plus spread (default fixed)\n"
+			"  --peak-window <ms>    the adaptive threshold's window (default %g)\n"
+			"  --peak-spread <x>     median absolute deviations above the median (default %g)\n"
+			"  --peak-lookback <ms>  how long a peak must be the highest (default %g)\n"
+			"  --bandwidth <x>       bandwidth order [%d, %d] (default %g)\n"
+			"  --bands <n>           [1, %d] (default %d)\n"
+			"  --lowest-pitch <note> midi note of the lowest band (default %.2f)\n"
+			"  --highest-pitch <note> midi note of the highest band (default %.2f)\n"
+			"  --engine <name>       cores, bank or multirate (default cores)\n"
+			"  --precision <name>    double or mixed: the bank's bands that allow it\n"
+			"                        run in float (default mixed)\n"
+			"  --math <name>         exact or fast: the bank sums its bands in one pass\n"
+			"                        and the odf is compared squared (default exact)\n"
+			"  --isa <name>          widest instruction set: scalar, sse2, avx2 or avx512\n"
+			"  --block <n>           internal block size: 32, 64, 128 or 256 (default %d)\n"
+			"\n"
+			"benchmark:\n"
+			"  --bench               time every stage of the pipeline for 1 to 16 bands,\n"
+			"                        every block size, 44.1 to 192khz and silence, noise\n"
+			"                        and drums, and write the results as json\n"
+			"  --bench-seconds <s>   input length per measurement (default %g)\n"
+			"  --bench-repeats <n>   runs per measurement, the fastest counts (default %d)\n"
+			"\n"
+			"evaluation:\n"
+			"  --evaluate            run the reference (cores, scalar, block %d) and the\n"
+			"                        detector set by the options over a synthetic corpus,\n"
+			"                        score both against the true onsets and fail if the\n"
+			"                        detector is worse than the reference, or if its\n"
+			"                        checkpoints don't restore to the same detector\n"
+			"  --eval-seconds <s>    length of every corpus signal (default %g)\n"
+			"  --eval-window <ms>    how far an onset may be from the true one (default %g)\n"
+			"  --eval-tolerance <x>  how much lower the f-measure may be (default %g)\n"
+			"  --eval-latency <ms>   how much the mean timing error may move (default %g)\n",
+			d.rawNumChannels, d.chunkSize, dsp::OnsetNumGroupsMax,
+			dsp::OnsetTimeMin, dsp::OnsetTimeMax, d.attack,
+			dsp::OnsetTimeMin, dsp::OnsetTimeMax, d.decay,
+			dsp::OnsetTiltMin, dsp::OnsetTiltMax, static_cast<double>(d.tilt),
+			dsp::OnsetThresholdMin, dsp::OnsetThresholdMax, static_cast<double>(d.threshold),
+			dsp::OnsetHoldMin, dsp::OnsetHoldMax, d.holdLength,
+			d.peakWindow, static_cast<double>(d.peakSpread), d.peakLookBack,
+			dsp::OnsetBandwidthMin, dsp::OnsetBandwidthMax, d.bandwidth,
+			dsp::OnsetNumBandsMax, d.numBands,
+			d.lowestPitch, d.highestPitch,
+			d.blockSize,
+			d.benchSeconds, d.benchRepeats,
+			dsp::BlockSize, d.evalSeconds, d.evalWindow, d.evalTolerance, d.evalLatency);
+	}
+
+	bool parseNumber(const char* arg, double& x)
+	{
+		char* end;
+		x = std::strtod(arg, &end);
+		return end != arg && *end == '\0';
+	}
+
+	bool parseEngine(const char* arg, dsp::OnsetEngine& engine)
+	{
+		if (std::strcmp(arg, "cores") == 0)
+			engine = dsp::OnsetEngine::Cores;
+		else if (std::strcmp(arg, "bank") == 0)
+			engine = dsp::OnsetEngine::Bank;
+		else if (std::strcmp(arg, "multirate") == 0)
+			engine = dsp::OnsetEngine::Multirate;
+		else
+			return false;
+		return true;
+	}
+
+	const char* toString(dsp::OnsetEngine engine)
+	{
+		switch (engine)
+		{
+		case dsp::OnsetEngine::Cores: return "cores";
+		case dsp::OnsetEngine::Bank: return "bank";
+		default: return "multirate";
+		}
+	}
+
+	bool parsePrecision(const char* arg, dsp::OnsetPrecision& precision)
+	{
+		if (std::strcmp(arg, "double") == 0)
+			precision = dsp::OnsetPrecision::Double;
+		else if (std::strcmp(arg, "mixed") == 0)
+			precision = dsp::OnsetPrecision::Mixed;
+		else
+			return false;
+		return true;
+	}
+
+	const char* toString(dsp::OnsetPrecision precision)
+	{
+		return precision == dsp::OnsetPrecision::Double ? "double" : "mixed";
+	}
+
+	bool parseMath(const char* arg, dsp::OnsetMath& math)
+	{
+		if (std::strcmp(arg, "exact") == 0)
+			math = dsp::OnsetMath::Exact;
+		else if (std::strcmp(arg, "fast") == 0)
+			math = dsp::OnsetMath::Fast;
+		else
+			return false;
+		return true;
+	}
+
+	const char* toString(dsp::OnsetMath math)
+	{
+		return math == dsp::OnsetMath::Fast ? "fast" : "exact";
+	}
+
+	bool parseThresholdMode(const char* arg, dsp::OnsetThresholdMode& mode)
+	{
+		if (std::strcmp(arg, "fixed") == 0)
+			mode = dsp::OnsetThresholdMode::Fixed;
+		else if (std::strcmp(arg, "adaptive") == 0)
+			mode = dsp::OnsetThresholdMode::Adaptive;
+		else
+			return false;
+		return true;
+	}
+
+	const char* toString(dsp::OnsetThresholdMode mode)
+	{
+		return mode == dsp::OnsetThresholdMode::Adaptive ? "adaptive" : "fixed";
+	}
+
+	bool parseISA(const char* arg, dsp::OnsetISA& isa)
+	{
+		if (std::strcmp(arg, "scalar") == 0)
+			isa = dsp::OnsetISA::Scalar;
+		else if (std::strcmp(arg, "sse2") == 0)
+			isa = dsp::OnsetISA::SSE2;
+		else if (std::strcmp(arg, "avx2") == 0)
+			isa = dsp::OnsetISA::AVX2;
+		else if (std::strcmp(arg, "avx512") == 0)
+			isa = dsp::OnsetISA::AVX512;
+		else
+			return false;
+		return true;
+	}
+
+	// comma separated groups of band indices or ranges of them
+	bool parseBandGroups(const char* arg, Options& o)
+	{
+		o.numGroups = 0;
+		while (*arg != '\0')
+		{
+			if (o.numGroups == dsp::OnsetNumGroupsMax)
+				return false;
+			auto mask = uint32_t(0);
+			while (*arg != '\0' && *arg != ',')
+			{
+				char* end;
+				const auto first = std::strtol(arg, &end, 10);
+				auto last = first;
+				if (end == arg)
+					return false;
+				arg = end;
+				if (*arg == '-')
+				{
+					last = std::strtol(arg + 1, &end, 10);
+					if (end == arg + 1)
+						return false;
+					arg = end;
+				}
+				if (first < 0 || last < first || last >= dsp::OnsetNumBandsMax)
+					return false;
+				for (auto i = first; i <= last; ++i)
+					mask |= 1u << i;
+				if (*arg == '+')
+					++arg;
+			}
+			o.groupMasks[o.numGroups++] = mask;
+			if (*arg == ',')
+				++arg;
+		}
+		return o.numGroups != 0;
+	}
+
+	bool parseOutput(const char* arg, OutputFormat& output)
+	{
+		if (std::strcmp(arg, "text") == 0)
+			output = OutputFormat::Text;
+		else if (std::strcmp(arg, "csv") == 0)
+			output = OutputFormat::CSV;
+		else if (std::strcmp(arg, "jsonl") == 0)
+			output = OutputFormat::JSONL;
+		else
+			return false;
+		return true;
+	}
+
+	// returns false after printing what's wrong
+	bool parseOptions(int argc, char** argv, Options& o)
+	{
+		for (auto i = 1; i < argc; ++i)
+		{
+			const auto arg = argv[i];
+			if (arg[0] != '-' || std::strcmp(arg, "-") == 0)
+			{
+				if (o.path != nullptr)
+				{
+					std::fprintf(stderr, "more than one input: %s\n", arg);
+					return false;
+				}
+				o.path = arg;
+				continue;
+			}
+			if (std::strcmp(arg, "--raw") == 0)
+			{
+				o.raw = true;
+				continue;
+			}
+			if (std::strcmp(arg, "--stats") == 0)
+			{
+				o.stats = true;
+				continue;
+			}
+			if (std::strcmp(arg, "--tempo") == 0)
+			{
+				o.tempo = true;
+				continue;
+			}
+			if (std::strcmp(arg, "--band-masks") == 0)
+			{
+				o.bandMasks = true;
+				continue;
+			}
+			if (std::strcmp(arg, "--bench") == 0)
+			{
+				o.bench = true;
+				continue;
+			}
+			if (std::strcmp(arg, "--evaluate") == 0)
+			{
+				o.evaluate = true;
+				continue;
+			}
+			if (i + 1 == argc)
+			{
+				std::fprintf(stderr, "%s needs a value\n", arg);
+				return false;
+			}
+			const auto val = argv[++i];
+			auto x = 0.;
+			const auto isNumber = parseNumber(val, x);
+			auto valid = isNumber;
+			if (std::strcmp(arg, "--rate") == 0)
+				o.rawSampleRate = x;
+			else if (std::strcmp(arg, "--channels") == 0)
+				o.rawNumChannels = static_cast<int>(x);
+			else if (std::strcmp(arg, "--chunk") == 0)
+				o.chunkSize = static_cast<int>(x);
+			else if (std::strcmp(arg, "--threads") == 0)
+				o.numThreads = static_cast<int>(x);
+			else if (std::strcmp(arg, "--bench-seconds") == 0)
+				o.benchSeconds = x;
+			else if (std::strcmp(arg, "--bench-repeats") == 0)
+				o.benchRepeats = static_cast<int>(x);
+			else if (std::strcmp(arg, "--eval-seconds") == 0)
+				o.evalSeconds = x;
+			else if (std::strcmp(arg, "--eval-window") == 0)
+				o.evalWindow = x;
+			else if (std::strcmp(arg, "--eval-tolerance") == 0)
+				o.evalTolerance = x;
+			else if (std::strcmp(arg, "--eval-latency") == 0)
+				o.evalLatency = x;
+			else if (std::strcmp(arg, "--block") == 0)
+				o.blockSize = static_cast<int>(x);
+			else if (std::strcmp(arg, "--attack") == 0)
+				o.attack = x;
+			else if (std::strcmp(arg, "--decay") == 0)
+				o.decay = x;
+			else if (std::strcmp(arg, "--tilt") == 0)
+				o.tilt = static_cast<float>(x);
+			else if (std::strcmp(arg, "--threshold") == 0)
+				o.threshold = static_cast<float>(x);
+			else if (std::strcmp(arg, "--hold") == 0)
+				o.holdLength = x;
+			else if (std::strcmp(arg, "--peak-window") == 0)
+				o.peakWindow = x;
+			else if (std::strcmp(arg, "--peak-spread") == 0)
+				o.peakSpread = static_cast<float>(x);
+			else if (std::strcmp(arg, "--peak-lookback") == 0)
+				o.peakLookBack = x;
+			else if (std::strcmp(arg, "--bandwidth") == 0)
+				o.bandwidth = x;
+			else if (std::strcmp(arg, "--bands") == 0)
+				o.numBands = static_cast<int>(x);
+			else if (std::strcmp(arg, "--lowest-pitch") == 0)
+				o.lowestPitch = x;
+			else if (std::strcmp(arg, "--highest-pitch") == 0)
+				o.highestPitch = x;
+			else if (std::strcmp(arg, "--format") == 0)
+				valid = dsp::parseSampleFormat(val, o.rawFormat);
+			else if (std::strcmp(arg, "--engine") == 0)
+				valid = parseEngine(val, o.engine);
+			else if (std::strcmp(arg, "--precision") == 0)
+				valid = parsePrecision(val, o.precision);
+			else if (std::strcmp(arg, "--math") == 0)
+				valid = parseMath(val, o.math);
+			else if (std::strcmp(arg, "--threshold-mode") == 0)
+				valid = parseThresholdMode(val, o.thresholdMode);
+			else if (std::strcmp(arg, "--band-groups") == 0)
+				valid = parseBandGroups(val, o);
+			else if (std::strcmp(arg, "--isa") == 0)
+				valid = parseISA(val, o.maxISA);
+			else if (std::strcmp(arg, "--output") == 0)
+				valid = parseOutput(val, o.output);
+			else
+			{
+				std::fprintf(stderr, "unknown option: %s\n", arg);
+				return false;
+			}
+			if (!valid)
+			{
+				std::fprintf(stderr, "invalid value for %s: %s\n", arg, val);
+				return false;
+			}
+		}
+		if (o.path == nullptr && !o.bench && !o.evaluate)
+		{
+			std::fprintf(stderr, "no input\n");
+			return false;
+		}
+		if (o.numBands < 1 || o.numBands > dsp::OnsetNumBandsMax)
+		{
+			std::fprintf(stderr, "--bands must be in [1, %d]\n", dsp::OnsetNumBandsMax);
+			return false;
+		}
+		if (o.chunkSize < 1)
+		{
+			std::fprintf(stderr, "--chunk must be positive\n");
+			return false;
+		}
+		if (o.benchSeconds <= 0. || o.benchRepeats < 1)
+		{
+			std::fprintf(stderr, "--bench-seconds and --bench-repeats must be positive\n");
+			return false;
+		}
+		if (o.evalSeconds <= 0. || o.evalWindow <= 0.)
+		{
+			std::fprintf(stderr, "--eval-seconds and --eval-window must be positive\n");
+			return false;
+		}
+		if (o.peakWindow <= 0. || o.peakLookBack < 0.)
+		{
+			std::fprintf(stderr, "--peak-window must be positive and --peak-lookback not negative\n");
+			return false;
+		}
+		if (o.numThreads < -1)
+		{
+			std::fprintf(stderr, "--threads must not be negative\n");
+			return false;
+		}
+		if (o.tempo && o.numThreads != -1)
+		{
+			std::fprintf(stderr, "--tempo needs the streaming detector, not --threads\n");
+			return false;
+		}
+		if ((o.bandMasks || o.numGroups != 0) && o.numThreads != -1)
+		{
+			std::fprintf(stderr, "--band-masks and --band-groups need the streaming detector, not --threads\n");
+			return false;
+		}
+		return true;
+	}
+
+	// bands: with the event's group and bands
+	void printHeader(OutputFormat output, bool bands)
+	{
+		if (output == OutputFormat::CSV)
+			std::printf(bands ? "time,sample,strength,group,bands\n" : "time,sample,strength\n");
+	}
+
+	void printEvent(OutputFormat output, const dsp::OnsetEvent& e, double sampleRate, bool bands)
+	{
+		// the threshold crossing, between two samples
+		const auto time = (static_cast<double>(e.position) + static_cast<double>(e.offset)) / sampleRate;
+		const auto position = static_cast<long long>(e.position);
+		const auto strength = static_cast<double>(e.strength);
+		switch (output)
+		{
+		case OutputFormat::Text:
+			std::printf("%.6f s  sample %lld  strength %.4f", time, position, strength);
+			if (bands)
+				std::printf("  group %d  bands 0x%04x", e.group, static_cast<unsigned>(e.bands));
+			std::printf("\n");
+			break;
+		case OutputFormat::CSV:
+			std::printf("%.6f,%lld,%.4f", time, position, strength);
+			if (bands)
+				std::printf(",%d,%u", e.group, static_cast<unsigned>(e.bands));
+			std::printf("\n");
+			break;
+		case OutputFormat::JSONL:
+			std::printf("{\"time\":%.6f,\"sample\":%lld,\"strength\":%.4f", time, position, strength);
+			if (bands)
+				std::printf(",\"group\":%d,\"bands\":%u", e.group, static_cast<unsigned>(e.bands));
+			std::printf("}\n");
+			break;
+		}
+	}
+
+	void printStats(double numSamples, double sampleRate, int numChannels,
+		Clock::duration wallTime, Clock::duration detectorTime, const char* mode,
+		int64_t numOnsets, int64_t numDropped)
+	{
+		const auto audioSecs = numSamples / sampleRate;
+		const auto wallSecs = std::chrono::duration<double>(wallTime).count();
+		const auto detectorSecs = std::chrono::duration<double>(detectorTime).count();
+		std::fprintf(stderr,
+			"audio      %.3f s (%.0f samples, %.0f Hz, %d ch)\n"
+			"time       %.3f s (detector %.3f s, %s)\n"
+			"realtime   %.1fx (detector %.1fx)\n"
+			"samples/s  %.0f (detector %.0f)\n"
+			"onsets     %lld (dropped %lld)\n",
+			audioSecs, numSamples, sampleRate, numChannels,
+			wallSecs, detectorSecs, mode,
+			audioSecs / wallSecs, audioSecs / detectorSecs,
+			numSamples / wallSecs, numSamples / detectorSecs,
+			static_cast<long long>(numOnsets), static_cast<long long>(numDropped));
+	}
+
+	// sets the parameters of a detector or analyzer
+	template<typename Detector>
+	void configure(Detector& detector, const Options& o)
+	{
+		detector.setAttack(std::pow(2., o.attack));
+		detector.setDecay(std::pow(2., o.decay));
+		detector.setTilt(o.tilt);
+		detector.setThreshold(o.threshold);
+		detector.setHoldLength(o.holdLength);
+		detector.setThresholdMode(o.thresholdMode);
+		detector.setPeakWindow(o.peakWindow);
+		detector.setPeakSpread(o.peakSpread);
+		detector.setPeakLookBack(o.peakLookBack);
+		detector.setBandwidth(std::pow(2., o.bandwidth));
+		detector.setNumBands(o.numBands);
+		detector.setLowestPitch(o.lowestPitch);
+		detector.setHighestPitch(o.highestPitch);
+		detector.setEngine(o.engine);
+		detector.setPrecision(o.precision);
+		detector.setMath(o.math);
+		detector.setMaxISA(o.maxISA);
+	}
+
+	template<int BlockSize>
+	int analyze(const Options& o, dsp::OnsetAudioReader& reader)
+	{
+		const auto sampleRate = reader.getSampleRate();
+		const auto numChannels = reader.getNumChannels();
+
+		dsp::OnsetDetectorT<BlockSize> detector;
+		configure(detector, o);
+		detector.setBandMasks(o.bandMasks);
+		detector.setBandGroups(o.groupMasks, o.numGroups);
+		detector.prepare(sampleRate);
+
+		std::vector<std::vector<float>> channels(numChannels, std::vector<float>(o.chunkSize));
+		std::vector<float*> samples(numChannels);
+		for (auto ch = 0; ch < numChannels; ++ch)
+			samples[ch] = channels[ch].data();
+		// at most one onset per sample, and one per group
+		const auto maxEvents = o.chunkSize * (1 + o.numGroups);
+		std::vector<dsp::OnsetEvent> eventData(maxEvents);
+		dsp::OnsetEvents events(eventData.data(), maxEvents);
+		// the tempo shares the detector's pass through its odf
+		dsp::OnsetTempo tempo;
+		tempo.prepare(sampleRate);
+		std::vector<float> odf(o.tempo ? o.chunkSize : 0);
+		const dsp::OnsetOdfView view(odf.data(), nullptr, 0);
+
+		const auto bands = o.bandMasks || o.numGroups != 0;
+		printHeader(o.output, bands);
+		auto numOnsets = int64_t(0);
+		auto numDropped = int64_t(0);
+		auto detectorTime = Clock::duration::zero();
+		const auto start = Clock::now();
+		while (true)
+		{
+			const auto numSamples = reader.read(samples.data(), o.chunkSize);
+			if (numSamples == 0)
+				break;
+			events.clear();
+			const auto detectorStart = Clock::now();
+			if (o.tempo)
+			{
+				detector(samples.data(), numChannels, numSamples, events, view);
+				tempo(odf.data(), numSamples);
+			}
+			else
+				detector(samples.data(), numChannels, numSamples, events);
+			detectorTime += Clock::now() - detectorStart;
+			for (const auto& e : events)
+				printEvent(o.output, e, sampleRate, bands);
+			std::fflush(stdout);
+			numOnsets += events.size();
+			numDropped += events.getNumDropped();
+		}
+		const auto wallTime = Clock::now() - start;
+
+		if (o.stats)
+			printStats(static_cast<double>(detector.getPosition()), sampleRate, numChannels,
+				wallTime, detectorTime, dsp::toString(detector.getISA()), numOnsets, numDropped);
+		if (o.tempo)
+			std::fprintf(stderr, "tempo      %.2f bpm (beat phase %.3f at the end)\n",
+				tempo.getTempo(), tempo.getBeatPhase());
+		return 0;
+	}
+
+	template<int BlockSize>
+	int analyzeParallel(const Options& o, dsp::OnsetAudioReader& reader)
+	{
+		const auto sampleRate = reader.getSampleRate();
+		const auto numChannels = reader.getNumChannels();
+
+		dsp::OnsetParallelAnalyzerT<BlockSize> analyzer;
+		configure(analyzer, o);
+		analyzer.setNumThreads(o.numThreads);
+		analyzer.prepare(sampleRate);
+
+		const auto start = Clock::now();
+		std::vector<std::vector<float>> channels(numChannels);
+		std::vector<float*> samples(numChannels);
+		auto numSamples = int64_t(0);
+		while (true)
 		{
-			// Handle onset event
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				channels[ch].resize(static_cast<size_t>(numSamples + o.chunkSize));
+				samples[ch] = channels[ch].data() + numSamples;
+			}
+			const auto numRead = reader.read(samples.data(), o.chunkSize);
+			numSamples += numRead;
+			if (numRead == 0)
+				break;
+		}
+		for (auto ch = 0; ch < numChannels; ++ch)
+			samples[ch] = channels[ch].data();
+
+		std::vector<dsp::OnsetEvent> events;
+		const auto detectorStart = Clock::now();
+		analyzer(samples.data(), numChannels, numSamples, events);
+		const auto detectorTime = Clock::now() - detectorStart;
+
+		printHeader(o.output, false);
+		for (const auto& e : events)
+			printEvent(o.output, e, sampleRate, false);
+		const auto wallTime = Clock::now() - start;
+
+		if (o.stats)
+			printStats(static_cast<double>(numSamples), sampleRate, numChannels,
+				wallTime, detectorTime, "parallel", static_cast<int64_t>(events.size()), 0);
+		return 0;
+	}
+
+	// one json object per measurement, in one array
+	int benchmark(const Options& o)
+	{
+		using Stage = dsp::OnsetBenchStage;
+		using Input = dsp::OnsetBenchInput;
+		static constexpr Input Inputs[] = { Input::Silence, Input::Noise, Input::Drums };
+		static constexpr double SampleRates[] = { 44100., 48000., 96000., 192000. };
+		static constexpr int BlockSizes[] = { 32, 64, 128, 256 };
+		static constexpr int NumBands[] = { 1, 2, 4, 8, 16 };
+		static constexpr Stage BandStages[] = { Stage::Resonate, Stage::Envelopes, Stage::Combine, Stage::Detector };
+
+		dsp::OnsetBenchmark bench;
+		bench.setSeconds(o.benchSeconds);
+		bench.setRepeats(o.benchRepeats);
+		bench.setEngine(o.engine);
+		bench.setPrecision(o.precision);
+		bench.setMath(o.math);
+		bench.setMaxISA(o.maxISA);
+
+		std::printf("{\"isa\":\"%s\",\"engine\":\"%s\",\"precision\":\"%s\",\"math\":\"%s\",\"seconds\":%g,\"repeats\":%d,\"results\":[",
+			dsp::toString(bench.getISA()), toString(o.engine), toString(o.precision), toString(o.math),
+			o.benchSeconds, o.benchRepeats);
+		auto first = true;
+		// numBands 0: the stage doesn't depend on it
+		const auto print = [&first](Stage stage, Input input, double sampleRate, int numBands, int blockSize, double ns)
+		{
+			std::printf("%s\n{\"stage\":\"%s\",\"input\":\"%s\",\"sampleRate\":%.0f,",
+				first ? "" : ",", dsp::toString(stage), dsp::toString(input), sampleRate);
+			if (numBands != 0)
+				std::printf("\"numBands\":%d,", numBands);
+			std::printf("\"blockSize\":%d,\"nsPerSample\":%.4f,\"samplesPerSec\":%.0f}",
+				blockSize, ns, 1e9 / ns);
+			std::fflush(stdout);
+			first = false;
 		};
-	onsetDetector.prepare(44100.);
-	//onsetDetector(samples, numChannels, numSamples);
-}
\ No newline at end of file
+		for (const auto input : Inputs)
+			for (const auto sampleRate : SampleRates)
+			{
+				bench.prepare(input, sampleRate);
+				for (const auto blockSize : BlockSizes)
+				{
+					print(Stage::CopyFromMid, input, sampleRate, 0, blockSize, bench(Stage::CopyFromMid, 0, blockSize));
+					for (const auto numBands : NumBands)
+						for (const auto stage : BandStages)
+							if (dsp::OnsetBenchmark::supports(stage, blockSize))
+								print(stage, input, sampleRate, numBands, blockSize, bench(stage, numBands, blockSize));
+				}
+			}
+		std::printf("\n]}\n");
+		return 0;
+	}
+
+	// the events of samples [start, end) of a corpus signal
+	template<int BlockSize>
+	void detect(dsp::OnsetDetectorT<BlockSize>& detector, const Options& o, dsp::OnsetCorpusCase& c,
+		int64_t start, int64_t end, std::vector<dsp::OnsetEvent>& events)
+	{
+		std::vector<dsp::OnsetEvent> eventData(o.chunkSize);
+		dsp::OnsetEvents chunkEvents(eventData.data(), o.chunkSize);
+		for (auto s = start; s < end; s += o.chunkSize)
+		{
+			auto samples = c.samples.data() + s;
+			const auto numChunkSamples = static_cast<int>(std::min(static_cast<int64_t>(o.chunkSize), end - s));
+			chunkEvents.clear();
+			detector(&samples, 1, numChunkSamples, chunkEvents);
+			events.insert(events.end(), chunkEvents.begin(), chunkEvents.end());
+		}
+	}
+
+	// the events of a whole corpus signal
+	template<int BlockSize>
+	void detect(const Options& o, dsp::OnsetEngine engine, dsp::OnsetISA maxISA, double sampleRate,
+		dsp::OnsetCorpusCase& c, std::vector<dsp::OnsetEvent>& events)
+	{
+		dsp::OnsetDetectorT<BlockSize> detector;
+		configure(detector, o);
+		detector.setEngine(engine);
+		detector.setMaxISA(maxISA);
+		detector.prepare(sampleRate);
+		events.clear();
+		detect(detector, o, c, 0, static_cast<int64_t>(c.samples.size()), events);
+	}
+
+	using Detect = void(*)(const Options&, dsp::OnsetEngine, dsp::OnsetISA, double,
+		dsp::OnsetCorpusCase&, std::vector<dsp::OnsetEvent>&);
+
+	// saves the candidate halfway through a corpus signal, then again after
+	// setters that change nothing, restores that into another detector and
+	// returns if all saves are equal and both detectors go on to the same events
+	template<int BlockSize>
+	bool checkState(const Options& o, double sampleRate, dsp::OnsetCorpusCase& c)
+	{
+		dsp::OnsetDetectorT<BlockSize> detector, restored;
+		configure(detector, o);
+		detector.prepare(sampleRate);
+		const auto numSamples = static_cast<int64_t>(c.samples.size());
+		std::vector<dsp::OnsetEvent> events, restoredEvents;
+		detect(detector, o, c, 0, numSamples / 2, events);
+
+		std::vector<uint8_t> state(detector.getStateSize());
+		state.resize(detector.saveState(state.data(), state.size()));
+		// they only hand the bands new coefficients at the next block
+		detector.setPrecision(o.precision);
+		detector.setNumBands(o.numBands);
+		std::vector<uint8_t> stateAfterSetters(detector.getStateSize());
+		stateAfterSetters.resize(detector.saveState(stateAfterSetters.data(), stateAfterSetters.size()));
+		if (state.empty() || state != stateAfterSetters)
+			return false;
+
+		configure(restored, o);
+		if (!restored.restoreState(state.data(), state.size()))
+			return false;
+		std::vector<uint8_t> restoredState(restored.getStateSize());
+		restoredState.resize(restored.saveState(restoredState.data(), restoredState.size()));
+		if (restoredState != state)
+			return false;
+
+		events.clear();
+		detect(detector, o, c, numSamples / 2, numSamples, events);
+		detect(restored, o, c, numSamples / 2, numSamples, restoredEvents);
+		return events.size() == restoredEvents.size()
+			&& std::equal(events.begin(), events.end(), restoredEvents.begin(),
+				[](const dsp::OnsetEvent& a, const dsp::OnsetEvent& b)
+		{
+			return a.position == b.position && a.strength == b.strength;
+		});
+	}
+
+	using CheckState = bool(*)(const Options&, double, dsp::OnsetCorpusCase&);
+
+	// precision, recall, f-measure and latency
+	void printScore(const dsp::OnsetScore& score)
+	{
+		std::printf("  %5.3f %5.3f %5.3f %7.2f", score.getPrecision(), score.getRecall(),
+			score.getFMeasure(), score.getMeanError());
+	}
+
+	// scores the reference and the candidate on every corpus signal and
+	// returns 1 if the candidate loses more than the tolerances allow on any
+	int evaluate(const Options& o)
+	{
+		using Kind = dsp::OnsetCorpusKind;
+		static constexpr Kind Kinds[] = { Kind::Clicks, Kind::Tones, Kind::NoiseBursts, Kind::Drums };
+		static constexpr float SNRs[] = { std::numeric_limits<float>::infinity(), 40.f, 30.f, 20.f };
+
+		Detect detectCandidate = nullptr;
+		CheckState checkCandidateState = nullptr;
+		switch (o.blockSize)
+		{
+		case 32: detectCandidate = detect<32>; checkCandidateState = checkState<32>; break;
+		case 64: detectCandidate = detect<64>; checkCandidateState = checkState<64>; break;
+		case 128: detectCandidate = detect<128>; checkCandidateState = checkState<128>; break;
+		case 256: detectCandidate = detect<256>; checkCandidateState = checkState<256>; break;
+		default:
+			std::fprintf(stderr, "--block must be 32, 64, 128 or 256\n");
+			return 1;
+		}
+		const auto sampleRate = o.rawSampleRate > 0. ? o.rawSampleRate : 48000.;
+
+		// the tones sit at the centres of the detectors' bands
+		dsp::OnsetBands bands;
+		bands.setNumBands(o.numBands);
+		bands.setLowestPitch(o.lowestPitch);
+		bands.setHighestPitch(o.highestPitch);
+		bands.prepare(sampleRate);
+		dsp::OnsetCorpus corpus;
+		corpus.setSeconds(o.evalSeconds);
+		corpus.prepare(sampleRate, bands);
+
+		std::printf("reference  cores, %s, block %d\n", dsp::toString(dsp::OnsetISA::Scalar), dsp::BlockSize);
+		std::printf("candidate  %s, %s, %s, %s, block %d\n", toString(o.engine), toString(o.precision),
+			toString(o.math), dsp::toString(dsp::selectOnsetKernels(o.maxISA).isa), o.blockSize);
+		std::printf("%.0f Hz, %g s per signal, window %g ms, %s threshold\n\n", sampleRate, o.evalSeconds,
+			o.evalWindow, toString(o.thresholdMode));
+		std::printf("%-20s  %-27s  %-27s\n", "", "reference", "candidate");
+		std::printf("%-20s  %5s %5s %5s %7s  %5s %5s %5s %7s\n", "signal",
+			"P", "R", "F", "lat ms", "P", "R", "F", "lat ms");
+
+		dsp::OnsetScore referenceTotal, candidateTotal;
+		dsp::OnsetCorpusCase c;
+		std::vector<dsp::OnsetEvent> referenceEvents, candidateEvents;
+		auto numFailed = 0;
+		for (const auto kind : Kinds)
+			for (const auto snrDb : SNRs)
+			{
+				corpus(kind, snrDb, c);
+				detect<dsp::BlockSize>(o, dsp::OnsetEngine::Cores, dsp::OnsetISA::Scalar, sampleRate, c, referenceEvents);
+				detectCandidate(o, o.engine, o.maxISA, sampleRate, c, candidateEvents);
+				dsp::OnsetScore reference, candidate;
+				reference(c.onsets, referenceEvents, sampleRate, o.evalWindow);
+				candidate(c.onsets, candidateEvents, sampleRate, o.evalWindow);
+				referenceTotal.add(reference);
+				candidateTotal.add(candidate);
+
+				const auto fLoss = reference.getFMeasure() - candidate.getFMeasure();
+				const auto latencyShift = std::abs(candidate.getMeanError() - reference.getMeanError());
+				const auto passed = fLoss <= o.evalTolerance && latencyShift <= o.evalLatency;
+				if (!passed)
+					++numFailed;
+
+				char snr[16] = "clean";
+				if (!std::isinf(snrDb))
+					std::snprintf(snr, sizeof(snr), "%gdb", static_cast<double>(snrDb));
+				std::printf("%-13s %-6s", dsp::toString(kind), snr);
+				printScore(reference);
+				printScore(candidate);
+				std::printf("%s\n", passed ? "" : "  FAIL");
+			}
+		std::printf("%-20s", "all");
+		printScore(referenceTotal);
+		printScore(candidateTotal);
+		std::printf("\n\n");
+
+		corpus(Kind::Drums, std::numeric_limits<float>::infinity(), c);
+		const auto stateKept = checkCandidateState(o, sampleRate, c);
+		std::printf("checkpoint %s\n\n", stateKept ? "kept" : "FAIL");
+
+		if (numFailed != 0)
+		{
+			std::printf("fail: %d signals lost more than %g f-measure or moved more than %g ms\n",
+				numFailed, o.evalTolerance, o.evalLatency);
+			return 1;
+		}
+		if (!stateKept)
+		{
+			std::printf("fail: a checkpoint changed after setters that change nothing, or didn't restore\n");
+			return 1;
+		}
+		std::printf("pass\n");
+		return 0;
+	}
+
+	template<int BlockSize>
+	int run(const Options& o, dsp::OnsetAudioReader& reader)
+	{
+		if (o.numThreads < 0)
+			return analyze<BlockSize>(o, reader);
+		return analyzeParallel<BlockSize>(o, reader);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	for (auto i = 1; i < argc; ++i)
+		if (std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0)
+		{
+			printUsage();
+			return 0;
+		}
+
+	Options o;
+	if (!parseOptions(argc, argv, o))
+	{
+		std::fprintf(stderr, "try --help\n");
+		return 1;
+	}
+
+	if (o.bench)
+		return benchmark(o);
+	if (o.evaluate)
+		return evaluate(o);
+
+	dsp::OnsetAudioReader reader;
+	const auto opened = o.raw ?
+		reader.openRaw(o.path, o.rawSampleRate, o.rawNumChannels, o.rawFormat) :
+		reader.openWav(o.path);
+	if (!opened)
+	{
+		std::fprintf(stderr, "%s: %s\n", o.path, reader.getError());
+		return 1;
+	}
+
+	switch (o.blockSize)
+	{
+	case 32: return run<32>(o, reader);
+	case 64: return run<64>(o, reader);
+	case 128: return run<128>(o, reader);
+	case 256: return run<256>(o, reader);
+	default:
+		std::fprintf(stderr, "--block must be 32, 64, 128 or 256\n");
+		return 1;
+	}
+}